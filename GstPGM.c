@@ -45,6 +45,9 @@ static gboolean plugin_init (GstPlugin* plugin)
 
   if (!gst_element_register (plugin, "pgmsrc" , GST_RANK_NONE, GST_TYPE_PGM_SRC )) return FALSE;
   if (!gst_element_register (plugin, "pgmsink", GST_RANK_NONE, GST_TYPE_PGM_SINK)) return FALSE;
+  if (!gst_element_register (plugin, "pgmreplaysrc", GST_RANK_NONE, GST_TYPE_PGM_REPLAY_SRC)) return FALSE;
+  if (!gst_element_register (plugin, "pgmrelay", GST_RANK_NONE, GST_TYPE_PGM_RELAY)) return FALSE;
+  if (!gst_tracer_register (plugin, "pgmlatency", GST_TYPE_PGM_LATENCY_TRACER)) return FALSE;
 
   return TRUE;
 }
@@ -27,5 +27,8 @@
 
 #include "GstPGMSrc.h"
 #include "GstPGMSink.h"
+#include "GstPGMReplaySrc.h"
+#include "GstPGMRelay.h"
+#include "GstPGMLatencyTracer.h"
 
 #endif // GST_PGM_H
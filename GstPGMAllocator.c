@@ -0,0 +1,340 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer huge page and NUMA local memory
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "GstPGMAllocator.h"
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED  1
+#endif
+
+struct _GstPgmChunk
+{
+  guint8*   base;
+  gsize     size;
+  gsize     used;
+  gint      ref;        // the allocator while current, and every memory in it
+  gboolean  huge;
+};
+
+typedef struct
+{
+  GstMemory     mem;
+  GstPgmChunk*  chunk;  // NULL for shares, the parent holds the chunk
+  guint8*       data;
+} GstPgmMemory;
+
+G_DEFINE_TYPE (GstPgmAllocator, gst_pgm_allocator, GST_TYPE_ALLOCATOR)
+
+/* Preferred rather than bound, a node that runs out still gets memory
+ * from the others.
+ */
+static gboolean gst_pgm_allocator_bind (gpointer i_base, gsize i_size, gint i_node)
+{
+#ifdef SYS_mbind
+  unsigned long mask[4] = { 0 };
+
+  if (i_node < 0 || i_node >= (gint)(8 * sizeof(mask))) return FALSE;
+  mask[i_node / (8 * sizeof(unsigned long))] = 1UL << (i_node % (8 * sizeof(unsigned long)));
+  return 0 == syscall (SYS_mbind, i_base, i_size, MPOL_PREFERRED, mask, 8 * sizeof(mask), 0);
+#else
+  return FALSE;
+#endif
+}
+
+/* called with the lock held */
+static GstPgmChunk* gst_pgm_allocator_chunk_new (GstPgmAllocator* io_alloc, gsize i_size)
+{
+  const gsize size = (i_size + GST_PGM_ALLOCATOR_CHUNK_SIZE - 1) & ~(gsize)(GST_PGM_ALLOCATOR_CHUNK_SIZE - 1);
+  gboolean huge = FALSE;
+  gpointer base = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if (io_alloc->hugepages)
+  {
+    base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge = MAP_FAILED != base;
+  }
+#endif
+  if (MAP_FAILED == base)
+  {
+    base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == base)
+    {
+      GST_WARNING_OBJECT (io_alloc, "cannot map %" G_GSIZE_FORMAT " bytes: %s", size, g_strerror (errno));
+      return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (io_alloc->hugepages) madvise (base, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  /* pages are only placed when first touched, after this */
+  if (io_alloc->numa_node >= 0) io_alloc->numa_bound = gst_pgm_allocator_bind (base, size, io_alloc->numa_node);
+
+  GstPgmChunk* chunk = g_slice_new (GstPgmChunk);
+  chunk->base = base;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->ref  = 1;
+  chunk->huge = huge;
+
+  io_alloc->chunks++;
+  io_alloc->chunk_bytes += size;
+  if (huge) io_alloc->huge_chunks++;
+  return chunk;
+}
+
+/* called with the lock held */
+static void gst_pgm_allocator_chunk_free (GstPgmAllocator* io_alloc, GstPgmChunk* io_chunk)
+{
+  io_alloc->chunks--;
+  io_alloc->chunk_bytes -= io_chunk->size;
+  if (io_chunk->huge) io_alloc->huge_chunks--;
+
+  munmap (io_chunk->base, io_chunk->size);
+  g_slice_free (GstPgmChunk, io_chunk);
+}
+
+/* the last reference to a chunk is gone, called with the lock held */
+static void gst_pgm_allocator_chunk_release (GstPgmAllocator* io_alloc, GstPgmChunk* io_chunk)
+{
+  if (GST_PGM_ALLOCATOR_CHUNK_SIZE == io_chunk->size && io_alloc->spare_count < GST_PGM_ALLOCATOR_SPARE_CHUNKS)
+  {
+    io_chunk->used = 0;
+    io_chunk->ref  = 1;
+    io_alloc->spare = g_slist_prepend (io_alloc->spare, io_chunk);
+    io_alloc->spare_count++;
+    return;
+  }
+  gst_pgm_allocator_chunk_free (io_alloc, io_chunk);
+}
+
+/* a chunk to carve i_size bytes from, with a reference for the memory */
+static GstPgmChunk* gst_pgm_allocator_chunk_get (GstPgmAllocator* io_alloc, gsize i_size, gsize i_align)
+{
+  if (i_size + i_align > GST_PGM_ALLOCATOR_CHUNK_SIZE / 4) return gst_pgm_allocator_chunk_new (io_alloc, i_size);
+
+  GstPgmChunk* chunk = io_alloc->current;
+  if (chunk)
+  {
+    const gsize offset = (chunk->used + i_align) & ~i_align;
+    if (offset + i_size <= chunk->size)
+    {
+      chunk->used = offset;
+      g_atomic_int_inc (&chunk->ref);
+      return chunk;
+    }
+
+    io_alloc->current = NULL;
+    if (g_atomic_int_dec_and_test (&chunk->ref)) gst_pgm_allocator_chunk_release (io_alloc, chunk);
+  }
+
+  if (io_alloc->spare)
+  {
+    chunk = io_alloc->spare->data;
+    io_alloc->spare = g_slist_delete_link (io_alloc->spare, io_alloc->spare);
+    io_alloc->spare_count--;
+  }
+  else
+  {
+    chunk = gst_pgm_allocator_chunk_new (io_alloc, GST_PGM_ALLOCATOR_CHUNK_SIZE);
+    if (NULL == chunk) return NULL;
+  }
+
+  io_alloc->current = chunk;
+  g_atomic_int_inc (&chunk->ref);
+  return chunk;
+}
+
+static GstMemory* gst_pgm_allocator_alloc (GstAllocator* io_allocator, gsize i_size, GstAllocationParams* i_params)
+{
+  GstPgmAllocator* alloc = GST_PGM_ALLOCATOR (io_allocator);
+  const gsize align   = i_params->align | gst_memory_alignment;
+  const gsize maxsize = i_size + i_params->prefix + i_params->padding;
+
+  g_mutex_lock (&alloc->lock);
+  GstPgmChunk* chunk = gst_pgm_allocator_chunk_get (alloc, maxsize, align);
+  if (NULL == chunk)
+  {
+    g_mutex_unlock (&alloc->lock);
+    return NULL;
+  }
+
+  GstPgmMemory* mem = g_slice_new (GstPgmMemory);
+  mem->chunk = chunk;
+  mem->data  = chunk->base + chunk->used;
+  chunk->used += maxsize;
+
+  alloc->allocations++;
+  alloc->memories++;
+  alloc->bytes += maxsize;
+  g_mutex_unlock (&alloc->lock);
+
+  gst_memory_init (GST_MEMORY_CAST (mem), i_params->flags, io_allocator, NULL, maxsize, align, i_params->prefix, i_size);
+
+  if ((i_params->flags & GST_MEMORY_FLAG_ZERO_PREFIXED) && i_params->prefix) memset (mem->data, 0, i_params->prefix);
+  if ((i_params->flags & GST_MEMORY_FLAG_ZERO_PADDED) && i_params->padding) memset (mem->data + i_params->prefix + i_size, 0, i_params->padding);
+
+  return GST_MEMORY_CAST (mem);
+}
+
+static void gst_pgm_allocator_free (GstAllocator* io_allocator, GstMemory* io_mem)
+{
+  GstPgmAllocator* alloc = GST_PGM_ALLOCATOR (io_allocator);
+  GstPgmMemory* mem = (GstPgmMemory*) io_mem;
+
+  if (mem->chunk)
+  {
+    g_mutex_lock (&alloc->lock);
+    alloc->memories--;
+    alloc->bytes -= io_mem->maxsize;
+    if (g_atomic_int_dec_and_test (&mem->chunk->ref)) gst_pgm_allocator_chunk_release (alloc, mem->chunk);
+    g_mutex_unlock (&alloc->lock);
+  }
+  g_slice_free (GstPgmMemory, mem);
+}
+
+static gpointer gst_pgm_memory_map (GstMemory* i_mem, gsize i_maxsize, GstMapFlags i_flags)
+{
+  return ((GstPgmMemory*) i_mem)->data;
+}
+
+static void gst_pgm_memory_unmap (GstMemory* i_mem)
+{
+}
+
+static GstMemory* gst_pgm_memory_share (GstMemory* i_mem, gssize i_offset, gssize i_size)
+{
+  GstMemory* parent = i_mem->parent ? i_mem->parent : i_mem;
+
+  if (-1 == i_size) i_size = i_mem->size - i_offset;
+
+  GstPgmMemory* sub = g_slice_new (GstPgmMemory);
+  sub->chunk = NULL;
+  sub->data  = ((GstPgmMemory*) i_mem)->data;
+
+  gst_memory_init ( GST_MEMORY_CAST (sub)
+                  , GST_MINI_OBJECT_FLAGS (parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY
+                  , i_mem->allocator, parent
+                  , i_mem->maxsize, i_mem->align, i_mem->offset + i_offset, i_size
+                  );
+  return GST_MEMORY_CAST (sub);
+}
+
+static gboolean gst_pgm_memory_is_span (GstMemory* i_mem1, GstMemory* i_mem2, gsize* o_offset)
+{
+  GstPgmMemory* mem1 = (GstPgmMemory*) i_mem1;
+  GstPgmMemory* mem2 = (GstPgmMemory*) i_mem2;
+
+  if (o_offset) *o_offset = i_mem1->offset - i_mem1->parent->offset;
+  return mem1->data + i_mem1->offset + i_mem1->size == mem2->data + i_mem2->offset;
+}
+
+static void gst_pgm_allocator_finalize (GObject* io_obj)
+{
+  GstPgmAllocator* alloc = GST_PGM_ALLOCATOR (io_obj);
+
+  /* memories hold the allocator, only the current and spare chunks are left */
+  if (alloc->current) gst_pgm_allocator_chunk_free (alloc, alloc->current);
+  for (GSList* l = alloc->spare; l; l = l->next) gst_pgm_allocator_chunk_free (alloc, l->data);
+  g_slist_free (alloc->spare);
+  g_mutex_clear (&alloc->lock);
+
+  G_OBJECT_CLASS (gst_pgm_allocator_parent_class)->finalize (io_obj);
+}
+
+static void gst_pgm_allocator_class_init (GstPgmAllocatorClass* klass)
+{
+  GstAllocatorClass* allocatorClass = (GstAllocatorClass*)klass;
+  allocatorClass->alloc = gst_pgm_allocator_alloc;
+  allocatorClass->free  = gst_pgm_allocator_free;
+
+  GObjectClass* gobjectClass = (GObjectClass*)klass;
+  gobjectClass->finalize = gst_pgm_allocator_finalize;
+}
+
+static void gst_pgm_allocator_init (GstPgmAllocator* io_alloc)
+{
+  GstAllocator* allocator = GST_ALLOCATOR_CAST (io_alloc);
+
+  allocator->mem_type    = GST_PGM_ALLOCATOR_MEMORY_TYPE;
+  allocator->mem_map     = gst_pgm_memory_map;
+  allocator->mem_unmap   = gst_pgm_memory_unmap;
+  allocator->mem_share   = gst_pgm_memory_share;
+  allocator->mem_is_span = gst_pgm_memory_is_span;
+
+  io_alloc->numa_node   = -1;
+  io_alloc->hugepages   = TRUE;
+  g_mutex_init (&io_alloc->lock);
+  io_alloc->current     = NULL;
+  io_alloc->spare       = NULL;
+  io_alloc->spare_count = 0;
+  io_alloc->allocations = 0;
+  io_alloc->memories    = 0;
+  io_alloc->bytes       = 0;
+  io_alloc->chunks      = 0;
+  io_alloc->huge_chunks = 0;
+  io_alloc->chunk_bytes = 0;
+  io_alloc->numa_bound  = FALSE;
+}
+
+/* i_numa_node -1 to leave placement to the kernel, i_hugepages FALSE for
+ * plain pages
+ */
+GstAllocator* gst_pgm_allocator_new (gint i_numa_node, gboolean i_hugepages)
+{
+  GstPgmAllocator* alloc = g_object_new (GST_TYPE_PGM_ALLOCATOR, NULL);
+
+  alloc->numa_node = i_numa_node;
+  alloc->hugepages = i_hugepages;
+  gst_object_ref_sink (alloc);
+
+  return GST_ALLOCATOR_CAST (alloc);
+}
+
+GstStructure* gst_pgm_allocator_get_stats (GstAllocator* i_allocator)
+{
+  GstPgmAllocator* alloc = GST_PGM_ALLOCATOR (i_allocator);
+
+  g_mutex_lock (&alloc->lock);
+  GstStructure* stats = gst_structure_new 
+    ( "pgm-allocator-stats"
+    , "numa-node"         , G_TYPE_INT    , alloc->numa_node
+    , "numa-bound"        , G_TYPE_BOOLEAN, alloc->numa_bound
+    , "allocations"       , G_TYPE_UINT64 , alloc->allocations
+    , "memories"          , G_TYPE_UINT64 , alloc->memories
+    , "bytes"             , G_TYPE_UINT64 , alloc->bytes
+    , "chunks"            , G_TYPE_UINT   , alloc->chunks
+    , "hugepage-chunks"   , G_TYPE_UINT   , alloc->huge_chunks
+    , "chunk-bytes"       , G_TYPE_UINT64 , alloc->chunk_bytes
+    , NULL
+    );
+  g_mutex_unlock (&alloc->lock);
+
+  return stats;
+}
@@ -0,0 +1,83 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer huge page and NUMA local memory
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_ALLOCATOR_H
+#define GST_PGM_ALLOCATOR_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_ALLOCATOR             (gst_pgm_allocator_get_type())
+#define GST_PGM_ALLOCATOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PGM_ALLOCATOR,GstPgmAllocator))
+#define GST_IS_PGM_ALLOCATOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_ALLOCATOR))
+
+#define GST_PGM_ALLOCATOR_MEMORY_TYPE      "PgmMemory"
+
+/* Memories are carved one after the other out of 2 MiB chunks, mapped
+ * with huge pages if the system has them reserved, else with transparent
+ * huge pages advised, and preferably placed on one NUMA node. A chunk is
+ * unmapped, or kept for reuse, once the last memory in it is freed, which
+ * suits buffers that are freed about in the order they were allocated.
+ * Memories of more than a quarter chunk get a mapping of their own.
+ */
+#define GST_PGM_ALLOCATOR_CHUNK_SIZE   ( 2 << 20 )
+#define GST_PGM_ALLOCATOR_SPARE_CHUNKS 4
+
+typedef struct _GstPgmAllocator GstPgmAllocator;
+typedef struct _GstPgmAllocatorClass GstPgmAllocatorClass;
+typedef struct _GstPgmChunk GstPgmChunk;
+
+struct _GstPgmAllocator
+{
+  GstAllocator  parent;
+
+  gint          numa_node;    // -1 for wherever the kernel likes
+  gboolean      hugepages;
+
+  GMutex        lock;
+  GstPgmChunk*  current;      // being carved
+  GSList*       spare;        // emptied chunks kept for reuse
+  guint         spare_count;
+
+  guint64       allocations;
+  guint64       memories;     // allocated and not yet freed
+  guint64       bytes;
+  guint         chunks;       // mapped, including spare ones
+  guint         huge_chunks;  // of those, backed by reserved huge pages
+  guint64       chunk_bytes;
+  gboolean      numa_bound;   // the last mapping took the node policy
+};
+
+struct _GstPgmAllocatorClass
+{
+  GstAllocatorClass  parent_class;
+};
+
+GType          gst_pgm_allocator_get_type (void);
+
+GstAllocator*  gst_pgm_allocator_new (gint, gboolean);
+GstStructure*  gst_pgm_allocator_get_stats (GstAllocator*);
+
+G_END_DECLS
+
+#endif // GST_PGM_ALLOCATOR_H
@@ -0,0 +1,195 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer capture of received APDUs
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "GstPGMCapture.h"
+
+#define GST_PGM_CAPTURE_ALIGN(n)  (((n) + 7) & ~(gsize) 7)
+
+/* open a capture file for appending, starting it if it is empty
+ */
+FILE* gst_pgm_capture_open (const gchar* i_location)
+{
+  FILE* file = fopen (i_location, "ab");
+  if (NULL == file) return NULL;
+
+  fseek (file, 0, SEEK_END);
+  if (0 == ftell (file))
+  {
+    guint8 header[GST_PGM_CAPTURE_HEADER_SIZE];
+
+    memcpy (header, GST_PGM_CAPTURE_MAGIC, 6);
+    GST_WRITE_UINT16_BE (header + 6, GST_PGM_CAPTURE_VERSION);
+    if (1 != fwrite (header, sizeof(header), 1, file))
+    {
+      fclose (file);
+      return NULL;
+    }
+  }
+  return file;
+}
+
+/* append what one pgm_recvmsg returned
+ */
+gboolean gst_pgm_capture_write (FILE* io_file, GstPgmCaptureKind i_kind, guint i_path, const struct pgm_msgv_t* i_msgv)
+{
+  const guint n = (GST_PGM_CAPTURE_RESET == i_kind) ? 1 : i_msgv->msgv_len;
+  const struct pgm_sk_buff_t* first = i_msgv->msgv_skb[0];
+  gsize payload = 0;
+
+  if (GST_PGM_CAPTURE_APDU == i_kind)
+  {
+    for (guint i = 0; i < n; ++i) payload += i_msgv->msgv_skb[i]->len;
+  }
+
+  const gsize size = GST_PGM_CAPTURE_ALIGN (GST_PGM_CAPTURE_RECORD_SIZE + n * GST_PGM_CAPTURE_FRAGMENT_SIZE + payload);
+  guint8 head[GST_PGM_CAPTURE_RECORD_SIZE + PGM_MAX_FRAGMENTS * GST_PGM_CAPTURE_FRAGMENT_SIZE];
+  guint8* p = head;
+
+  GST_WRITE_UINT32_BE (p, size);
+  p[4] = i_kind;
+  p[5] = i_path;
+  GST_WRITE_UINT16_BE (p + 6, n);
+  memcpy (p + 8, first->tsi.gsi.identifier, 6);
+  memcpy (p + 14, &first->tsi.sport, 2);
+  p += GST_PGM_CAPTURE_RECORD_SIZE;
+
+  for (guint i = 0; i < n; ++i)
+  {
+    const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[i];
+    const gboolean apdu = GST_PGM_CAPTURE_APDU == i_kind;
+
+    GST_WRITE_UINT32_BE (p, skb->sequence);
+    GST_WRITE_UINT64_BE (p + 4, skb->tstamp);
+    GST_WRITE_UINT16_BE (p + 12, apdu ? skb->len : 0);
+    p[14] = apdu ? skb->pgm_header->pgm_type : 0;
+    p[15] = 0;
+    p += GST_PGM_CAPTURE_FRAGMENT_SIZE;
+  }
+
+  if (1 != fwrite (head, p - head, 1, io_file)) return FALSE;
+
+  if (GST_PGM_CAPTURE_APDU == i_kind)
+  {
+    for (guint i = 0; i < n; ++i)
+    {
+      if (1 != fwrite (i_msgv->msgv_skb[i]->data, i_msgv->msgv_skb[i]->len, 1, io_file)) return FALSE;
+    }
+  }
+
+  static const guint8 zero[8] = { 0 };
+  const gsize padding = size - (p - head) - payload;
+  return 0 == padding || 1 == fwrite (zero, padding, 1, io_file);
+}
+
+GstPgmCaptureReader* gst_pgm_capture_reader_new (const gchar* i_location, GError** o_err)
+{
+  GMappedFile* file = g_mapped_file_new (i_location, FALSE, o_err);
+  if (NULL == file) return NULL;
+
+  const guint8* data = (const guint8*) g_mapped_file_get_contents (file);
+  const gsize size = g_mapped_file_get_length (file);
+
+  if ( size < GST_PGM_CAPTURE_HEADER_SIZE 
+     || 0 != memcmp (data, GST_PGM_CAPTURE_MAGIC, 6)
+     || GST_PGM_CAPTURE_VERSION != GST_READ_UINT16_BE (data + 6)
+     )
+  {
+    g_set_error (o_err, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is no PGM capture file", i_location);
+    g_mapped_file_unref (file);
+    return NULL;
+  }
+
+  GstPgmCaptureReader* reader = g_new (GstPgmCaptureReader, 1);
+  reader->file   = file;
+  reader->data   = data;
+  reader->size   = size;
+  reader->offset = GST_PGM_CAPTURE_HEADER_SIZE;
+  return reader;
+}
+
+void gst_pgm_capture_reader_free (GstPgmCaptureReader* io_reader)
+{
+  if (NULL == io_reader) return;
+
+  g_mapped_file_unref (io_reader->file);
+  g_free (io_reader);
+}
+
+/* the next record, FALSE at the end of the file or of what was written of
+ * it completely
+ */
+gboolean gst_pgm_capture_reader_next (GstPgmCaptureReader* io_reader, GstPgmCaptureRecord* o_record)
+{
+  const guint8* record = io_reader->data + io_reader->offset;
+  const gsize left = io_reader->size - io_reader->offset;
+
+  if (left < GST_PGM_CAPTURE_RECORD_SIZE) return FALSE;
+
+  const gsize size = GST_READ_UINT32_BE (record);
+  const guint n = GST_READ_UINT16_BE (record + 6);
+
+  if ( size > left
+     || n < 1 || n > PGM_MAX_FRAGMENTS
+     || size < GST_PGM_CAPTURE_RECORD_SIZE + n * GST_PGM_CAPTURE_FRAGMENT_SIZE
+     )
+  {
+    return FALSE;
+  }
+
+  o_record->kind    = record[4];
+  o_record->path    = record[5];
+  o_record->len     = 0;
+  o_record->arrival = 0;
+  o_record->msgv.msgv_len = n;
+
+  const guint8* fragment = record + GST_PGM_CAPTURE_RECORD_SIZE;
+  const guint8* payload  = fragment + n * GST_PGM_CAPTURE_FRAGMENT_SIZE;
+
+  for (guint i = 0; i < n; ++i, fragment += GST_PGM_CAPTURE_FRAGMENT_SIZE)
+  {
+    struct pgm_sk_buff_t* skb = &o_record->skb[i];
+    struct pgm_header* header = &o_record->header[i];
+
+    memset (skb, 0, sizeof(*skb));
+    memset (header, 0, sizeof(*header));
+    memcpy (skb->tsi.gsi.identifier, record + 8, 6);
+    memcpy (&skb->tsi.sport, record + 14, 2);
+    skb->sequence   = GST_READ_UINT32_BE (fragment);
+    skb->tstamp     = GST_READ_UINT64_BE (fragment + 4);
+    skb->len        = GST_READ_UINT16_BE (fragment + 12);
+    header->pgm_type = fragment[14];
+    skb->pgm_header = header;
+    skb->data       = (gpointer) payload;
+
+    payload += skb->len;
+    if (payload > record + size) return FALSE;
+
+    o_record->len    += skb->len;
+    o_record->arrival = MAX (o_record->arrival, skb->tstamp);
+    o_record->msgv.msgv_skb[i] = skb;
+  }
+
+  io_reader->offset += size;
+  return TRUE;
+}
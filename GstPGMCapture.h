@@ -0,0 +1,96 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer capture of received APDUs
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_CAPTURE_H
+#define GST_PGM_CAPTURE_H
+
+#include <stdio.h>
+
+#include <gst/gst.h>
+#include <pgm/pgm.h>
+#include <pgm/packet.h>
+
+G_BEGIN_DECLS
+
+/* Capture file, appended to by pgmsrc and read by pgmreplaysrc through a
+ * memory map. Network byte order:
+ *
+ *   file header   "PGMCAP" magic, 16 bit version
+ *   record        32 bit size of the record, padding included
+ *                 8 bit kind, 8 bit path: 0 main, 1 redundant, 2 droppable
+ *                 16 bit number of fragments
+ *                 TSI: 6 byte GSI, 16 bit source port as on the wire
+ *   fragment      32 bit PGM sequence, 64 bit arrival in microseconds,
+ *                 16 bit length, 8 bit PGM type (ODATA or RDATA), 8 bit zero
+ *                 ... for every fragment, then their payloads one after the
+ *                 other, zero padded to a multiple of 8 bytes
+ *
+ * A reset record has one fragment without payload, whose sequence is the
+ * number of sequences lost, as pgm_recvmsg reports it.
+ */
+#define GST_PGM_CAPTURE_MAGIC          "PGMCAP"
+#define GST_PGM_CAPTURE_VERSION        1
+#define GST_PGM_CAPTURE_HEADER_SIZE    8
+#define GST_PGM_CAPTURE_RECORD_SIZE    16
+#define GST_PGM_CAPTURE_FRAGMENT_SIZE  16
+
+typedef enum
+{
+  GST_PGM_CAPTURE_APDU  = 0,
+  GST_PGM_CAPTURE_RESET = 1
+} GstPgmCaptureKind;
+
+typedef struct _GstPgmCaptureRecord GstPgmCaptureRecord;
+typedef struct _GstPgmCaptureReader GstPgmCaptureReader;
+
+/* One record as pgm_recvmsg returned it, the skbs point into the map.
+ */
+struct _GstPgmCaptureRecord
+{
+  GstPgmCaptureKind     kind;
+  guint                 path;
+  struct pgm_msgv_t     msgv;
+  gsize                 len;        // bytes of the APDU
+  pgm_time_t            arrival;    // of the last fragment
+
+  struct pgm_sk_buff_t  skb[PGM_MAX_FRAGMENTS];
+  struct pgm_header     header[PGM_MAX_FRAGMENTS];
+};
+
+struct _GstPgmCaptureReader
+{
+  GMappedFile*  file;
+  const guint8* data;
+  gsize         size;
+  gsize         offset;
+};
+
+FILE*     gst_pgm_capture_open (const gchar*);
+gboolean  gst_pgm_capture_write (FILE*, GstPgmCaptureKind, guint, const struct pgm_msgv_t*);
+
+GstPgmCaptureReader*  gst_pgm_capture_reader_new (const gchar*, GError**);
+void                  gst_pgm_capture_reader_free (GstPgmCaptureReader*);
+gboolean              gst_pgm_capture_reader_next (GstPgmCaptureReader*, GstPgmCaptureRecord*);
+
+G_END_DECLS
+
+#endif // GST_PGM_CAPTURE_H
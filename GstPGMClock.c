@@ -0,0 +1,63 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer sender clock recovery
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "GstPGMClock.h"
+
+/* a monotonic system clock, calibrated against the sender's observations
+ */
+GstClock* gst_pgm_clock_new (const gchar* i_name)
+{
+  GstClock* clock = GST_CLOCK (g_object_new (GST_TYPE_SYSTEM_CLOCK, "name", i_name, "clock-type", GST_CLOCK_TYPE_MONOTONIC, NULL));
+
+  g_object_set (clock, "window-size", 32, "window-threshold", 4, NULL);
+  return clock;
+}
+
+void gst_pgm_clock_filter_reset (GstPgmClockFilter* o_filter)
+{
+  o_filter->count     = 0;
+  o_filter->local     = GST_CLOCK_TIME_NONE;
+  o_filter->remote    = GST_CLOCK_TIME_NONE;
+  o_filter->min_delay = G_MAXINT64;
+}
+
+/* Feed one sample, TRUE when a window is complete and o_local, o_remote
+ * hold the observation to add to the clock.
+ */
+gboolean gst_pgm_clock_filter_push (GstPgmClockFilter* io_filter, GstClockTime i_local, GstClockTime i_remote, GstClockTime* o_local, GstClockTime* o_remote)
+{
+  const gint64 delay = (gint64) i_local - (gint64) i_remote;
+
+  if (delay < io_filter->min_delay)
+  {
+    io_filter->min_delay = delay;
+    io_filter->local     = i_local;
+    io_filter->remote    = i_remote;
+  }
+
+  if (++io_filter->count < GST_PGM_CLOCK_FILTER_WINDOW) return FALSE;
+
+  *o_local  = io_filter->local;
+  *o_remote = io_filter->remote;
+  gst_pgm_clock_filter_reset (io_filter);
+  return TRUE;
+}
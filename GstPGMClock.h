@@ -0,0 +1,52 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer sender clock recovery
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_CLOCK_H
+#define GST_PGM_CLOCK_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Samples of the sender clock in a window, the one that spent least time
+ * on the way is taken as the observation. Queueing on the network and in
+ * the sender only ever adds delay, so the minimum is closest to the truth.
+ */
+#define GST_PGM_CLOCK_FILTER_WINDOW  8
+
+typedef struct _GstPgmClockFilter GstPgmClockFilter;
+
+struct _GstPgmClockFilter
+{
+  guint         count;
+  GstClockTime  local;        // internal time of the best sample so far
+  GstClockTime  remote;
+  gint64        min_delay;
+};
+
+GstClock* gst_pgm_clock_new (const gchar*);
+void      gst_pgm_clock_filter_reset (GstPgmClockFilter*);
+gboolean  gst_pgm_clock_filter_push (GstPgmClockFilter*, GstClockTime, GstClockTime, GstClockTime*, GstClockTime*);
+
+G_END_DECLS
+
+#endif // GST_PGM_CLOCK_H
@@ -0,0 +1,251 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per-APDU compression
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#define LZ4_STATIC_LINKING_ONLY   // LZ4_attach_dictionary
+#include <lz4.h>
+
+#include "GstPGMCompress.h"
+
+GType gst_pgm_compression_get_type (void)
+{
+  static GType compression_type = 0;
+  static const GEnumValue compression[] =
+    { { GST_PGM_COMPRESSION_NONE, "Send payloads as they are"  , "none" }
+    , { GST_PGM_COMPRESSION_LZ4 , "LZ4 with a stream dictionary", "lz4"  }
+    , { 0, NULL, NULL }
+    };
+
+  if (!compression_type)
+  {
+    compression_type = g_enum_register_static ("GstPgmCompression", compression);
+  }
+  return compression_type;
+}
+
+/* FNV-1a, never 0 which stands for no dictionary */
+static guint32 gst_pgm_compress_dict_id (const guint8* i_data, gsize i_size)
+{
+  guint32 hash = 2166136261u;
+
+  for (gsize i = 0; i < i_size; ++i)
+  {
+    hash ^= i_data[i];
+    hash *= 16777619u;
+  }
+  return hash ? hash : 1;
+}
+
+/* the part of a dictionary APDU's payload both sides keep */
+static GBytes* gst_pgm_compress_dict_new (const guint8* i_data, gsize i_size, guint32* o_id)
+{
+  const gsize size = MIN (i_size, GST_PGM_COMPRESS_DICT_SIZE);
+  const guint8* tail = i_data + i_size - size;
+
+  *o_id = gst_pgm_compress_dict_id (tail, size);
+  return g_bytes_new (tail, size);
+}
+
+void gst_pgm_deflate_init (GstPgmDeflate* o_deflate)
+{
+  o_deflate->dict      = NULL;
+  o_deflate->dict_id   = 0;
+  o_deflate->dict_next = 0;
+  o_deflate->skip      = 0;
+  o_deflate->backoff   = 0;
+  o_deflate->lz4       = NULL;
+  o_deflate->lz4_dict  = NULL;
+}
+
+void gst_pgm_deflate_clear (GstPgmDeflate* io_deflate)
+{
+  if (io_deflate->dict) g_bytes_unref (io_deflate->dict);
+  if (io_deflate->lz4) LZ4_freeStream (io_deflate->lz4);
+  if (io_deflate->lz4_dict) LZ4_freeStream (io_deflate->lz4_dict);
+  gst_pgm_deflate_init (io_deflate);
+}
+
+/* Index a new dictionary once, APDUs only attach to it. FALSE leaves
+ * the stream without one.
+ */
+static gboolean gst_pgm_deflate_load_dict (GstPgmDeflate* io_deflate)
+{
+  if (NULL == io_deflate->lz4_dict) io_deflate->lz4_dict = LZ4_createStream ();
+  if (NULL == io_deflate->lz4_dict) return FALSE;
+
+  gsize dict_size;
+  const gchar* dict = g_bytes_get_data (io_deflate->dict, &dict_size);
+
+  LZ4_loadDict (io_deflate->lz4_dict, dict, dict_size);
+  return TRUE;
+}
+
+/* Compress one payload into o_out and announce it in io_frame, FALSE if it
+ * goes out as it is. Only reliable APDUs may carry a new dictionary, i_dict_interval
+ * in milliseconds, 0 for none.
+ */
+gboolean gst_pgm_deflate (GstPgmDeflate* io_deflate, const guint8* i_data, gsize i_size, gboolean i_reliable, guint i_dict_interval, GByteArray* o_out, GstPgmFrameHeader* io_frame)
+{
+  if (i_size < GST_PGM_COMPRESS_MIN_SIZE || i_size > GST_PGM_COMPRESS_MAX_SIZE) return FALSE;
+
+  const gint64 now = g_get_monotonic_time ();
+  if (i_reliable && i_dict_interval > 0 && now >= io_deflate->dict_next)
+  {
+    if (io_deflate->dict) g_bytes_unref (io_deflate->dict);
+    io_deflate->dict      = gst_pgm_compress_dict_new (i_data, i_size, &io_deflate->dict_id);
+    io_deflate->dict_next = now + (gint64) i_dict_interval * 1000;
+    io_frame->flags |= GST_PGM_FRAME_FLAG_DICTIONARY;
+
+    if (!gst_pgm_deflate_load_dict (io_deflate))
+    {
+      /* receivers get the dictionary all the same, it is just not used */
+      g_bytes_unref (io_deflate->dict);
+      io_deflate->dict    = NULL;
+      io_deflate->dict_id = 0;
+    }
+    return FALSE;
+  }
+  if (0 == i_dict_interval && io_deflate->dict)
+  {
+    g_bytes_unref (io_deflate->dict);
+    io_deflate->dict    = NULL;
+    io_deflate->dict_id = 0;
+  }
+
+  if (io_deflate->skip > 0)
+  {
+    io_deflate->skip--;
+    return FALSE;
+  }
+
+  g_byte_array_set_size (o_out, LZ4_compressBound (i_size));
+
+  int size;
+  if (io_deflate->dict)
+  {
+    if (NULL == io_deflate->lz4) io_deflate->lz4 = LZ4_createStream ();
+    if (NULL == io_deflate->lz4) return FALSE;
+
+    LZ4_resetStream_fast (io_deflate->lz4);
+    LZ4_attach_dictionary (io_deflate->lz4, io_deflate->lz4_dict);
+    size = LZ4_compress_fast_continue (io_deflate->lz4, (const gchar*) i_data, (gchar*) o_out->data, i_size, o_out->len, 1);
+  }
+  else
+  {
+    size = LZ4_compress_default ((const gchar*) i_data, (gchar*) o_out->data, i_size, o_out->len);
+  }
+
+  if (size <= 0 || (gsize) size > i_size - i_size / 8)
+  {
+    io_deflate->backoff = CLAMP (io_deflate->backoff * 2, 1, GST_PGM_COMPRESS_BACKOFF_MAX);
+    io_deflate->skip    = io_deflate->backoff;
+    return FALSE;
+  }
+  io_deflate->backoff = 0;
+
+  g_byte_array_set_size (o_out, size);
+  io_frame->original_size = i_size;
+  io_frame->dictionary    = io_deflate->dict_id;
+  io_frame->flags |= GST_PGM_FRAME_FLAG_COMPRESSED;
+  return TRUE;
+}
+
+void gst_pgm_inflate_init (GstPgmInflate* o_inflate)
+{
+  o_inflate->dict[0]    = NULL;
+  o_inflate->dict[1]    = NULL;
+  o_inflate->dict_id[0] = 0;
+  o_inflate->dict_id[1] = 0;
+  o_inflate->dict_last  = 0;
+}
+
+void gst_pgm_inflate_clear (GstPgmInflate* io_inflate)
+{
+  if (io_inflate->dict[0]) g_bytes_unref (io_inflate->dict[0]);
+  if (io_inflate->dict[1]) g_bytes_unref (io_inflate->dict[1]);
+  gst_pgm_inflate_init (io_inflate);
+}
+
+/* the payload of an APDU with the dictionary flag, replaces the older of
+ * the two dictionaries kept
+ */
+void gst_pgm_inflate_dictionary (GstPgmInflate* io_inflate, const guint8* i_data, gsize i_size)
+{
+  guint32 id;
+  GBytes* dict = gst_pgm_compress_dict_new (i_data, i_size, &id);
+
+  if (id == io_inflate->dict_id[io_inflate->dict_last])
+  {
+    g_bytes_unref (dict);
+    return;
+  }
+
+  const guint slot = io_inflate->dict_last ^ 1;
+  if (io_inflate->dict[slot]) g_bytes_unref (io_inflate->dict[slot]);
+  io_inflate->dict[slot]    = dict;
+  io_inflate->dict_id[slot] = id;
+  io_inflate->dict_last     = slot;
+}
+
+/* The payload of an APDU with the compressed flag in a buffer of its own
+ * from io_allocator, NULL if its dictionary is missing or it does not
+ * decompress.
+ */
+GstBuffer* gst_pgm_inflate (GstPgmInflate* io_inflate, GstAllocator* io_allocator, const GstPgmFrameHeader* i_frame, const guint8* i_data, gsize i_size)
+{
+  const gchar* dict = NULL;
+  gsize dict_size = 0;
+
+  if (i_frame->original_size > GST_PGM_COMPRESS_MAX_SIZE) return NULL;
+
+  if (i_frame->dictionary)
+  {
+    guint slot;
+    for (slot = 0; slot < 2; ++slot)
+    {
+      if (io_inflate->dict[slot] && io_inflate->dict_id[slot] == i_frame->dictionary) break;
+    }
+    if (2 == slot) return NULL;
+
+    dict = g_bytes_get_data (io_inflate->dict[slot], &dict_size);
+  }
+
+  GstBuffer* buffer = gst_buffer_new_allocate (io_allocator, i_frame->original_size, NULL);
+  if (NULL == buffer) return NULL;
+
+  GstMapInfo map;
+  gst_buffer_map (buffer, &map, (GstMapFlags)GST_MAP_WRITE);
+
+  const int size = dict
+    ? LZ4_decompress_safe_usingDict ((const gchar*) i_data, (gchar*) map.data, i_size, map.size, dict, dict_size)
+    : LZ4_decompress_safe ((const gchar*) i_data, (gchar*) map.data, i_size, map.size);
+
+  gst_buffer_unmap (buffer, &map);
+
+  if (size < 0 || (guint32) size != i_frame->original_size)
+  {
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+  return buffer;
+}
@@ -0,0 +1,96 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per-APDU compression
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_COMPRESS_H
+#define GST_PGM_COMPRESS_H
+
+#include <gst/gst.h>
+
+#include "GstPGMFrame.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_COMPRESSION  (gst_pgm_compression_get_type())
+
+/* How pgmsink shrinks payloads before framing them.
+ */
+typedef enum
+{
+  GST_PGM_COMPRESSION_NONE  = 0,
+  GST_PGM_COMPRESSION_LZ4   = 1
+} GstPgmCompression;
+
+/* Payloads of a stream repeat themselves across APDUs more than within
+ * one, so every dictionary-interval a reliable APDU goes out uncompressed
+ * with the dictionary flag and the last GST_PGM_COMPRESS_DICT_SIZE bytes
+ * of its payload become the dictionary later ones are compressed against.
+ * A dictionary is known by a hash of its bytes, receivers keep the last
+ * two so that APDUs compressed against the previous one still decode
+ * while the new one arrives.
+ *
+ * Payloads that do not shrink by an eighth go out as they are, and the
+ * next 1, 2, 4 ... GST_PGM_COMPRESS_BACKOFF_MAX are not even tried, so
+ * that encoded video costs next to nothing.
+ */
+#define GST_PGM_COMPRESS_DICT_SIZE    ( 16 << 10 )
+#define GST_PGM_COMPRESS_MIN_SIZE     64
+#define GST_PGM_COMPRESS_BACKOFF_MAX  64
+#define GST_PGM_COMPRESS_MAX_SIZE     ( 64 << 20 )
+
+/* sender side, one per stream */
+typedef struct _GstPgmDeflate GstPgmDeflate;
+
+struct _GstPgmDeflate
+{
+  GBytes*   dict;
+  guint32   dict_id;
+  gint64    dict_next;    // monotonic, microseconds
+  guint     skip;         // APDUs left to send without trying
+  guint     backoff;
+  gpointer  lz4;          // LZ4_stream_t
+  gpointer  lz4_dict;     // LZ4_stream_t with dict loaded, attached to lz4 per APDU
+};
+
+/* receiver side, one per stream */
+typedef struct _GstPgmInflate GstPgmInflate;
+
+struct _GstPgmInflate
+{
+  GBytes*   dict[2];
+  guint32   dict_id[2];
+  guint     dict_last;
+};
+
+GType       gst_pgm_compression_get_type (void);
+
+void        gst_pgm_deflate_init (GstPgmDeflate*);
+void        gst_pgm_deflate_clear (GstPgmDeflate*);
+gboolean    gst_pgm_deflate (GstPgmDeflate*, const guint8*, gsize, gboolean, guint, GByteArray*, GstPgmFrameHeader*);
+
+void        gst_pgm_inflate_init (GstPgmInflate*);
+void        gst_pgm_inflate_clear (GstPgmInflate*);
+void        gst_pgm_inflate_dictionary (GstPgmInflate*, const guint8*, gsize);
+GstBuffer*  gst_pgm_inflate (GstPgmInflate*, GstAllocator*, const GstPgmFrameHeader*, const guint8*, gsize);
+
+G_END_DECLS
+
+#endif // GST_PGM_COMPRESS_H
@@ -8,10 +8,15 @@
 #define PGM_DEFAULT_MAX_TPDU         1500
 #define PGM_DEFAULT_TXW_SQNS         64
 #define PGM_DEFAULT_RXW_SQNS         64
+#define PGM_DEFAULT_TXW_SECS         0
+#define PGM_DEFAULT_RXW_SECS         0
+#define PGM_DEFAULT_MAX_RATE         0       // bits per second
+#define PGM_DEFAULT_WINDOW_BUDGET    0       // bytes
 #define PGM_DEFAULT_HOPS             16
 #define PGM_DEFAULT_SPM_AMBIENT      ( pgm_secs(30) )
 #define PGM_DEFAULT_IHB_MIN          ( pgm_msecs(100) )
 #define PGM_DEFAULT_IHB_MAX          ( pgm_secs(30) )
+#define PGM_DEFAULT_HEARTBEAT_SPM    "100000,100000,100000,100000,1300000,7000000,16000000,25000000,30000000"
 #define PGM_DEFAULT_PEER_EXPIRY      ( pgm_secs(300) )
 #define PGM_DEFAULT_SPMR_EXPIRY      ( pgm_msecs(250) )
 #define PGM_DEFAULT_NAK_BO_IVL       ( pgm_msecs(50) )
@@ -19,5 +24,24 @@
 #define PGM_DEFAULT_NAK_RDATA_IVL    ( pgm_secs(2) )
 #define PGM_DEFAULT_NAK_DATA_RETRIES 5
 #define PGM_DEFAULT_NAK_NCF_RETRIES  2
+#define PGM_DEFAULT_PGMCC_ACK_BO_IVL ( pgm_msecs(50) )
+#define PGM_DEFAULT_PGMCC_ACK_C      75
+#define PGM_DEFAULT_PGMCC_ACK_C_P    500
+#define PGM_DEFAULT_NAK_ADAPT_MIN    ( pgm_msecs(1) )
+#define PGM_DEFAULT_NAK_ADAPT_MAX    ( pgm_secs(2) )
+#define PGM_DEFAULT_STATS_INTERVAL   1000   // milliseconds
+#define PGM_DEFAULT_CLOCK_INTERVAL   100    // milliseconds
+#define PGM_DEFAULT_LATENCY          0      // milliseconds
+#define PGM_DEFAULT_DROPPABLE_PORT   0
+#define PGM_DEFAULT_DROPPABLE_NAK_IVL ( pgm_msecs(10) )
+#define PGM_DEFAULT_WAIT_KEYFRAME    FALSE
+#define PGM_DEFAULT_MAX_QUEUE_TIME   200    // milliseconds
+#define PGM_DEFAULT_REPLAY_REALTIME  TRUE
+#define PGM_DEFAULT_SHM_SIZE         0             // bytes, a ring turns multicast loopback off
+#define PGM_DEFAULT_SHM              TRUE
+#define PGM_DEFAULT_KEY_EPOCH        0
+#define PGM_DEFAULT_DICTIONARY_INTERVAL 1000  // milliseconds
+#define PGM_DEFAULT_HUGEPAGES        TRUE
+#define PGM_DEFAULT_PEER_THRESHOLD   10     // percent
 
 #define GST_PACKAGE_NAME  PACKAGE
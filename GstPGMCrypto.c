@@ -0,0 +1,258 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer APDU encryption
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "GstPGMCrypto.h"
+
+typedef struct
+{
+  guint32          epoch;
+  EVP_CIPHER_CTX*  seal;    // key schedule set up, created on first use
+  EVP_CIPHER_CTX*  open;
+  const EVP_CIPHER* cipher;
+  guint8           key[32];
+} GstPgmCryptoKey;
+
+struct _GstPgmCrypto
+{
+  gint     ref;
+  GArray*  keys;      // GstPgmCryptoKey
+  guint32  salt;
+  guint64  counter;
+};
+
+static gboolean gst_pgm_crypto_parse_key (const gchar* i_spec, GstPgmCryptoKey* o_key)
+{
+  gchar* end = NULL;
+  const guint64 epoch = g_ascii_strtoull (i_spec, &end, 10);
+
+  if (end == i_spec || ':' != *end || epoch > G_MAXUINT32) return FALSE;
+
+  const gchar* hex = g_strstrip (end + 1);
+  const gsize len = strlen (hex) / 2;
+
+  if (strlen (hex) % 2 || (16 != len && 32 != len)) return FALSE;
+  for (gsize i = 0; i < len; ++i)
+  {
+    const gint hi = g_ascii_xdigit_value (hex[2 * i]);
+    const gint lo = g_ascii_xdigit_value (hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return FALSE;
+    o_key->key[i] = (guint8) (hi << 4 | lo);
+  }
+
+  o_key->epoch  = (guint32) epoch;
+  o_key->cipher = (16 == len) ? EVP_aes_128_gcm () : EVP_aes_256_gcm ();
+  o_key->seal   = NULL;
+  o_key->open   = NULL;
+  return TRUE;
+}
+
+static void gst_pgm_crypto_key_clear (gpointer io_key)
+{
+  GstPgmCryptoKey* key = io_key;
+
+  if (key->seal) EVP_CIPHER_CTX_free (key->seal);
+  if (key->open) EVP_CIPHER_CTX_free (key->open);
+  memset (key->key, 0, sizeof(key->key));
+}
+
+GstPgmCrypto* gst_pgm_crypto_new (const gchar* i_keys, GError** o_err)
+{
+  gchar** specs = g_strsplit (i_keys, ",", -1);
+  GstPgmCrypto* crypto = g_new0 (GstPgmCrypto, 1);
+
+  crypto->ref     = 1;
+  crypto->keys    = g_array_new (FALSE, TRUE, sizeof(GstPgmCryptoKey));
+  crypto->salt    = g_random_int ();
+  crypto->counter = g_get_real_time ();
+  g_array_set_clear_func (crypto->keys, gst_pgm_crypto_key_clear);
+
+  for (gchar** spec = specs; *spec; ++spec)
+  {
+    GstPgmCryptoKey key;
+
+    if (!gst_pgm_crypto_parse_key (g_strstrip (*spec), &key) || gst_pgm_crypto_has_epoch (crypto, key.epoch))
+    {
+      g_set_error (o_err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "key %u is not epoch:hex-key with a 128 or 256 bit key, or its epoch is there twice", (guint) (spec - specs));
+      memset (&key, 0, sizeof(key));
+      g_strfreev (specs);
+      gst_pgm_crypto_unref (crypto);
+      return NULL;
+    }
+    g_array_append_val (crypto->keys, key);
+    memset (&key, 0, sizeof(key));
+  }
+  g_strfreev (specs);
+
+  if (0 == crypto->keys->len)
+  {
+    g_set_error (o_err, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS, "no keys");
+    gst_pgm_crypto_unref (crypto);
+    return NULL;
+  }
+  return crypto;
+}
+
+GstPgmCrypto* gst_pgm_crypto_ref (GstPgmCrypto* io_crypto)
+{
+  g_atomic_int_inc (&io_crypto->ref);
+  return io_crypto;
+}
+
+void gst_pgm_crypto_unref (GstPgmCrypto* io_crypto)
+{
+  if (NULL == io_crypto || !g_atomic_int_dec_and_test (&io_crypto->ref)) return;
+
+  g_array_free (io_crypto->keys, TRUE);
+  g_free (io_crypto);
+}
+
+static GstPgmCryptoKey* gst_pgm_crypto_find (const GstPgmCrypto* i_crypto, guint32 i_epoch)
+{
+  for (guint i = 0; i < i_crypto->keys->len; ++i)
+  {
+    GstPgmCryptoKey* key = &g_array_index (i_crypto->keys, GstPgmCryptoKey, i);
+    if (key->epoch == i_epoch) return key;
+  }
+  return NULL;
+}
+
+gboolean gst_pgm_crypto_has_epoch (const GstPgmCrypto* i_crypto, guint32 i_epoch)
+{
+  return NULL != gst_pgm_crypto_find (i_crypto, i_epoch);
+}
+
+/* the context of a key with its schedule, once per key and direction
+ */
+static EVP_CIPHER_CTX* gst_pgm_crypto_context (GstPgmCryptoKey* io_key, gboolean i_seal)
+{
+  EVP_CIPHER_CTX** ctx = i_seal ? &io_key->seal : &io_key->open;
+
+  if (NULL == *ctx)
+  {
+    *ctx = EVP_CIPHER_CTX_new ();
+    if (NULL == *ctx) return NULL;
+
+    if (1 != EVP_CipherInit_ex (*ctx, io_key->cipher, NULL, io_key->key, NULL, i_seal ? 1 : 0))
+    {
+      EVP_CIPHER_CTX_free (*ctx);
+      *ctx = NULL;
+    }
+  }
+  return *ctx;
+}
+
+/* Seal the APDU in the vector under the key of the epoch into o_data,
+ * which takes its size plus GST_PGM_CRYPTO_OVERHEAD bytes.
+ */
+gboolean gst_pgm_crypto_seal (GstPgmCrypto* io_crypto, guint32 i_epoch, const struct pgm_iovec* i_vector, unsigned i_count, guint8* o_data)
+{
+  GstPgmCryptoKey* key = gst_pgm_crypto_find (io_crypto, i_epoch);
+  if (NULL == key) return FALSE;
+
+  EVP_CIPHER_CTX* ctx = gst_pgm_crypto_context (key, TRUE);
+  if (NULL == ctx) return FALSE;
+
+  guint8* nonce = o_data + 6;
+  o_data[0] = GST_PGM_CRYPTO_MAGIC;
+  o_data[1] = GST_PGM_CRYPTO_VERSION;
+  GST_WRITE_UINT32_BE (o_data + 2, i_epoch);
+  GST_WRITE_UINT32_BE (nonce, io_crypto->salt);
+  GST_WRITE_UINT64_BE (nonce + 4, io_crypto->counter++);
+
+  guint8* p = o_data + GST_PGM_CRYPTO_HEADER_SIZE;
+  int len;
+
+  if (1 != EVP_EncryptInit_ex (ctx, NULL, NULL, NULL, nonce)) return FALSE;
+  if (1 != EVP_EncryptUpdate (ctx, NULL, &len, o_data, GST_PGM_CRYPTO_HEADER_SIZE)) return FALSE;
+
+  for (unsigned i = 0; i < i_count; ++i)
+  {
+    if (1 != EVP_EncryptUpdate (ctx, p, &len, i_vector[i].iov_base, i_vector[i].iov_len)) return FALSE;
+    p += len;
+  }
+
+  if (1 != EVP_EncryptFinal_ex (ctx, p, &len)) return FALSE;
+  p += len;
+
+  return 1 == EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_GET_TAG, GST_PGM_CRYPTO_TAG_SIZE, p);
+}
+
+/* Open a sealed APDU of i_len bytes straight out of the fragments into
+ * o_data, which takes i_len - GST_PGM_CRYPTO_OVERHEAD bytes. FALSE if it
+ * is not sealed, under an unknown epoch or does not authenticate.
+ */
+gboolean gst_pgm_crypto_open (GstPgmCrypto* io_crypto, const struct pgm_msgv_t* i_msgv, gsize i_len, guint8* o_data)
+{
+  const struct pgm_sk_buff_t* first = i_msgv->msgv_skb[0];
+  const guint8* header = first->data;
+
+  if (i_len < GST_PGM_CRYPTO_OVERHEAD || first->len < GST_PGM_CRYPTO_HEADER_SIZE) return FALSE;
+  if (GST_PGM_CRYPTO_MAGIC != header[0] || GST_PGM_CRYPTO_VERSION != header[1]) return FALSE;
+
+  GstPgmCryptoKey* key = gst_pgm_crypto_find (io_crypto, GST_READ_UINT32_BE (header + 2));
+  if (NULL == key) return FALSE;
+
+  EVP_CIPHER_CTX* ctx = gst_pgm_crypto_context (key, FALSE);
+  if (NULL == ctx) return FALSE;
+
+  int len;
+
+  if (1 != EVP_DecryptInit_ex (ctx, NULL, NULL, NULL, header + 6)) return FALSE;
+  if (1 != EVP_DecryptUpdate (ctx, NULL, &len, header, GST_PGM_CRYPTO_HEADER_SIZE)) return FALSE;
+
+  /* cipher text and tag may both run over fragment boundaries */
+  const gsize cipher_end = i_len - GST_PGM_CRYPTO_TAG_SIZE;
+  guint8 tag[GST_PGM_CRYPTO_TAG_SIZE];
+  guint8* p = o_data;
+  gsize offset = 0;
+
+  for (unsigned j = 0; j < i_msgv->msgv_len; ++j)
+  {
+    const guint8* data = i_msgv->msgv_skb[j]->data;
+    const gsize begin = offset;
+    const gsize end = offset + i_msgv->msgv_skb[j]->len;
+    offset = end;
+
+    const gsize from = MAX (begin, GST_PGM_CRYPTO_HEADER_SIZE);
+    const gsize to   = MIN (end, cipher_end);
+    if (from < to)
+    {
+      if (1 != EVP_DecryptUpdate (ctx, p, &len, data + (from - begin), to - from)) return FALSE;
+      p += len;
+    }
+
+    if (end > cipher_end)
+    {
+      const gsize tag_from = MAX (begin, cipher_end);
+      memcpy (tag + (tag_from - cipher_end), data + (tag_from - begin), end - tag_from);
+    }
+  }
+
+  if (offset != i_len) return FALSE;
+  if (1 != EVP_CIPHER_CTX_ctrl (ctx, EVP_CTRL_GCM_SET_TAG, GST_PGM_CRYPTO_TAG_SIZE, tag)) return FALSE;
+
+  return 1 == EVP_DecryptFinal_ex (ctx, p, &len);
+}
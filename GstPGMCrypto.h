@@ -0,0 +1,68 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer APDU encryption
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_CRYPTO_H
+#define GST_PGM_CRYPTO_H
+
+#include <gst/gst.h>
+
+#include <pgm/pgm.h>
+
+G_BEGIN_DECLS
+
+/* An encrypted APDU, the plain one, frame header included, sealed with
+ * AES-GCM under the key of an epoch:
+ *
+ *   0       1       2               6                       18
+ *   +-------+-------+---------------+-----------------------+----------+-----+
+ *   | magic |version|     epoch     |         nonce         |  cipher  | tag |
+ *   +-------+-------+---------------+-----------------------+----------+-----+
+ *
+ * The first 18 bytes are authenticated along, the tag is 16 bytes. The
+ * nonce is 32 random bits chosen per key set and a 64 bit counter started
+ * at the wall clock in microseconds, so it does not repeat across restarts
+ * with the same keys.
+ */
+#define GST_PGM_CRYPTO_MAGIC        0xA9
+#define GST_PGM_CRYPTO_VERSION      1
+#define GST_PGM_CRYPTO_HEADER_SIZE  18
+#define GST_PGM_CRYPTO_TAG_SIZE     16
+#define GST_PGM_CRYPTO_OVERHEAD     (GST_PGM_CRYPTO_HEADER_SIZE + GST_PGM_CRYPTO_TAG_SIZE)
+
+/* Keys by epoch, parsed from "epoch:hex-key[,epoch:hex-key...]" with 128
+ * or 256 bit keys. The cipher contexts are set up once per key, sealing
+ * or opening an APDU only sets the nonce. Not thread safe, shared by
+ * reference between the one thread that uses it and property changes.
+ */
+typedef struct _GstPgmCrypto GstPgmCrypto;
+
+GstPgmCrypto*  gst_pgm_crypto_new (const gchar*, GError**);
+GstPgmCrypto*  gst_pgm_crypto_ref (GstPgmCrypto*);
+void           gst_pgm_crypto_unref (GstPgmCrypto*);
+
+gboolean       gst_pgm_crypto_has_epoch (const GstPgmCrypto*, guint32);
+gboolean       gst_pgm_crypto_seal (GstPgmCrypto*, guint32, const struct pgm_iovec*, unsigned, guint8*);
+gboolean       gst_pgm_crypto_open (GstPgmCrypto*, const struct pgm_msgv_t*, gsize, guint8*);
+
+G_END_DECLS
+
+#endif // GST_PGM_CRYPTO_H
@@ -0,0 +1,240 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer in-band APDU framing
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "GstPGMFrame.h"
+
+GType gst_pgm_framing_get_type (void)
+{
+  static GType framing_type = 0;
+  static const GEnumValue framing[] =
+    { { GST_PGM_FRAMING_RAW      , "Raw payload bytes"                    , "raw"       }
+    , { GST_PGM_FRAMING_SEQUENCED, "Frame header with sequence number"    , "sequenced" }
+    , { GST_PGM_FRAMING_NATIVE   , "Frame header with timestamps and caps", "native"    }
+    , { 0, NULL, NULL }
+    };
+
+  if (!framing_type)
+  {
+    framing_type = g_enum_register_static ("GstPgmFraming", framing);
+  }
+  return framing_type;
+}
+
+/* bytes gst_pgm_frame_write_header needs for this header
+ */
+gsize gst_pgm_frame_header_size (const GstPgmFrameHeader* i_header)
+{
+  gsize size = GST_PGM_FRAME_HEADER_SIZE;
+
+  if (i_header->flags & GST_PGM_FRAME_FLAG_PTS)          size += 8;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_DTS)          size += 8;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_DURATION)     size += 8;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_BUFFER_FLAGS) size += 4;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_CAPS)         size += 2 + i_header->caps_len;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_CLOCK)        size += 16;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_STREAM)       size += 2;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_ANCHOR)       size += 4;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_COMPRESSED)   size += 8;
+  if (i_header->flags & GST_PGM_FRAME_FLAG_SENT)         size += 12;
+
+  return size;
+}
+
+/* serialise a frame header with its optional fields, returns the number
+ * of bytes written
+ */
+gsize gst_pgm_frame_write_header (guint8* o_data, const GstPgmFrameHeader* i_header)
+{
+  guint8* p = o_data + GST_PGM_FRAME_HEADER_SIZE;
+
+  o_data[0] = GST_PGM_FRAME_MAGIC;
+  o_data[1] = GST_PGM_FRAME_VERSION;
+  GST_WRITE_UINT16_BE (o_data + 2, i_header->flags);
+  GST_WRITE_UINT32_BE (o_data + 4, i_header->sequence);
+
+  if (i_header->flags & GST_PGM_FRAME_FLAG_PTS)
+  {
+    GST_WRITE_UINT64_BE (p, i_header->pts);
+    p += 8;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_DTS)
+  {
+    GST_WRITE_UINT64_BE (p, i_header->dts);
+    p += 8;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_DURATION)
+  {
+    GST_WRITE_UINT64_BE (p, i_header->duration);
+    p += 8;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_BUFFER_FLAGS)
+  {
+    GST_WRITE_UINT32_BE (p, i_header->buffer_flags);
+    p += 4;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_CAPS)
+  {
+    GST_WRITE_UINT16_BE (p, i_header->caps_len);
+    memcpy (p + 2, i_header->caps, i_header->caps_len);
+    p += 2 + i_header->caps_len;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_CLOCK)
+  {
+    GST_WRITE_UINT64_BE (p, i_header->clock_time);
+    GST_WRITE_UINT64_BE (p + 8, i_header->base_time);
+    p += 16;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_STREAM)
+  {
+    GST_WRITE_UINT16_BE (p, i_header->stream_id);
+    p += 2;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_ANCHOR)
+  {
+    GST_WRITE_UINT32_BE (p, i_header->anchor);
+    p += 4;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_COMPRESSED)
+  {
+    GST_WRITE_UINT32_BE (p, i_header->original_size);
+    GST_WRITE_UINT32_BE (p + 4, i_header->dictionary);
+    p += 8;
+  }
+  if (i_header->flags & GST_PGM_FRAME_FLAG_SENT)
+  {
+    GST_WRITE_UINT64_BE (p, i_header->sent);
+    GST_WRITE_UINT32_BE (p + 8, i_header->sender_queue);
+    p += 12;
+  }
+
+  return p - o_data;
+}
+
+/* parse the fixed part of a frame header, FALSE if the APDU does not start
+ * with one
+ */
+gboolean gst_pgm_frame_read_header (const guint8* i_data, gsize i_size, GstPgmFrameHeader* o_header)
+{
+  if (i_size < GST_PGM_FRAME_HEADER_SIZE)   return FALSE;
+  if (i_data[0] != GST_PGM_FRAME_MAGIC)     return FALSE;
+  if (i_data[1] != GST_PGM_FRAME_VERSION)   return FALSE;
+
+  o_header->flags    = GST_READ_UINT16_BE (i_data + 2);
+  o_header->sequence = GST_READ_UINT32_BE (i_data + 4);
+
+  o_header->pts          = GST_CLOCK_TIME_NONE;
+  o_header->dts          = GST_CLOCK_TIME_NONE;
+  o_header->duration     = GST_CLOCK_TIME_NONE;
+  o_header->buffer_flags = 0;
+  o_header->caps         = NULL;
+  o_header->caps_len     = 0;
+  o_header->clock_time   = GST_CLOCK_TIME_NONE;
+  o_header->base_time    = GST_CLOCK_TIME_NONE;
+  o_header->stream_id    = 0;
+  o_header->anchor       = 0;
+  o_header->original_size = 0;
+  o_header->dictionary   = 0;
+  o_header->sent         = GST_CLOCK_TIME_NONE;
+  o_header->sender_queue = 0;
+
+  return TRUE;
+}
+
+/* parse the optional fields announced by a header gst_pgm_frame_read_header
+ * accepted, returns the size of the whole header or 0 if the APDU is too
+ * short for them
+ */
+gsize gst_pgm_frame_read_fields (const guint8* i_data, gsize i_size, GstPgmFrameHeader* io_header)
+{
+  const guint8* p = i_data + GST_PGM_FRAME_HEADER_SIZE;
+  const guint8* end = i_data + i_size;
+
+  if (io_header->flags & GST_PGM_FRAME_FLAG_PTS)
+  {
+    if (end - p < 8) return 0;
+    io_header->pts = GST_READ_UINT64_BE (p);
+    p += 8;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_DTS)
+  {
+    if (end - p < 8) return 0;
+    io_header->dts = GST_READ_UINT64_BE (p);
+    p += 8;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_DURATION)
+  {
+    if (end - p < 8) return 0;
+    io_header->duration = GST_READ_UINT64_BE (p);
+    p += 8;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_BUFFER_FLAGS)
+  {
+    if (end - p < 4) return 0;
+    io_header->buffer_flags = GST_READ_UINT32_BE (p) & GST_PGM_FRAME_BUFFER_FLAGS;
+    p += 4;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_CAPS)
+  {
+    if (end - p < 2) return 0;
+    io_header->caps_len = GST_READ_UINT16_BE (p);
+    if (end - p - 2 < io_header->caps_len) return 0;
+    io_header->caps = (const gchar*) p + 2;
+    p += 2 + io_header->caps_len;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_CLOCK)
+  {
+    if (end - p < 16) return 0;
+    io_header->clock_time = GST_READ_UINT64_BE (p);
+    io_header->base_time  = GST_READ_UINT64_BE (p + 8);
+    p += 16;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_STREAM)
+  {
+    if (end - p < 2) return 0;
+    io_header->stream_id = GST_READ_UINT16_BE (p);
+    p += 2;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_ANCHOR)
+  {
+    if (end - p < 4) return 0;
+    io_header->anchor = GST_READ_UINT32_BE (p);
+    p += 4;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_COMPRESSED)
+  {
+    if (end - p < 8) return 0;
+    io_header->original_size = GST_READ_UINT32_BE (p);
+    io_header->dictionary    = GST_READ_UINT32_BE (p + 4);
+    p += 8;
+  }
+  if (io_header->flags & GST_PGM_FRAME_FLAG_SENT)
+  {
+    if (end - p < 12) return 0;
+    io_header->sent         = GST_READ_UINT64_BE (p);
+    io_header->sender_queue = GST_READ_UINT32_BE (p + 8);
+    p += 12;
+  }
+
+  return p - i_data;
+}
@@ -0,0 +1,125 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer in-band APDU framing
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_FRAME_H
+#define GST_PGM_FRAME_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_FRAMING  (gst_pgm_framing_get_type())
+
+/* What travels in front of the payload of every APDU.
+ */
+typedef enum
+{
+  GST_PGM_FRAMING_RAW       = 0,  // payload bytes only
+  GST_PGM_FRAMING_SEQUENCED = 1,  // frame header carrying a content sequence number
+  GST_PGM_FRAMING_NATIVE    = 2   // sequence number plus timestamps, buffer flags and caps
+} GstPgmFraming;
+
+/* Frame header, network byte order on the wire:
+ *
+ *   0       1       2       3       4               8
+ *   +-------+-------+-------+-------+---------------+
+ *   | magic |version|     flags     |   sequence    |
+ *   +-------+-------+-------+-------+---------------+
+ *
+ * The sequence number counts APDUs, not PGM data packets, so that copies of
+ * the same buffer sent over independent sessions can be matched up again.
+ */
+#define GST_PGM_FRAME_MAGIC        0xA7
+#define GST_PGM_FRAME_VERSION      1
+#define GST_PGM_FRAME_HEADER_SIZE  8
+
+/* Flags announce optional fields, which follow the fixed header in this
+ * order:
+ *
+ *   PTS, DTS, duration   64 bit running time in nanoseconds each
+ *   buffer flags         32 bit, GST_PGM_FRAME_BUFFER_FLAGS of the buffer
+ *   caps                 16 bit length, then the caps as a string
+ *   clock                64 bit sender clock time when sent, 64 bit base time
+ *   stream               16 bit id of the elementary stream, none for the main one
+ *   anchor               32 bit sequence of the last reliable APDU before this
+ *                        droppable one
+ *   compressed           32 bit size of the payload before LZ4 compression, 32 bit
+ *                        id of the dictionary it was compressed with, 0 for none
+ *   sent                 64 bit sender wall clock when sent, in nanoseconds, 32 bit
+ *                        microseconds the buffer waited in the sender before that
+ *
+ * The dictionary flag has no field, it makes the tail of the payload the
+ * dictionary of the stream from then on. See GstPGMCompress.h.
+ */
+#define GST_PGM_FRAME_FLAG_PTS           (1 << 0)
+#define GST_PGM_FRAME_FLAG_DTS           (1 << 1)
+#define GST_PGM_FRAME_FLAG_DURATION      (1 << 2)
+#define GST_PGM_FRAME_FLAG_BUFFER_FLAGS  (1 << 3)
+#define GST_PGM_FRAME_FLAG_CAPS          (1 << 4)
+#define GST_PGM_FRAME_FLAG_CLOCK         (1 << 5)
+#define GST_PGM_FRAME_FLAG_STREAM        (1 << 6)
+#define GST_PGM_FRAME_FLAG_ANCHOR        (1 << 7)
+#define GST_PGM_FRAME_FLAG_COMPRESSED    (1 << 8)
+#define GST_PGM_FRAME_FLAG_DICTIONARY    (1 << 9)
+#define GST_PGM_FRAME_FLAG_SENT          (1 << 10)
+
+/* the buffer flags that mean something on the other side of the network */
+#define GST_PGM_FRAME_BUFFER_FLAGS \
+  ( GST_BUFFER_FLAG_DELTA_UNIT | GST_BUFFER_FLAG_HEADER | GST_BUFFER_FLAG_GAP \
+  | GST_BUFFER_FLAG_DROPPABLE  | GST_BUFFER_FLAG_MARKER | GST_BUFFER_FLAG_CORRUPTED )
+
+typedef struct _GstPgmFrameHeader GstPgmFrameHeader;
+
+struct _GstPgmFrameHeader
+{
+  guint16       flags;
+  guint32       sequence;
+
+  GstClockTime  pts;
+  GstClockTime  dts;
+  GstClockTime  duration;
+  guint32       buffer_flags;
+  const gchar*  caps;         // not NUL terminated when read
+  guint16       caps_len;
+  GstClockTime  clock_time;
+  GstClockTime  base_time;
+  guint16       stream_id;
+  guint32       anchor;
+  guint32       original_size;
+  guint32       dictionary;
+  GstClockTime  sent;
+  guint32       sender_queue;
+};
+
+GType     gst_pgm_framing_get_type (void);
+
+gsize     gst_pgm_frame_header_size (const GstPgmFrameHeader*);
+gsize     gst_pgm_frame_write_header (guint8*, const GstPgmFrameHeader*);
+gboolean  gst_pgm_frame_read_header (const guint8*, gsize, GstPgmFrameHeader*);
+gsize     gst_pgm_frame_read_fields (const guint8*, gsize, GstPgmFrameHeader*);
+
+/* serial number arithmetic on 32-bit content sequence numbers */
+#define GST_PGM_FRAME_SEQUENCE_DIFF(a,b)  ((gint32)((guint32)(a) - (guint32)(b)))
+
+G_END_DECLS
+
+#endif // GST_PGM_FRAME_H
@@ -0,0 +1,198 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer key unit detection
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "GstPGMKeyframe.h"
+
+/* H.264 NAL unit types a decoder can start from */
+#define H264_NAL_IDR        5
+#define H264_NAL_SPS        7
+#define H264_NAL_STAP_A     24
+#define H264_NAL_STAP_B     25
+#define H264_NAL_FU_A       28
+#define H264_NAL_FU_B       29
+
+/* the payload format of RTP caps, unknown for anything else
+ */
+GstPgmKeyframeCodec gst_pgm_keyframe_codec (const GstCaps* i_caps)
+{
+  if (NULL == i_caps || gst_caps_is_empty (i_caps) || gst_caps_is_any (i_caps)) return GST_PGM_KEYFRAME_UNKNOWN;
+
+  const GstStructure* s = gst_caps_get_structure (i_caps, 0);
+  if (!gst_structure_has_name (s, "application/x-rtp")) return GST_PGM_KEYFRAME_UNKNOWN;
+
+  const gchar* encoding = gst_structure_get_string (s, "encoding-name");
+  gint payload;
+
+  if (NULL == encoding)
+  {
+    /* H.263 has a static payload type */
+    if (gst_structure_get_int (s, "payload", &payload) && 34 == payload) return GST_PGM_KEYFRAME_H263;
+    return GST_PGM_KEYFRAME_UNKNOWN;
+  }
+  if (0 == g_ascii_strcasecmp (encoding, "H264"))      return GST_PGM_KEYFRAME_H264;
+  if (0 == g_ascii_strcasecmp (encoding, "H263"))      return GST_PGM_KEYFRAME_H263;
+  if (0 == g_ascii_strcasecmp (encoding, "H263-1998")) return GST_PGM_KEYFRAME_H263_1998;
+  if (0 == g_ascii_strcasecmp (encoding, "H263-2000")) return GST_PGM_KEYFRAME_H263_1998;
+  return GST_PGM_KEYFRAME_UNKNOWN;
+}
+
+static gboolean gst_pgm_keyframe_h264_nal (guint8 i_type)
+{
+  return H264_NAL_IDR == i_type || H264_NAL_SPS == i_type;
+}
+
+/* RFC 6184: an IDR slice or a sequence parameter set, alone, aggregated
+ * or in the first fragment
+ */
+static gboolean gst_pgm_keyframe_h264 (const guint8* i_data, gsize i_size)
+{
+  if (i_size < 1) return FALSE;
+
+  const guint8 type = i_data[0] & 0x1f;
+
+  switch (type)
+  {
+  case H264_NAL_STAP_A:
+  case H264_NAL_STAP_B:
+  {
+    gsize offset = (H264_NAL_STAP_B == type) ? 3 : 1;   // STAP-B has a DON
+
+    while (offset + 3 <= i_size)
+    {
+      const guint16 nal_size = GST_READ_UINT16_BE (i_data + offset);
+
+      if (0 == nal_size) break;
+      if (gst_pgm_keyframe_h264_nal (i_data[offset + 2] & 0x1f)) return TRUE;
+      offset += 2 + nal_size;
+    }
+    return FALSE;
+  }
+
+  case H264_NAL_FU_A:
+  case H264_NAL_FU_B:
+    if (i_size < 2) return FALSE;
+    return (i_data[1] & 0x80) && gst_pgm_keyframe_h264_nal (i_data[1] & 0x1f);
+
+  default:
+    return gst_pgm_keyframe_h264_nal (type);
+  }
+}
+
+/* RFC 2190: a packet starting with the picture start code, of a picture
+ * whose I bit says intra. Mode A has a 4 byte header, mode B 8 and mode C
+ * 12, told apart by the F and P bits.
+ */
+static gboolean gst_pgm_keyframe_h263 (const guint8* i_data, gsize i_size)
+{
+  gsize header;
+  gboolean inter;
+
+  if (i_size < 4) return FALSE;
+
+  if (0 == (i_data[0] & 0x80))
+  {
+    header = 4;
+    inter  = i_data[1] & 0x10;
+  }
+  else
+  {
+    header = (i_data[0] & 0x40) ? 12 : 8;
+    if (i_size < header) return FALSE;
+    inter  = i_data[4] & 0x80;
+  }
+
+  if (inter || i_size < header + 3) return FALSE;
+
+  /* PSC: 0000 0000 0000 0000 1000 00 */
+  const guint8* psc = i_data + header;
+  return 0 == psc[0] && 0 == psc[1] && 0x80 == (psc[2] & 0xfc);
+}
+
+static guint gst_pgm_keyframe_bits (const guint8* i_data, guint i_offset, guint i_count)
+{
+  guint value = 0;
+
+  for (guint i = i_offset; i < i_offset + i_count; ++i)
+  {
+    value = (value << 1) | ((i_data[i / 8] >> (7 - i % 8)) & 1);
+  }
+  return value;
+}
+
+/* RFC 4629: a packet with the P bit starts a picture, whose PSC has lost
+ * its first two zero bytes. The picture coding type is in PTYPE, or in
+ * PLUSPTYPE when the source format is "extended".
+ */
+static gboolean gst_pgm_keyframe_h263_1998 (const guint8* i_data, gsize i_size)
+{
+  if (i_size < 2) return FALSE;
+  if (0 == (i_data[0] & 0x04)) return FALSE;                    // P bit
+
+  const guint vrc = (i_data[0] & 0x02) ? 1 : 0;
+  const guint plen = ((i_data[0] & 0x01) << 5) | (i_data[1] >> 3);
+  const guint8* picture = i_data + 2 + vrc + plen;
+
+  /* PSC tail (6 bits), TR (8), PTYPE (13), UFEP (3), OPPTYPE (18), MPPTYPE (9) */
+  if (i_data + i_size < picture + 8) return FALSE;
+  if (0x20 != gst_pgm_keyframe_bits (picture, 0, 6)) return FALSE;
+
+  const guint source_format = gst_pgm_keyframe_bits (picture, 19, 3);
+  if (7 != source_format) return 0 == gst_pgm_keyframe_bits (picture, 22, 1);
+
+  const guint ufep = gst_pgm_keyframe_bits (picture, 22, 3);
+  const guint mpptype = (1 == ufep) ? 25 + 18 : 25;
+  return 0 == gst_pgm_keyframe_bits (picture, mpptype, 3);      // I picture
+}
+
+/* TRUE if an RTP packet of this payload format starts something a decoder
+ * can begin with
+ */
+gboolean gst_pgm_keyframe_rtp_is_key (GstPgmKeyframeCodec i_codec, const guint8* i_data, gsize i_size)
+{
+  if (i_size < 12 || 2 != (i_data[0] >> 6)) return FALSE;
+
+  gsize offset = 12 + 4 * (i_data[0] & 0x0f);   // CSRC list
+  if (i_data[0] & 0x10)                          // header extension
+  {
+    if (i_size < offset + 4) return FALSE;
+    offset += 4 + 4 * GST_READ_UINT16_BE (i_data + offset + 2);
+  }
+  if (i_size <= offset) return FALSE;
+
+  gsize size = i_size - offset;
+  if (i_data[0] & 0x20)                          // padding
+  {
+    const guint8 padding = i_data[i_size - 1];
+    if (padding >= size) return FALSE;
+    size -= padding;
+  }
+
+  switch (i_codec)
+  {
+  case GST_PGM_KEYFRAME_H264:      return gst_pgm_keyframe_h264 (i_data + offset, size);
+  case GST_PGM_KEYFRAME_H263:      return gst_pgm_keyframe_h263 (i_data + offset, size);
+  case GST_PGM_KEYFRAME_H263_1998: return gst_pgm_keyframe_h263_1998 (i_data + offset, size);
+  default:                         return TRUE;   // nothing to wait for
+  }
+}
@@ -0,0 +1,45 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer key unit detection
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_KEYFRAME_H
+#define GST_PGM_KEYFRAME_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* RTP payload formats whose packets tell whether they start a key unit.
+ */
+typedef enum
+{
+  GST_PGM_KEYFRAME_UNKNOWN = 0,
+  GST_PGM_KEYFRAME_H264,        // RFC 6184
+  GST_PGM_KEYFRAME_H263,        // RFC 2190
+  GST_PGM_KEYFRAME_H263_1998    // RFC 4629, H263-1998 and H263-2000
+} GstPgmKeyframeCodec;
+
+GstPgmKeyframeCodec gst_pgm_keyframe_codec (const GstCaps*);
+gboolean            gst_pgm_keyframe_rtp_is_key (GstPgmKeyframeCodec, const guint8*, gsize);
+
+G_END_DECLS
+
+#endif // GST_PGM_KEYFRAME_H
@@ -0,0 +1,309 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer one-way latency tracer
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include <pgm/pgm.h>
+
+#include "GstPGMLatencyTracer.h"
+#include "GstPGMSink.h"
+#include "GstPGMSrc.h"
+#include "GstPGMReplaySrc.h"
+#include "GstPGMMeta.h"
+
+#define PGM_LATENCY_DEFAULT_INTERVAL  5   // seconds
+
+static const gchar* const gst_pgm_latency_component_names[GST_PGM_LATENCY_COMPONENTS] =
+  { "sender-queue", "wire", "repair", "receiver-queue", "total" };
+
+typedef struct
+{
+  gchar*                  name;
+  gint64                  log_next;   // monotonic, microseconds
+  GstPgmLatencyHistogram  histograms[GST_PGM_LATENCY_COMPONENTS];
+} GstPgmLatencyReceiver;
+
+static GstTracerRecord* gst_pgm_latency_record = NULL;
+
+G_DEFINE_TYPE (GstPgmLatencyTracer, gst_pgm_latency_tracer, GST_TYPE_TRACER)
+
+static guint gst_pgm_latency_bucket (guint64 i_value)
+{
+  const guint64 sub = 1 << GST_PGM_LATENCY_SUB_BITS;
+
+  i_value = MIN (i_value, G_GUINT64_CONSTANT (1) << GST_PGM_LATENCY_MAX_BITS);
+  if (i_value < sub) return (guint) i_value;
+
+  const guint magnitude = (i_value >> 32)
+                        ? 32 + g_bit_storage ((gulong) (i_value >> 32)) - 1
+                        : g_bit_storage ((gulong) i_value) - 1;
+  const guint shift = magnitude - GST_PGM_LATENCY_SUB_BITS;
+  return ((shift + 1) << GST_PGM_LATENCY_SUB_BITS) + (guint) ((i_value >> shift) - sub);
+}
+
+/* the lowest value of a bucket, and the next bucket's is past its highest */
+static guint64 gst_pgm_latency_bucket_low (guint i_bucket)
+{
+  const guint64 sub = 1 << GST_PGM_LATENCY_SUB_BITS;
+
+  if (i_bucket < sub) return i_bucket;
+
+  const guint shift = (i_bucket >> GST_PGM_LATENCY_SUB_BITS) - 1;
+  return (sub + (i_bucket & (sub - 1))) << shift;
+}
+
+/* one sample in microseconds, negative ones as 0
+ */
+void gst_pgm_latency_histogram_add (GstPgmLatencyHistogram* io_histogram, gint64 i_value)
+{
+  const guint64 value = i_value > 0 ? (guint64) i_value : 0;
+
+  io_histogram->buckets[gst_pgm_latency_bucket (value)]++;
+  io_histogram->count++;
+  io_histogram->max = MAX (io_histogram->max, value);
+}
+
+/* the highest value of the bucket the quantile falls in, as HdrHistogram
+ * reports it, but no more than the largest sample
+ */
+guint64 gst_pgm_latency_histogram_percentile (const GstPgmLatencyHistogram* i_histogram, gdouble i_quantile)
+{
+  if (0 == i_histogram->count) return 0;
+
+  const guint64 rank = MAX (1, (guint64) (i_quantile * i_histogram->count + 0.5));
+  guint64 seen = 0;
+
+  for (guint i = 0; i < GST_PGM_LATENCY_BUCKETS; ++i)
+  {
+    seen += i_histogram->buckets[i];
+    if (seen >= rank) return MIN (gst_pgm_latency_bucket_low (i + 1) - 1, i_histogram->max);
+  }
+  return i_histogram->max;
+}
+
+/* the buckets with samples as "low:count" pairs, g_free the result
+ */
+gchar* gst_pgm_latency_histogram_to_string (const GstPgmLatencyHistogram* i_histogram)
+{
+  GString* s = g_string_new (NULL);
+
+  for (guint i = 0; i < GST_PGM_LATENCY_BUCKETS; ++i)
+  {
+    if (0 == i_histogram->buckets[i]) continue;
+    g_string_append_printf (s, "%s%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT, s->len ? "," : "", gst_pgm_latency_bucket_low (i), i_histogram->buckets[i]);
+  }
+  return g_string_free (s, FALSE);
+}
+
+/* a record per component with samples, then start over. Called with lock.
+ */
+static void gst_pgm_latency_tracer_log (GstPgmLatencyReceiver* io_receiver)
+{
+  for (guint c = 0; c < GST_PGM_LATENCY_COMPONENTS; ++c)
+  {
+    GstPgmLatencyHistogram* histogram = &io_receiver->histograms[c];
+    if (0 == histogram->count) continue;
+
+    gchar* buckets = gst_pgm_latency_histogram_to_string (histogram);
+    gst_tracer_record_log 
+      ( gst_pgm_latency_record
+      , io_receiver->name
+      , gst_pgm_latency_component_names[c]
+      , histogram->count
+      , gst_pgm_latency_histogram_percentile (histogram, 0.5)
+      , gst_pgm_latency_histogram_percentile (histogram, 0.9)
+      , gst_pgm_latency_histogram_percentile (histogram, 0.99)
+      , gst_pgm_latency_histogram_percentile (histogram, 0.999)
+      , histogram->max
+      , buckets
+      );
+    g_free (buckets);
+
+    memset (histogram, 0, sizeof(*histogram));
+  }
+}
+
+static void gst_pgm_latency_receiver_free (gpointer io_receiver)
+{
+  GstPgmLatencyReceiver* receiver = io_receiver;
+
+  g_free (receiver->name);
+  g_free (receiver);
+}
+
+/* element-new hook: senders stamp what they send once the tracer runs
+ */
+static void gst_pgm_latency_tracer_element_new (GObject* io_tracer, GstClockTime i_ts, GstElement* io_element)
+{
+  if (GST_IS_PGM_SINK (io_element)) g_object_set (io_element, "send-stamps", TRUE, NULL);
+}
+
+/* pad-push-pre hook: where the buffers of a pgmsrc come out, replayed
+ * ones were sent long ago
+ */
+static void gst_pgm_latency_tracer_push (GObject* io_tracer, GstClockTime i_ts, GstPad* i_pad, GstBuffer* i_buffer)
+{
+  GstPgmLatencyTracer* tracer = GST_PGM_LATENCY_TRACER (io_tracer);
+  GstObject* parent = GST_OBJECT_PARENT (i_pad);
+
+  if (NULL == parent || !GST_IS_PGM_SRC (parent) || GST_IS_PGM_REPLAY_SRC (parent)) return;
+
+  const GstPgmMeta* meta = gst_buffer_get_pgm_meta (i_buffer);
+  if (NULL == meta || !GST_CLOCK_TIME_IS_VALID (meta->sent) || !GST_CLOCK_TIME_IS_VALID (meta->arrival)) return;
+
+  /* arrivals are on the PGM clock, sent on the sender's wall clock */
+  const pgm_time_t now = pgm_time_update_now ();
+  const gint64 wall = g_get_real_time () - (gint64) now;
+  const gint64 arrival  = (gint64) (meta->arrival / GST_USECOND);
+  const gint64 original = GST_CLOCK_TIME_IS_VALID (meta->original_arrival) ? (gint64) (meta->original_arrival / GST_USECOND) : -1;
+  const gint64 sent     = (gint64) (meta->sent / GST_USECOND) - wall;
+
+  gint64 sample[GST_PGM_LATENCY_COMPONENTS];
+  sample[GST_PGM_LATENCY_SENDER_QUEUE]   = (gint64) (meta->sender_queue / GST_USECOND);
+  sample[GST_PGM_LATENCY_WIRE]           = (original >= 0 ? original : arrival) - sent;
+  sample[GST_PGM_LATENCY_REPAIR]         = meta->repaired ? (original >= 0 ? arrival - original : 0) : 0;
+  sample[GST_PGM_LATENCY_RECEIVER_QUEUE] = (gint64) now - arrival;
+  sample[GST_PGM_LATENCY_TOTAL]          = sample[GST_PGM_LATENCY_SENDER_QUEUE] + (gint64) now - sent;
+
+  /* fully repaired APDUs have no ODATA to tell the wire from the repair */
+  if (meta->repaired && original < 0)
+  {
+    sample[GST_PGM_LATENCY_REPAIR] = sample[GST_PGM_LATENCY_WIRE];
+    sample[GST_PGM_LATENCY_WIRE]   = 0;
+  }
+
+  g_mutex_lock (&tracer->lock);
+  GstPgmLatencyReceiver* receiver = g_hash_table_lookup (tracer->receivers, parent);
+  if (NULL == receiver)
+  {
+    receiver = g_new0 (GstPgmLatencyReceiver, 1);
+    receiver->name     = gst_object_get_path_string (parent);
+    receiver->log_next = g_get_monotonic_time () + (gint64) tracer->interval * G_USEC_PER_SEC;
+    g_hash_table_insert (tracer->receivers, parent, receiver);
+  }
+
+  for (guint c = 0; c < GST_PGM_LATENCY_COMPONENTS; ++c) gst_pgm_latency_histogram_add (&receiver->histograms[c], sample[c]);
+
+  if (tracer->interval > 0 && g_get_monotonic_time () >= receiver->log_next)
+  {
+    gst_pgm_latency_tracer_log (receiver);
+    receiver->log_next = g_get_monotonic_time () + (gint64) tracer->interval * G_USEC_PER_SEC;
+  }
+  g_mutex_unlock (&tracer->lock);
+}
+
+/* element-change-state-post hook: a pgmsrc that stops logs what is left,
+ * and is forgotten before the element may go
+ */
+static void gst_pgm_latency_tracer_change_state (GObject* io_tracer, GstClockTime i_ts, GstElement* i_element, GstStateChange i_transition, GstStateChangeReturn i_result)
+{
+  GstPgmLatencyTracer* tracer = GST_PGM_LATENCY_TRACER (io_tracer);
+
+  if (GST_STATE_CHANGE_PAUSED_TO_READY != i_transition || !GST_IS_PGM_SRC (i_element)) return;
+
+  g_mutex_lock (&tracer->lock);
+  GstPgmLatencyReceiver* receiver = g_hash_table_lookup (tracer->receivers, i_element);
+  if (receiver)
+  {
+    gst_pgm_latency_tracer_log (receiver);
+    g_hash_table_remove (tracer->receivers, i_element);
+  }
+  g_mutex_unlock (&tracer->lock);
+}
+
+/* params are those of the GST_TRACERS entry, "interval=10"
+ */
+static void gst_pgm_latency_tracer_constructed (GObject* io_obj)
+{
+  GstPgmLatencyTracer* tracer = GST_PGM_LATENCY_TRACER (io_obj);
+  gchar* params = NULL;
+
+  g_object_get (io_obj, "params", &params, NULL);
+  if (params)
+  {
+    gchar* description = g_strdup_printf ("pgmlatency,%s", params);
+    GstStructure* s = gst_structure_from_string (description, NULL);
+    if (s)
+    {
+      gst_structure_get_uint (s, "interval", &tracer->interval);
+      gst_structure_free (s);
+    }
+    g_free (description);
+    g_free (params);
+  }
+
+  GstTracer* base = GST_TRACER (io_obj);
+  gst_tracing_register_hook (base, "element-new", G_CALLBACK (gst_pgm_latency_tracer_element_new));
+  gst_tracing_register_hook (base, "pad-push-pre", G_CALLBACK (gst_pgm_latency_tracer_push));
+  gst_tracing_register_hook (base, "element-change-state-post", G_CALLBACK (gst_pgm_latency_tracer_change_state));
+
+  G_OBJECT_CLASS (gst_pgm_latency_tracer_parent_class)->constructed (io_obj);
+}
+
+static void gst_pgm_latency_tracer_finalize (GObject* io_obj)
+{
+  GstPgmLatencyTracer* tracer = GST_PGM_LATENCY_TRACER (io_obj);
+
+  g_hash_table_destroy (tracer->receivers);
+  g_mutex_clear (&tracer->lock);
+
+  G_OBJECT_CLASS (gst_pgm_latency_tracer_parent_class)->finalize (io_obj);
+}
+
+static GstStructure* gst_pgm_latency_field (GType i_type, const gchar* i_description)
+{
+  return gst_structure_new 
+    ( "value"
+    , "type"       , G_TYPE_GTYPE                , i_type
+    , "description", G_TYPE_STRING               , i_description
+    , "related-to" , GST_TYPE_TRACER_VALUE_SCOPE , GST_TRACER_VALUE_SCOPE_ELEMENT
+    , NULL
+    );
+}
+
+static void gst_pgm_latency_tracer_class_init (GstPgmLatencyTracerClass* klass)
+{
+  GObjectClass* gobjectClass = (GObjectClass*)klass;
+  gobjectClass->constructed = gst_pgm_latency_tracer_constructed;
+  gobjectClass->finalize    = gst_pgm_latency_tracer_finalize;
+
+  gst_pgm_latency_record = gst_tracer_record_new 
+    ( "pgm-latency.class"
+    , "element"  , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_STRING, "path of the pgmsrc")
+    , "component", GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_STRING, "sender-queue, wire, repair, receiver-queue or total")
+    , "count"    , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "buffers measured since the last record")
+    , "p50"      , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "median in microseconds")
+    , "p90"      , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "90th percentile in microseconds")
+    , "p99"      , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "99th percentile in microseconds")
+    , "p999"     , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "99.9th percentile in microseconds")
+    , "max"      , GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_UINT64, "maximum in microseconds")
+    , "histogram", GST_TYPE_STRUCTURE, gst_pgm_latency_field (G_TYPE_STRING, "low:count of every bucket with samples, in microseconds")
+    , NULL
+    );
+}
+
+static void gst_pgm_latency_tracer_init (GstPgmLatencyTracer* io_tracer)
+{
+  io_tracer->interval  = PGM_LATENCY_DEFAULT_INTERVAL;
+  g_mutex_init (&io_tracer->lock);
+  io_tracer->receivers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, gst_pgm_latency_receiver_free);
+}
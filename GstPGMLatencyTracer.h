@@ -0,0 +1,107 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer one-way latency tracer
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_LATENCY_TRACER_H
+#define GST_PGM_LATENCY_TRACER_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_LATENCY_TRACER      (gst_pgm_latency_tracer_get_type())
+#define GST_PGM_LATENCY_TRACER(obj)      (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PGM_LATENCY_TRACER,GstPgmLatencyTracer))
+#define GST_IS_PGM_LATENCY_TRACER(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_LATENCY_TRACER))
+
+/* Where a buffer spends its time between pgmsink and pgmsrc:
+ *
+ *   sender-queue    from render, or the request pad's chain, to being sent,
+ *                   waiting for the send lock, the send thread or the
+ *                   compressor
+ *   wire            from being sent to the last fragment that came as ODATA,
+ *                   the rate limiter included
+ *   repair          from then to the last fragment, NAKs and RDATA, 0 for
+ *                   APDUs without repaired fragments
+ *   receiver-queue  from the last fragment to leaving pgmsrc, reordering,
+ *                   tier merging and waiting for key units
+ *   total           the sum
+ *
+ * Wire and total compare the sender's wall clock with the receiver's, so
+ * need the same host or clocks synchronised with PTP; what the difference
+ * makes negative counts as 0.
+ */
+typedef enum
+{
+  GST_PGM_LATENCY_SENDER_QUEUE = 0,
+  GST_PGM_LATENCY_WIRE,
+  GST_PGM_LATENCY_REPAIR,
+  GST_PGM_LATENCY_RECEIVER_QUEUE,
+  GST_PGM_LATENCY_TOTAL,
+  GST_PGM_LATENCY_COMPONENTS
+} GstPgmLatencyComponent;
+
+/* HDR style: 16 linear buckets per power of two of microseconds, values
+ * within 1/16 of what they are reported as, up to 2^40 us.
+ */
+#define GST_PGM_LATENCY_SUB_BITS  4
+#define GST_PGM_LATENCY_MAX_BITS  40
+#define GST_PGM_LATENCY_BUCKETS   ((GST_PGM_LATENCY_MAX_BITS - GST_PGM_LATENCY_SUB_BITS + 2) << GST_PGM_LATENCY_SUB_BITS)
+
+typedef struct _GstPgmLatencyHistogram GstPgmLatencyHistogram;
+typedef struct _GstPgmLatencyTracer GstPgmLatencyTracer;
+typedef struct _GstPgmLatencyTracerClass GstPgmLatencyTracerClass;
+
+struct _GstPgmLatencyHistogram
+{
+  guint64  count;
+  guint64  max;
+  guint64  buckets[GST_PGM_LATENCY_BUCKETS];
+};
+
+/* Loaded with GST_TRACERS="pgmlatency" or "pgmlatency(interval=10)", it
+ * turns on send-stamps of every pgmsink of the process and measures what
+ * every pgmsrc pushes out, logging the histograms of each pgmsrc every
+ * interval seconds and when it stops, 0 for only then. The records go to
+ * the GST_TRACER debug category.
+ */
+struct _GstPgmLatencyTracer
+{
+  GstTracer  parent;
+
+  guint         interval;   // seconds
+  GMutex        lock;
+  GHashTable*   receivers;  // GstElement* to GstPgmLatencyReceiver*
+};
+
+struct _GstPgmLatencyTracerClass
+{
+  GstTracerClass  parent_class;
+};
+
+GType    gst_pgm_latency_tracer_get_type (void);
+
+void     gst_pgm_latency_histogram_add (GstPgmLatencyHistogram*, gint64);
+guint64  gst_pgm_latency_histogram_percentile (const GstPgmLatencyHistogram*, gdouble);
+gchar*   gst_pgm_latency_histogram_to_string (const GstPgmLatencyHistogram*);
+
+G_END_DECLS
+
+#endif // GST_PGM_LATENCY_TRACER_H
@@ -0,0 +1,137 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per-buffer receive metadata
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <pgm/packet.h>
+
+#include "GstPGMMeta.h"
+
+GType gst_pgm_meta_api_get_type (void)
+{
+  static volatile GType type = 0;
+  static const gchar* tags[] = { NULL };
+
+  if (g_once_init_enter (&type))
+  {
+    GType _type = gst_meta_api_type_register ("GstPgmMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean gst_pgm_meta_init (GstMeta* io_meta, gpointer dummy, GstBuffer* i_buffer)
+{
+  GstPgmMeta* meta = (GstPgmMeta*) io_meta;
+
+  memset (meta->gsi, 0, sizeof(meta->gsi));
+  meta->source_port    = 0;
+  meta->first_sequence = 0;
+  meta->last_sequence  = 0;
+  meta->repaired       = FALSE;
+  meta->n_fragments    = 0;
+  meta->arrival        = GST_CLOCK_TIME_NONE;
+  meta->original_arrival = GST_CLOCK_TIME_NONE;
+  meta->sent           = GST_CLOCK_TIME_NONE;
+  meta->sender_queue   = 0;
+
+  return TRUE;
+}
+
+/* the receive history stays true for any copy or region of the APDU */
+static gboolean gst_pgm_meta_transform (GstBuffer* o_dest, GstMeta* i_meta, GstBuffer* i_buffer, GQuark i_type, gpointer i_data)
+{
+  const GstPgmMeta* src = (const GstPgmMeta*) i_meta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (i_type)) return FALSE;
+
+  GstPgmMeta* dest = (GstPgmMeta*) gst_buffer_add_meta (o_dest, GST_PGM_META_INFO, NULL);
+  if (NULL == dest) return FALSE;
+
+  memcpy (dest->gsi, src->gsi, sizeof(dest->gsi));
+  dest->source_port    = src->source_port;
+  dest->first_sequence = src->first_sequence;
+  dest->last_sequence  = src->last_sequence;
+  dest->repaired       = src->repaired;
+  dest->n_fragments    = src->n_fragments;
+  dest->arrival        = src->arrival;
+  dest->original_arrival = src->original_arrival;
+  dest->sent           = src->sent;
+  dest->sender_queue   = src->sender_queue;
+
+  return TRUE;
+}
+
+const GstMetaInfo* gst_pgm_meta_get_info (void)
+{
+  static const GstMetaInfo* meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info))
+  {
+    const GstMetaInfo* _info = gst_meta_register 
+      ( GST_PGM_META_API_TYPE
+      , "GstPgmMeta"
+      , sizeof(GstPgmMeta)
+      , gst_pgm_meta_init
+      , (GstMetaFreeFunction) NULL
+      , gst_pgm_meta_transform
+      );
+    g_once_init_leave (&meta_info, _info);
+  }
+  return meta_info;
+}
+
+/* attach what the skbs of one APDU tell about its delivery
+ */
+GstPgmMeta* gst_buffer_add_pgm_meta (GstBuffer* io_buffer, const struct pgm_msgv_t* i_msgv)
+{
+  GstPgmMeta* meta = (GstPgmMeta*) gst_buffer_add_meta (io_buffer, GST_PGM_META_INFO, NULL);
+  if (NULL == meta || 0 == i_msgv->msgv_len) return meta;
+
+  const struct pgm_sk_buff_t* first = i_msgv->msgv_skb[0];
+  const struct pgm_sk_buff_t* last  = i_msgv->msgv_skb[i_msgv->msgv_len - 1];
+  pgm_time_t arrival = 0, original = 0;
+
+  memcpy (meta->gsi, first->tsi.gsi.identifier, sizeof(meta->gsi));
+  meta->source_port    = g_ntohs (first->tsi.sport);
+  meta->first_sequence = first->sequence;
+  meta->last_sequence  = last->sequence;
+  meta->n_fragments    = i_msgv->msgv_len;
+
+  for (unsigned i = 0; i < i_msgv->msgv_len; ++i)
+  {
+    const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[i];
+    if (PGM_RDATA == skb->pgm_header->pgm_type) meta->repaired = TRUE;
+    else original = MAX (original, skb->tstamp);
+    arrival = MAX (arrival, skb->tstamp);
+  }
+  meta->arrival = arrival * GST_USECOND;
+  if (original) meta->original_arrival = original * GST_USECOND;
+
+  return meta;
+}
+
+/* TSI in the notation OpenPGM logs it with, g_free the result */
+gchar* gst_pgm_meta_tsi_to_string (const GstPgmMeta* i_meta)
+{
+  const guint8* g = i_meta->gsi;
+  return g_strdup_printf ("%u.%u.%u.%u.%u.%u.%u", g[0], g[1], g[2], g[3], g[4], g[5], i_meta->source_port);
+}
@@ -0,0 +1,70 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per-buffer receive metadata
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_META_H
+#define GST_PGM_META_H
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_PGM_META_API_TYPE  (gst_pgm_meta_api_get_type())
+#define GST_PGM_META_INFO      (gst_pgm_meta_get_info())
+
+/* How an output buffer of pgmsrc got here. Sequence numbers are those of
+ * the PGM data packets carrying the APDU, arrival is the time OpenPGM took
+ * the last fragment off the socket, original arrival that of the last one
+ * that came as ODATA, both on the PGM clock in nanoseconds. Sent is the
+ * sender's wall clock when it sent the APDU, when it stamped it.
+ */
+typedef struct _GstPgmMeta GstPgmMeta;
+
+struct _GstPgmMeta
+{
+  GstMeta       meta;
+
+  guint8        gsi[6];           // transport session identifier of the source
+  guint16       source_port;
+  guint32       first_sequence;
+  guint32       last_sequence;
+  gboolean      repaired;         // at least one fragment came as RDATA
+  guint         n_fragments;
+  GstClockTime  arrival;
+  GstClockTime  original_arrival; // NONE if every fragment was repaired
+  GstClockTime  sent;             // NONE unless pgmsink has send-stamps
+  GstClockTime  sender_queue;     // waited in pgmsink before being sent
+};
+
+struct pgm_msgv_t;
+
+GType              gst_pgm_meta_api_get_type (void);
+const GstMetaInfo* gst_pgm_meta_get_info (void);
+
+GstPgmMeta*        gst_buffer_add_pgm_meta (GstBuffer*, const struct pgm_msgv_t*);
+gchar*             gst_pgm_meta_tsi_to_string (const GstPgmMeta*);
+
+#define gst_buffer_get_pgm_meta(b) \
+  ((GstPgmMeta*)gst_buffer_get_meta ((b), GST_PGM_META_API_TYPE))
+
+G_END_DECLS
+
+#endif // GST_PGM_META_H
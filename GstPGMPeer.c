@@ -0,0 +1,131 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per sender receive statistics
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include <pgm/packet.h>
+
+#include "GstPGMPeer.h"
+
+void gst_pgm_peer_init (GstPgmPeer* o_peer, const pgm_tsi_t* i_tsi, guint i_path, pgm_time_t i_now)
+{
+  memset (o_peer, 0, sizeof(*o_peer));
+  o_peer->tsi          = *i_tsi;
+  o_peer->path         = i_path;
+  o_peer->last_arrival = i_now;
+  o_peer->period_start = i_now;
+}
+
+/* one APDU delivered from the sender
+ */
+void gst_pgm_peer_observe (GstPgmPeer* io_peer, const struct pgm_msgv_t* i_msgv)
+{
+  for (unsigned i = 0; i < i_msgv->msgv_len; ++i)
+  {
+    const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[i];
+
+    io_peer->packets++;
+    io_peer->bytes += skb->len;
+    if (PGM_RDATA == skb->pgm_header->pgm_type) io_peer->repaired++;
+    io_peer->last_arrival = MAX (io_peer->last_arrival, skb->tstamp);
+
+    /* repairs may advertise an older trail than ODATA sent since */
+    if (skb->pgm_data && (!io_peer->have_window || (gint32) (skb->sequence - io_peer->lead) >= 0))
+    {
+      io_peer->lead        = skb->sequence;
+      io_peer->trail       = g_ntohl (skb->pgm_data->data_trail);
+      io_peer->have_window = TRUE;
+    }
+  }
+  io_peer->apdus++;
+}
+
+/* the receive window gave up on sequences of the sender, the skb of a
+ * PGM_IO_STATUS_RESET counts them
+ */
+void gst_pgm_peer_observe_reset (GstPgmPeer* io_peer, const struct pgm_sk_buff_t* i_skb)
+{
+  io_peer->unrecoverable += i_skb->sequence;
+  io_peer->resets++;
+}
+
+/* Close the period, TRUE when the sender is new, lost anything in it or
+ * its rate moved by more than i_threshold percent since it was last
+ * worth telling.
+ */
+gboolean gst_pgm_peer_update (GstPgmPeer* io_peer, pgm_time_t i_now, guint i_threshold)
+{
+  const pgm_time_t elapsed = i_now - io_peer->period_start;
+  const guint64 lost     = io_peer->repaired + io_peer->unrecoverable;
+  const guint64 lost_now = lost - io_peer->period_lost;
+  const guint64 expected = io_peer->packets + io_peer->unrecoverable - io_peer->period_expected;
+
+  if (elapsed > 0) io_peer->rate = (io_peer->bytes - io_peer->period_bytes) * G_USEC_PER_SEC / elapsed;
+  io_peer->loss = expected > 0 ? (gdouble) lost_now / expected : 0;
+
+  io_peer->period_start    = i_now;
+  io_peer->period_expected = io_peer->packets + io_peer->unrecoverable;
+  io_peer->period_bytes    = io_peer->bytes;
+  io_peer->period_lost     = lost;
+
+  const guint64 moved = io_peer->rate > io_peer->posted_rate
+                      ? io_peer->rate - io_peer->posted_rate
+                      : io_peer->posted_rate - io_peer->rate;
+  const gboolean worth = !io_peer->posted || lost_now > 0 || moved * 100 > (guint64) i_threshold * io_peer->posted_rate;
+
+  if (worth)
+  {
+    io_peer->posted      = TRUE;
+    io_peer->posted_rate = io_peer->rate;
+  }
+  return worth;
+}
+
+/* pgm-peer-stats, as of the last gst_pgm_peer_update
+ */
+GstStructure* gst_pgm_peer_to_structure (const GstPgmPeer* i_peer, pgm_time_t i_now)
+{
+  const guint8* g = i_peer->tsi.gsi.identifier;
+  gchar* tsi = g_strdup_printf ("%u.%u.%u.%u.%u.%u.%u", g[0], g[1], g[2], g[3], g[4], g[5], g_ntohs (i_peer->tsi.sport));
+
+  GstStructure* s = gst_structure_new 
+    ( "pgm-peer-stats"
+    , "tsi"          , G_TYPE_STRING, tsi
+    , "path"         , G_TYPE_UINT  , i_peer->path
+    , "packets"      , G_TYPE_UINT64, i_peer->packets
+    , "bytes"        , G_TYPE_UINT64, i_peer->bytes
+    , "apdus"        , G_TYPE_UINT64, i_peer->apdus
+    , "repaired"     , G_TYPE_UINT64, i_peer->repaired
+    , "unrecoverable", G_TYPE_UINT64, i_peer->unrecoverable
+    , "resets"       , G_TYPE_UINT64, i_peer->resets
+    , "loss"         , G_TYPE_DOUBLE, i_peer->loss
+    , "rate"         , G_TYPE_UINT64, i_peer->rate
+    , "lead"         , G_TYPE_UINT  , i_peer->lead
+    , "trail"        , G_TYPE_UINT  , i_peer->trail
+    , "idle"         , G_TYPE_UINT64, (guint64) (i_now > i_peer->last_arrival ? i_now - i_peer->last_arrival : 0)
+    , "repair-rtt"   , G_TYPE_INT64 , i_peer->rtt.valid ? i_peer->rtt.srtt : (gint64) -1
+    , NULL
+    );
+
+  g_free (tsi);
+  return s;
+}
@@ -0,0 +1,82 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer per sender receive statistics
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_PEER_H
+#define GST_PGM_PEER_H
+
+#include <gst/gst.h>
+
+#include <pgm/pgm.h>
+
+#include "GstPGMRepair.h"
+
+G_BEGIN_DECLS
+
+/* What pgmsrc saw of one sender, by TSI. Only the receive thread touches
+ * it, the statistics it publishes are copies.
+ *
+ * OpenPGM keeps NAKs, NCFs and SPMs to itself, so everything is told by
+ * the skbs it delivers: repaired counts fragments that came as RDATA,
+ * each of which a NAK of this or another receiver asked for; lead and
+ * trail are the sender's transmit window as the last data packet
+ * advertised it; idle stands in for the last SPM, as the time since the
+ * sender was last heard from.
+ */
+typedef struct _GstPgmPeer GstPgmPeer;
+
+struct _GstPgmPeer
+{
+  pgm_tsi_t        tsi;
+  guint            path;
+  GstPgmRepairRtt  rtt;
+
+  guint64     packets;        // fragments delivered, original and repair
+  guint64     bytes;
+  guint64     apdus;
+  guint64     repaired;
+  guint64     unrecoverable;  // sequences given up on
+  guint64     resets;
+  gboolean    have_window;
+  guint32     lead;
+  guint32     trail;
+  pgm_time_t  last_arrival;
+
+  /* the period up to the last gst_pgm_peer_update */
+  pgm_time_t  period_start;
+  guint64     period_expected;  // packets plus unrecoverable at its start
+  guint64     period_bytes;
+  guint64     period_lost;
+  guint64     rate;           // bytes per second
+  gdouble     loss;           // of the sequences expected
+  gboolean    posted;
+  guint64     posted_rate;
+};
+
+void           gst_pgm_peer_init (GstPgmPeer*, const pgm_tsi_t*, guint, pgm_time_t);
+void           gst_pgm_peer_observe (GstPgmPeer*, const struct pgm_msgv_t*);
+void           gst_pgm_peer_observe_reset (GstPgmPeer*, const struct pgm_sk_buff_t*);
+gboolean       gst_pgm_peer_update (GstPgmPeer*, pgm_time_t, guint);
+GstStructure*  gst_pgm_peer_to_structure (const GstPgmPeer*, pgm_time_t);
+
+G_END_DECLS
+
+#endif // GST_PGM_PEER_H
@@ -0,0 +1,899 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer session relay
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <netinet/ip.h>
+#include <pgm/packet.h>
+
+#include "GstPGMRelay.h"
+#include "GstPGMConfig.h"
+
+#define PGM_RELAY_MAX_POLL_FDS    8
+#define PGM_RELAY_SEND_POLL_MSECS 10    // socket buffer full, try again
+
+enum
+{
+  PROP_0,
+  PROP_IN_NETWORK,
+  PROP_IN_PORT,
+  PROP_OUT_NETWORK,
+  PROP_OUT_PORT,
+  PROP_UDP_ENCAP_PORT,
+  PROP_MAX_TPDU,
+  PROP_HOPS,
+  PROP_RXW_SQNS,
+  PROP_TXW_SQNS,
+  PROP_TXW_SECS,
+  PROP_MAX_RATE,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_LAST
+};
+
+static void                  gst_pgm_relay_finalize (GObject*);
+static void                  gst_pgm_relay_set_property (GObject*, guint, const GValue*, GParamSpec*);
+static void                  gst_pgm_relay_get_property (GObject*, guint, GValue*, GParamSpec*);
+static GstStateChangeReturn  gst_pgm_relay_change_state (GstElement*, GstStateChange);
+
+G_DEFINE_TYPE (GstPgmRelay, gst_pgm_relay, GST_TYPE_ELEMENT)
+
+static void gst_pgm_relay_class_init (GstPgmRelayClass* klass)
+{
+  GstElementClass* elementClass = (GstElementClass*)klass;
+  elementClass->change_state = GST_DEBUG_FUNCPTR(gst_pgm_relay_change_state);
+
+  GObjectClass* gobjectClass = (GObjectClass*)klass;
+  gobjectClass->finalize     = GST_DEBUG_FUNCPTR(gst_pgm_relay_finalize);
+  gobjectClass->set_property = GST_DEBUG_FUNCPTR(gst_pgm_relay_set_property);
+  gobjectClass->get_property = GST_DEBUG_FUNCPTR(gst_pgm_relay_get_property);
+
+  gst_element_class_set_static_metadata
+    ( elementClass
+    , "PGM Relay"
+    , "Generic"
+    , "Forwards the APDUs of one PGM session on another, across network segments."
+    , "Tim Aerts <jobs@timaerts.be>"
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_IN_NETWORK
+    , g_param_spec_string
+        ( "in-network"
+        , "Inbound network"
+        , "Rendezvous-style multicast network definition of the session received."
+        , PGM_DEFAULT_NETWORK
+        , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+        )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_IN_PORT
+    , g_param_spec_uint 
+        ( "in-dport"
+        , "Inbound DPORT"
+        , "Data-destination port of the session received."
+        , 0 // minimum
+        , UINT16_MAX
+        , PGM_DEFAULT_PORT
+        , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+        )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_OUT_NETWORK
+    , g_param_spec_string
+        ( "out-network"
+        , "Outbound network"
+        , "Rendezvous-style multicast network definition of the session sent."
+        , NULL
+        , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+        )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_OUT_PORT
+    , g_param_spec_uint 
+        ( "out-dport"
+        , "Outbound DPORT"
+        , "Data-destination port of the session sent."
+        , 0 // minimum
+        , UINT16_MAX
+        , PGM_DEFAULT_PORT
+        , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+        )
+    );
+
+  g_object_class_install_property
+    ( gobjectClass
+    , PROP_UDP_ENCAP_PORT
+    , g_param_spec_uint 
+      ( "udp-encap-port"
+      , "UDP encapsulation port"
+      , "UDP port for encapsulation of PGM protocol, both sessions."
+      , 0 // minimum
+      , UINT16_MAX
+      , PGM_DEFAULT_UDP_ENCAP_PORT
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_MAX_TPDU
+    , g_param_spec_uint 
+      ( "max-tpdu"
+      , "Maximum TPDU"
+      , "Largest supported Transport Protocol Data Unit, APDUs are fragmented again for it when sent."
+      , (sizeof (struct iphdr) + sizeof (struct pgm_header)) // minimum
+      , UINT16_MAX
+      , PGM_DEFAULT_MAX_TPDU
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_HOPS
+    , g_param_spec_int 
+      ( "hops"
+      , "Hops"
+      , "Multicast packet hop limit."
+      , 1 // minimum
+      , UINT8_MAX
+      , PGM_DEFAULT_HOPS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_RXW_SQNS
+    , g_param_spec_uint 
+      ( "rxw-sqns"
+      , "RXW_SQNS"
+      , "Size of the receive window in sequence numbers, what is held while the rate limit holds sending back."
+      , 1 // minimum
+      , UINT16_MAX
+      , PGM_DEFAULT_RXW_SQNS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_TXW_SQNS
+    , g_param_spec_uint 
+      ( "txw-sqns"
+      , "TXW_SQNS"
+      , "Size of the transmit window in sequence numbers."
+      , 1 // minimum
+      , UINT16_MAX
+      , PGM_DEFAULT_TXW_SQNS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_TXW_SECS
+    , g_param_spec_uint 
+      ( "txw-secs"
+      , "TXW_SECS"
+      , "Transmit window in seconds of the stream at max-rate, 0 to size it by txw-sqns."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_TXW_SECS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_MAX_RATE
+    , g_param_spec_uint 
+      ( "max-rate"
+      , "Maximum rate"
+      , "Limit of the session sent in bits per second, repairs included, 0 for none."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_MAX_RATE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_STATS_INTERVAL
+    , g_param_spec_uint 
+      ( "stats-interval"
+      , "Statistics interval"
+      , "Milliseconds between pgm-relay-stats messages, 0 to disable."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_STATS_INTERVAL
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_STATS
+    , g_param_spec_boxed 
+      ( "stats"
+      , "Statistics"
+      , "Last pgm-relay-stats: APDUs, bytes and loss received, APDUs, bytes and rate limiting sent."
+      , GST_TYPE_STRUCTURE
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+}
+
+static void gst_pgm_relay_init (GstPgmRelay* io_relay)
+{
+  io_relay->in_network      = g_strdup (PGM_DEFAULT_NETWORK);
+  io_relay->in_port         = PGM_DEFAULT_PORT;
+  io_relay->out_network     = NULL;
+  io_relay->out_port        = PGM_DEFAULT_PORT;
+  io_relay->udp_encap_port  = PGM_DEFAULT_UDP_ENCAP_PORT;
+  io_relay->max_tpdu        = PGM_DEFAULT_MAX_TPDU;
+  io_relay->hops            = PGM_DEFAULT_HOPS;
+  io_relay->rxw_sqns        = PGM_DEFAULT_RXW_SQNS;
+  io_relay->txw_sqns        = PGM_DEFAULT_TXW_SQNS;
+  io_relay->txw_secs        = PGM_DEFAULT_TXW_SECS;
+  io_relay->max_rate        = PGM_DEFAULT_MAX_RATE;
+  io_relay->stats_interval  = PGM_DEFAULT_STATS_INTERVAL;
+  io_relay->stats           = NULL;
+  io_relay->in_transport    = NULL;
+  io_relay->out_transport   = NULL;
+  io_relay->transport_dirty = FALSE;
+  io_relay->poll            = NULL;
+  io_relay->thread          = NULL;
+  io_relay->quit            = FALSE;
+  io_relay->have_pending    = FALSE;
+}
+
+static void gst_pgm_relay_finalize (GObject* io_obj)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (io_obj);
+
+  g_free (relay->in_network);
+  g_free (relay->out_network);
+  if (relay->stats) gst_structure_free (relay->stats);
+
+  G_OBJECT_CLASS(gst_pgm_relay_parent_class)->finalize(io_obj);
+}
+
+static void gst_pgm_relay_set_property (GObject* io_obj, guint i_propId, const GValue* i_value, GParamSpec* pspec)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (io_obj);
+
+  switch (i_propId) 
+  {
+  case PROP_IN_NETWORK:
+    g_free (relay->in_network);
+    relay->in_network = g_value_dup_string (i_value);
+    break;
+
+  case PROP_IN_PORT:
+    relay->in_port = g_value_get_uint (i_value);
+    break;
+
+  case PROP_OUT_NETWORK:
+    g_free (relay->out_network);
+    relay->out_network = g_value_dup_string (i_value);
+    break;
+
+  case PROP_OUT_PORT:
+    relay->out_port = g_value_get_uint (i_value);
+    break;
+
+  case PROP_UDP_ENCAP_PORT:
+    relay->udp_encap_port = g_value_get_uint (i_value);
+    break;
+
+  case PROP_MAX_TPDU:
+    relay->max_tpdu = g_value_get_uint (i_value);
+    break;
+
+  case PROP_HOPS:
+    relay->hops = g_value_get_int (i_value);
+    break;
+
+  case PROP_RXW_SQNS:
+    relay->rxw_sqns = g_value_get_uint (i_value);
+    break;
+
+  case PROP_TXW_SQNS:
+    relay->txw_sqns = g_value_get_uint (i_value);
+    break;
+
+  case PROP_TXW_SECS:
+    relay->txw_secs = g_value_get_uint (i_value);
+    break;
+
+  case PROP_MAX_RATE:
+    relay->max_rate = g_value_get_uint (i_value);
+    break;
+
+  case PROP_STATS_INTERVAL:
+    relay->stats_interval = g_value_get_uint (i_value);
+    return;
+
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (io_obj, i_propId, pspec);
+    return;
+  }
+
+  relay->transport_dirty = TRUE;
+}
+
+static void gst_pgm_relay_get_property (GObject* io_obj, guint i_propId, GValue* o_value, GParamSpec* pspec)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (io_obj);
+
+  switch (i_propId) 
+  {
+  case PROP_IN_NETWORK:
+    g_value_set_string (o_value, relay->in_network);
+    break;
+  case PROP_IN_PORT:
+    g_value_set_uint (o_value, relay->in_port);
+    break;
+  case PROP_OUT_NETWORK:
+    g_value_set_string (o_value, relay->out_network);
+    break;
+  case PROP_OUT_PORT:
+    g_value_set_uint (o_value, relay->out_port);
+    break;
+  case PROP_UDP_ENCAP_PORT:
+    g_value_set_uint (o_value, relay->udp_encap_port);
+    break;
+  case PROP_MAX_TPDU:
+    g_value_set_uint (o_value, relay->max_tpdu);
+    break;
+  case PROP_HOPS:
+    g_value_set_int (o_value, relay->hops);
+    break;
+  case PROP_RXW_SQNS:
+    g_value_set_uint (o_value, relay->rxw_sqns);
+    break;
+  case PROP_TXW_SQNS:
+    g_value_set_uint (o_value, relay->txw_sqns);
+    break;
+  case PROP_TXW_SECS:
+    g_value_set_uint (o_value, relay->txw_secs);
+    break;
+  case PROP_MAX_RATE:
+    g_value_set_uint (o_value, relay->max_rate);
+    break;
+  case PROP_STATS_INTERVAL:
+    g_value_set_uint (o_value, relay->stats_interval);
+    break;
+  case PROP_STATS:
+    GST_OBJECT_LOCK (relay);
+    g_value_set_boxed (o_value, relay->stats);
+    GST_OBJECT_UNLOCK (relay);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (io_obj, i_propId, pspec);
+    break;
+  }
+}
+
+/* GstPgmTransportConfigure for the session received
+ */
+static gboolean gst_pgm_relay_configure_in (GstElement* element, struct pgm_sock_t* sock, gpointer dummy)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (element);
+
+  const int valTrue = 1;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_RECV_ONLY, &valTrue, sizeof(valTrue))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_READ, (NULL), ("cannot set receive-only mode"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MTU, &relay->max_tpdu, sizeof(relay->max_tpdu))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_READ, (NULL), ("cannot set maximum TPDU size"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &relay->hops, sizeof(relay->hops))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_READ, (NULL), ("cannot set IP hop limit"));
+    return FALSE;
+  }
+
+  if (!gst_pgm_transport_set_window (element, sock, FALSE, relay->rxw_sqns, 0, 0, 0, relay->max_tpdu)) return FALSE;
+
+  const guint peer_expiry = PGM_DEFAULT_PEER_EXPIRY;
+  const guint spmr_expiry = PGM_DEFAULT_SPMR_EXPIRY;
+  const guint nak_bo_ivl  = PGM_DEFAULT_NAK_BO_IVL;
+  const guint nak_rpt_ivl = PGM_DEFAULT_NAK_RPT_IVL;
+  const guint nak_rdata_ivl    = PGM_DEFAULT_NAK_RDATA_IVL;
+  const guint nak_data_retries = PGM_DEFAULT_NAK_DATA_RETRIES;
+  const guint nak_ncf_retries  = PGM_DEFAULT_NAK_NCF_RETRIES;
+
+  if ( !pgm_setsockopt (sock, IPPROTO_PGM, PGM_PEER_EXPIRY, &peer_expiry, sizeof(peer_expiry))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_SPMR_EXPIRY, &spmr_expiry, sizeof(spmr_expiry))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_BO_IVL, &nak_bo_ivl, sizeof(nak_bo_ivl))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RPT_IVL, &nak_rpt_ivl, sizeof(nak_rpt_ivl))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RDATA_IVL, &nak_rdata_ivl, sizeof(nak_rdata_ivl))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_DATA_RETRIES, &nak_data_retries, sizeof(nak_data_retries))
+     || !pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_NCF_RETRIES, &nak_ncf_retries, sizeof(nak_ncf_retries))
+     )
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_READ, (NULL), ("cannot set peer and NAK timers"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* GstPgmTransportConfigure for the session sent, never blocking so that
+ * the rate limit does not hold up reading the other
+ */
+static gboolean gst_pgm_relay_configure_out (GstElement* element, struct pgm_sock_t* sock, gpointer dummy)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (element);
+
+  const int valTrue  = 1;
+  const int valFalse = 0;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_SEND_ONLY, &valTrue, sizeof(valTrue))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set send-only mode"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MTU, &relay->max_tpdu, sizeof(relay->max_tpdu))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set maximum TPDU size"));
+    return FALSE;
+  }
+
+  /* the inbound session may be on this host too, not our own data back */
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_LOOP, &valFalse, sizeof(valFalse)))
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set multicast loop"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &relay->hops, sizeof(relay->hops))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set IP hop limit"));
+    return FALSE;
+  }
+
+  if (!gst_pgm_transport_set_window (element, sock, TRUE, relay->txw_sqns, relay->txw_secs, relay->max_rate, 0, relay->max_tpdu)) return FALSE;
+
+  if (relay->max_rate > 0)
+  {
+    const unsigned max_rte = relay->max_rate / 8;
+
+    if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_TXW_MAX_RTE, &max_rte, sizeof(max_rte)))
+    {
+      GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set maximum rate"));
+      return FALSE;
+    }
+  }
+
+  const guint spm_ambient = PGM_DEFAULT_SPM_AMBIENT;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_AMBIENT_SPM, &spm_ambient, sizeof(spm_ambient))) 
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set SPM ambient interval"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NOBLOCK, &valTrue, sizeof(valTrue)))
+  {
+    GST_ELEMENT_ERROR (relay, RESOURCE, OPEN_WRITE, (NULL), ("cannot set no-block"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void gst_pgm_relay_poll_transport (GstPgmRelay* io_relay, const GstPgmTransport* i_transport, gboolean i_add, gboolean i_read)
+{
+  struct pollfd fds[PGM_RELAY_MAX_POLL_FDS];
+  int n_fds = PGM_RELAY_MAX_POLL_FDS;
+
+  if (pgm_poll_info (i_transport->sock, fds, &n_fds, POLLIN) < 0) return;
+
+  for (int i = 0; i < n_fds; ++i)
+  {
+    GstPollFD pfd;
+    gst_poll_fd_init (&pfd);
+    pfd.fd = fds[i].fd;
+
+    if (i_add) gst_poll_add_fd (io_relay->poll, &pfd);
+    gst_poll_fd_ctl_read (io_relay->poll, &pfd, i_read);
+  }
+}
+
+static void gst_pgm_relay_close (GstPgmRelay* io_relay)
+{
+  GST_DEBUG_OBJECT (io_relay, "destroying transports");
+
+  io_relay->have_pending = FALSE;
+
+  if (io_relay->poll)
+  {
+    gst_poll_free (io_relay->poll);
+    io_relay->poll = NULL;
+  }
+
+  gst_pgm_transport_close (io_relay->out_transport);
+  io_relay->out_transport = NULL;
+
+  gst_pgm_transport_close (io_relay->in_transport);
+  io_relay->in_transport = NULL;
+}
+
+static gboolean gst_pgm_relay_open (GstPgmRelay* io_relay)
+{
+  if (NULL == io_relay->out_network)
+  {
+    GST_ELEMENT_ERROR (io_relay, RESOURCE, SETTINGS, (NULL), ("no session to relay to, set out-network"));
+    return FALSE;
+  }
+
+  io_relay->transport_dirty = FALSE;
+
+  GST_OBJECT_LOCK (io_relay);
+  gchar* in_network  = g_strdup (io_relay->in_network);
+  gchar* out_network = g_strdup (io_relay->out_network);
+  GST_OBJECT_UNLOCK (io_relay);
+
+  io_relay->in_transport = gst_pgm_transport_open 
+    ( GST_ELEMENT_CAST (io_relay)
+    , in_network
+    , io_relay->in_port
+    , io_relay->udp_encap_port
+    , gst_pgm_relay_configure_in
+    , NULL
+    );
+  io_relay->out_transport = io_relay->in_transport == NULL ? NULL : gst_pgm_transport_open 
+    ( GST_ELEMENT_CAST (io_relay)
+    , out_network
+    , io_relay->out_port
+    , io_relay->udp_encap_port
+    , gst_pgm_relay_configure_out
+    , NULL
+    );
+  g_free (in_network);
+  g_free (out_network);
+
+  if (io_relay->out_transport == NULL)
+  {
+    gst_pgm_relay_close (io_relay);
+    return FALSE;
+  }
+
+  io_relay->poll = gst_poll_new (TRUE);
+  gst_pgm_relay_poll_transport (io_relay, io_relay->in_transport, TRUE, TRUE);
+  gst_pgm_relay_poll_transport (io_relay, io_relay->out_transport, TRUE, TRUE);
+
+  gst_pgm_transport_post_setup 
+    ( GST_ELEMENT_CAST (io_relay)
+    , 2
+    , io_relay->in_transport->setup_time + io_relay->out_transport->setup_time
+    );
+  return TRUE;
+}
+
+static void gst_pgm_relay_update_stats (GstPgmRelay* io_relay)
+{
+  GstStructure* stats = gst_structure_new 
+    ( "pgm-relay-stats"
+    , "in-apdus"          , G_TYPE_UINT64, io_relay->in_apdus
+    , "in-bytes"          , G_TYPE_UINT64, io_relay->in_bytes
+    , "in-lost-sequences" , G_TYPE_UINT64, io_relay->in_lost_sequences
+    , "in-resets"         , G_TYPE_UINT64, io_relay->in_resets
+    , "out-apdus"         , G_TYPE_UINT64, io_relay->out_apdus
+    , "out-bytes"         , G_TYPE_UINT64, io_relay->out_bytes
+    , "out-rate-limited"  , G_TYPE_UINT64, io_relay->out_rate_limited
+    , "out-errors"        , G_TYPE_UINT64, io_relay->out_errors
+    , NULL
+    );
+
+  gst_element_post_message 
+    ( GST_ELEMENT_CAST (io_relay)
+    , gst_message_new_element (GST_OBJECT_CAST (io_relay), gst_structure_copy (stats))
+    );
+
+  GST_OBJECT_LOCK (io_relay);
+  if (io_relay->stats) gst_structure_free (io_relay->stats);
+  io_relay->stats = stats;
+  GST_OBJECT_UNLOCK (io_relay);
+}
+
+/* Read one APDU into io_relay->pending. The vector sent points straight
+ * at the fragments in the skbs of the receive window, which stay valid
+ * until the next read, so the only copy is the one into the transmit
+ * window. FALSE on a receive error.
+ */
+static gboolean gst_pgm_relay_receive (GstPgmRelay* io_relay, gboolean* o_again, GstClockTime* io_timeout)
+{
+  struct pgm_sock_t* sock = io_relay->in_transport->sock;
+  struct pgm_error_t* pErr = NULL;
+  struct timeval tv;
+  socklen_t optlen = sizeof(tv);
+  size_t len;
+
+  const int status = pgm_recvmsg (sock, &io_relay->pending, MSG_DONTWAIT | MSG_ERRQUEUE, &len, &pErr);
+
+  switch (status)
+  {
+  case PGM_IO_STATUS_NORMAL:
+    for (guint i = 0; i < io_relay->pending.msgv_len; ++i)
+    {
+      io_relay->pending_vector[i].iov_base = io_relay->pending.msgv_skb[i]->data;
+      io_relay->pending_vector[i].iov_len  = io_relay->pending.msgv_skb[i]->len;
+    }
+    io_relay->have_pending = TRUE;
+    io_relay->in_apdus++;
+    io_relay->in_bytes += len;
+    break;
+
+  case PGM_IO_STATUS_TIMER_PENDING:
+    if (pgm_getsockopt (sock, IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen))
+    {
+      *io_timeout = MIN (*io_timeout, GST_TIMEVAL_TO_TIME (tv));
+    }
+    break;
+
+  case PGM_IO_STATUS_RATE_LIMITED:
+    if (pgm_getsockopt (sock, IPPROTO_PGM, PGM_RATE_REMAIN, &tv, &optlen))
+    {
+      *io_timeout = MIN (*io_timeout, GST_TIMEVAL_TO_TIME (tv));
+    }
+    break;
+
+  case PGM_IO_STATUS_WOULD_BLOCK:
+    break;
+
+  case PGM_IO_STATUS_RESET:
+  {
+    const struct pgm_sk_buff_t* skb = io_relay->pending.msgv_skb[0];
+
+    /* nothing to tell downstream, the gap shows as loss there */
+    GST_DEBUG_OBJECT (io_relay, "lost %u sequences from %s", skb->sequence, pgm_tsi_print (&skb->tsi));
+    io_relay->in_lost_sequences += skb->sequence;
+    io_relay->in_resets++;
+    pgm_free_skb (io_relay->pending.msgv_skb[0]);
+    if (pErr) pgm_error_free (pErr);
+    *o_again = TRUE;
+    break;
+  }
+
+  default:
+    GST_ELEMENT_ERROR (io_relay, RESOURCE, READ, (NULL), ("Receive error: %s", pErr ? pErr->message : "unknown"));
+    if (pErr) pgm_error_free (pErr);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Send the pending APDU as one, fragmented again for our max-tpdu. Held
+ * back by the rate limit, it is offered again with the same vector, which
+ * OpenPGM needs to carry on where it stopped.
+ */
+static void gst_pgm_relay_send (GstPgmRelay* io_relay, GstClockTime* io_timeout)
+{
+  struct pgm_sock_t* sock = io_relay->out_transport->sock;
+  struct timeval tv;
+  socklen_t optlen = sizeof(tv);
+  size_t written = 0u;
+
+  const int status = pgm_sendv 
+    ( sock
+    , io_relay->pending_vector
+    , io_relay->pending.msgv_len
+    , TRUE  // one APDU
+    , &written
+    );
+
+  switch (status)
+  {
+  case PGM_IO_STATUS_NORMAL:
+    io_relay->have_pending = FALSE;
+    io_relay->out_apdus++;
+    io_relay->out_bytes += written;
+    break;
+
+  case PGM_IO_STATUS_RATE_LIMITED:
+    io_relay->out_rate_limited++;
+    if (pgm_getsockopt (sock, IPPROTO_PGM, PGM_RATE_REMAIN, &tv, &optlen))
+    {
+      *io_timeout = MIN (*io_timeout, GST_TIMEVAL_TO_TIME (tv));
+    }
+    break;
+
+  case PGM_IO_STATUS_WOULD_BLOCK:
+    *io_timeout = MIN (*io_timeout, PGM_RELAY_SEND_POLL_MSECS * GST_MSECOND);
+    break;
+
+  default:
+    GST_WARNING_OBJECT (io_relay, "send failed, APDU of %u fragments dropped", io_relay->pending.msgv_len);
+    io_relay->have_pending = FALSE;
+    io_relay->out_errors++;
+    break;
+  }
+}
+
+/* NAKs and SPMRs for the session sent are answered as it is read
+ */
+static void gst_pgm_relay_service (GstPgmRelay* io_relay, GstClockTime* io_timeout)
+{
+  struct pgm_sock_t* sock = io_relay->out_transport->sock;
+  struct pgm_msgv_t msgv;
+
+  if (PGM_IO_STATUS_TIMER_PENDING == pgm_recvmsg (sock, &msgv, MSG_DONTWAIT, NULL, NULL))
+  {
+    struct timeval tv;
+    socklen_t optlen = sizeof(tv);
+    if (pgm_getsockopt (sock, IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen))
+    {
+      *io_timeout = MIN (*io_timeout, GST_TIMEVAL_TO_TIME (tv));
+    }
+  }
+}
+
+static gpointer gst_pgm_relay_thread (gpointer io_relay)
+{
+  GstPgmRelay* relay = (GstPgmRelay*) io_relay;
+
+  while (!g_atomic_int_get (&relay->quit))
+  {
+    GstClockTime timeout = GST_CLOCK_TIME_NONE;
+    gboolean again = FALSE;
+
+    if (relay->stats_interval > 0)
+    {
+      const gint64 now = g_get_monotonic_time ();
+      if (now >= relay->stats_next)
+      {
+        gst_pgm_relay_update_stats (relay);
+        relay->stats_next = now + (gint64) relay->stats_interval * 1000;
+      }
+      timeout = (relay->stats_next - now) * GST_USECOND;
+    }
+
+    gst_pgm_relay_service (relay, &timeout);
+
+    if (!relay->have_pending && !gst_pgm_relay_receive (relay, &again, &timeout)) break;
+
+    if (relay->have_pending)
+    {
+      gst_pgm_relay_send (relay, &timeout);
+      if (!relay->have_pending) again = TRUE;
+    }
+
+    if (again) continue;
+
+    /* the inbound session waits in its receive window while sending is
+     * held back */
+    gst_pgm_relay_poll_transport (relay, relay->in_transport, FALSE, !relay->have_pending);
+
+    if (gst_poll_wait (relay->poll, timeout) < 0)
+    {
+      if (EBUSY == errno) break;
+      if (EINTR != errno && EAGAIN != errno)
+      {
+        GST_ELEMENT_ERROR (relay, RESOURCE, READ, (NULL), ("poll error: %s", g_strerror (errno)));
+        break;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void gst_pgm_relay_stop (GstPgmRelay* io_relay)
+{
+  if (NULL == io_relay->thread) return;
+
+  g_atomic_int_set (&io_relay->quit, TRUE);
+  gst_poll_set_flushing (io_relay->poll, TRUE);
+  g_thread_join (io_relay->thread);
+  io_relay->thread = NULL;
+  gst_poll_set_flushing (io_relay->poll, FALSE);
+}
+
+/* The transports live from READY to NULL as those of pgmsrc and pgmsink,
+ * APDUs are forwarded while PLAYING. Like a live source it does not
+ * preroll.
+ */
+static GstStateChangeReturn gst_pgm_relay_change_state (GstElement* element, GstStateChange transition)
+{
+  GstPgmRelay* relay = GST_PGM_RELAY (element);
+
+  switch (transition)
+  {
+  case GST_STATE_CHANGE_NULL_TO_READY:
+    if (!gst_pgm_relay_open (relay)) return GST_STATE_CHANGE_FAILURE;
+    break;
+
+  case GST_STATE_CHANGE_READY_TO_PAUSED:
+    if (relay->transport_dirty)
+    {
+      GST_DEBUG_OBJECT (relay, "socket properties changed, rebuilding transports");
+      gst_pgm_relay_close (relay);
+      if (!gst_pgm_relay_open (relay)) return GST_STATE_CHANGE_FAILURE;
+    }
+    relay->in_apdus          = 0;
+    relay->in_bytes          = 0;
+    relay->in_lost_sequences = 0;
+    relay->in_resets         = 0;
+    relay->out_apdus         = 0;
+    relay->out_bytes         = 0;
+    relay->out_rate_limited  = 0;
+    relay->out_errors        = 0;
+    break;
+
+  case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+    relay->quit       = FALSE;
+    relay->stats_next = g_get_monotonic_time ();
+    relay->thread     = g_thread_new ("pgm_relay", gst_pgm_relay_thread, relay);
+    break;
+
+  case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+    gst_pgm_relay_stop (relay);
+    break;
+
+  default:
+    break;
+  }
+
+  GstStateChangeReturn ret = GST_ELEMENT_CLASS (gst_pgm_relay_parent_class)->change_state (element, transition);
+
+  if (GST_STATE_CHANGE_FAILURE == ret) return ret;
+
+  switch (transition)
+  {
+  case GST_STATE_CHANGE_READY_TO_PAUSED:
+  case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+    ret = GST_STATE_CHANGE_NO_PREROLL;
+    break;
+
+  case GST_STATE_CHANGE_READY_TO_NULL:
+    gst_pgm_relay_close (relay);
+    break;
+
+  default:
+    break;
+  }
+
+  return ret;
+}
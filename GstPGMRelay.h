@@ -0,0 +1,97 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer session relay
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_RELAY_H
+#define GST_PGM_RELAY_H
+
+#include <gst/gst.h>
+
+#include <pgm/pgm.h>
+
+#include "GstPGMTransport.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_RELAY             (gst_pgm_relay_get_type())
+#define GST_PGM_RELAY(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PGM_RELAY,GstPgmRelay))
+#define GST_PGM_RELAY_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PGM_RELAY,GstPgmRelayClass))
+#define GST_IS_PGM_RELAY(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_RELAY))
+#define GST_IS_PGM_RELAY_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PGM_RELAY))
+
+typedef struct _GstPgmRelay GstPgmRelay;
+typedef struct _GstPgmRelayClass GstPgmRelayClass;
+
+/* Receives APDUs on one PGM session and sends them on another, without
+ * going through GStreamer buffers, so it has no pads. Forwards while
+ * PLAYING.
+ */
+struct _GstPgmRelay
+{
+  GstElement  parent;
+
+  gchar*   in_network;
+  guint    in_port;
+  gchar*   out_network;
+  guint    out_port;
+  guint    udp_encap_port;
+  guint    max_tpdu;
+  guint    hops;
+  guint    rxw_sqns;
+  guint    txw_sqns;
+  guint    txw_secs;
+  guint    max_rate;
+  guint    stats_interval;
+
+  GstPgmTransport*  in_transport;
+  GstPgmTransport*  out_transport;
+  gboolean          transport_dirty;
+  GstPoll*          poll;
+  GThread*          thread;
+  gint              quit;
+
+  /* APDU the rate limit held back, pointing into the skbs of the last read */
+  struct pgm_msgv_t  pending;
+  struct pgm_iovec   pending_vector[PGM_MAX_FRAGMENTS];
+  gboolean           have_pending;
+
+  gint64         stats_next;
+  guint64        in_apdus;
+  guint64        in_bytes;
+  guint64        in_lost_sequences;
+  guint64        in_resets;
+  guint64        out_apdus;
+  guint64        out_bytes;
+  guint64        out_rate_limited;
+  guint64        out_errors;
+  GstStructure*  stats;
+};
+
+struct _GstPgmRelayClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_pgm_relay_get_type (void);
+
+G_END_DECLS
+
+#endif // GST_PGM_RELAY_H
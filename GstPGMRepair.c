@@ -0,0 +1,82 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer repair round-trip estimation
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <pgm/packet.h>
+
+#include "GstPGMRepair.h"
+
+/* Feed one delivered APDU, TRUE when it completed a sample. i_bo_ivl is the
+ * back-off in effect, half of it on average is waiting rather than network.
+ */
+gboolean gst_pgm_repair_rtt_observe (GstPgmRepairRtt* io_rtt, const struct pgm_msgv_t* i_msgv, guint i_bo_ivl)
+{
+  gboolean   repair = FALSE;
+  pgm_time_t arrival = 0;
+
+  for (unsigned i = 0; i < i_msgv->msgv_len; ++i)
+  {
+    const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[i];
+    if (PGM_RDATA == skb->pgm_header->pgm_type) repair = TRUE;
+    arrival = MAX (arrival, skb->tstamp);
+  }
+
+  if (repair)
+  {
+    io_rtt->repaired = MAX (io_rtt->repaired, arrival);
+    return FALSE;
+  }
+
+  if (0 == io_rtt->repaired) return FALSE;
+
+  /* this ODATA revealed the gap only if it arrived before the repair */
+  const gint64 latency = (gint64)io_rtt->repaired - (gint64)arrival;
+  io_rtt->repaired = 0;
+
+  if (latency <= 0) return FALSE;
+
+  const gint64 sample = MAX (latency - (gint64)i_bo_ivl / 2, latency / 4);
+
+  if (!io_rtt->valid)
+  {
+    io_rtt->srtt   = sample;
+    io_rtt->rttvar = sample / 2;
+    io_rtt->valid  = TRUE;
+  }
+  else
+  {
+    io_rtt->rttvar += (ABS (io_rtt->srtt - sample) - io_rtt->rttvar) / 4;
+    io_rtt->srtt   += (sample - io_rtt->srtt) / 8;
+  }
+  return TRUE;
+}
+
+/* Back off about one round trip so that NAKs of other receivers can still
+ * be suppressed, and wait two retransmission timeouts for NCF and RDATA.
+ */
+void gst_pgm_repair_rtt_intervals (gint64 i_srtt, gint64 i_rttvar, guint i_min, guint i_max, GstPgmNakIntervals* o_ivl)
+{
+  const gint64 rto = i_srtt + 4 * i_rttvar;
+
+  o_ivl->bo_ivl    = (guint) CLAMP (i_srtt , (gint64)i_min, (gint64)i_max);
+  o_ivl->rpt_ivl   = (guint) CLAMP (2 * rto, (gint64)i_min, (gint64)i_max);
+  o_ivl->rdata_ivl = (guint) CLAMP (2 * rto, (gint64)i_min, (gint64)i_max);
+}
@@ -0,0 +1,64 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer repair round-trip estimation
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_REPAIR_H
+#define GST_PGM_REPAIR_H
+
+#include <gst/gst.h>
+
+#include <pgm/pgm.h>
+
+G_BEGIN_DECLS
+
+/* Repair latency of one sender. OpenPGM does not tell its user when it
+ * sends a NAK or receives an NCF, but every skb carries its arrival time and
+ * whether it was original or repair data. Loss is noticed when the data
+ * after the gap arrives, so the time from that ODATA to the RDATA filling
+ * the gap is NAK back-off plus one repair round trip.
+ */
+typedef struct _GstPgmRepairRtt GstPgmRepairRtt;
+
+struct _GstPgmRepairRtt
+{
+  pgm_time_t  repaired;   // arrival of the latest RDATA waiting for the ODATA after it, 0 if none
+  gint64      srtt;       // microseconds, smoothed as in RFC 6298
+  gint64      rttvar;
+  gboolean    valid;
+};
+
+/* NAK intervals derived from the estimate, microseconds like the
+ * nak-*-ivl properties */
+typedef struct _GstPgmNakIntervals GstPgmNakIntervals;
+
+struct _GstPgmNakIntervals
+{
+  guint  bo_ivl;
+  guint  rpt_ivl;
+  guint  rdata_ivl;
+};
+
+gboolean  gst_pgm_repair_rtt_observe (GstPgmRepairRtt*, const struct pgm_msgv_t*, guint);
+void      gst_pgm_repair_rtt_intervals (gint64, gint64, guint, guint, GstPgmNakIntervals*);
+
+G_END_DECLS
+
+#endif // GST_PGM_REPAIR_H
@@ -0,0 +1,257 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer replay of captured APDUs
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+
+#include "GstPGMReplaySrc.h"
+#include "GstPGMConfig.h"
+#include "GstPGMFrame.h"
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_REALTIME,
+  PROP_LAST
+};
+
+static void           gst_pgm_replay_src_finalize (GObject*);
+static void           gst_pgm_replay_src_set_property (GObject*, guint, const GValue*, GParamSpec*);
+static void           gst_pgm_replay_src_get_property (GObject*, guint, GValue*, GParamSpec*);
+static gboolean       gst_pgm_replay_src_open (GstPgmSrc*);
+static void           gst_pgm_replay_src_close (GstPgmSrc*);
+static GstFlowReturn  gst_pgm_replay_src_receive (GstPgmSrc*, GstBuffer**);
+
+G_DEFINE_TYPE (GstPgmReplaySrc, gst_pgm_replay_src, GST_TYPE_PGM_SRC)
+
+static void gst_pgm_replay_src_class_init (GstPgmReplaySrcClass* klass)
+{
+  GstPgmSrcClass* pgmsrcClass = (GstPgmSrcClass*)klass;
+  pgmsrcClass->open    = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_open);
+  pgmsrcClass->close   = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_close);
+  pgmsrcClass->receive = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_receive);
+
+  GObjectClass* gobjectClass = (GObjectClass*)klass;
+  gobjectClass->finalize     = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_finalize);
+  gobjectClass->set_property = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_set_property);
+  gobjectClass->get_property = GST_DEBUG_FUNCPTR(gst_pgm_replay_src_get_property);
+
+  gst_element_class_set_static_metadata
+    ( GST_ELEMENT_CLASS (klass)
+    , "PGM Replay Source"
+    , "Source/File"
+    , "Feeds a GStreamer pipeline with APDUs pgmsrc captured, as pgmsrc would."
+    , "Tim Aerts <jobs@timaerts.be>"
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_LOCATION
+    , g_param_spec_string 
+      ( "location"
+      , "Location"
+      , "Capture file written by pgmsrc's capture-location."
+      , NULL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_REALTIME
+    , g_param_spec_boolean 
+      ( "realtime"
+      , "Realtime"
+      , "Replay records at the pace they arrived, FALSE for as fast as possible."
+      , PGM_DEFAULT_REPLAY_REALTIME
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+}
+
+static void gst_pgm_replay_src_init (GstPgmReplaySrc* io_replay)
+{
+  io_replay->location  = NULL;
+  io_replay->realtime  = PGM_DEFAULT_REPLAY_REALTIME;
+  io_replay->reader    = NULL;
+  io_replay->have_base = FALSE;
+}
+
+static void gst_pgm_replay_src_finalize (GObject* io_obj)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_obj);
+
+  g_free (replay->location);
+
+  G_OBJECT_CLASS(gst_pgm_replay_src_parent_class)->finalize(io_obj);
+}
+
+static void gst_pgm_replay_src_set_property (GObject* io_obj, guint i_propId, const GValue* i_value, GParamSpec* pspec)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_obj);
+
+  switch (i_propId) 
+  {
+  case PROP_LOCATION:
+    g_free (replay->location);
+    replay->location = g_value_dup_string (i_value);
+    GST_PGM_SRC (replay)->transport_dirty = TRUE;
+    break;
+
+  case PROP_REALTIME:
+    replay->realtime = g_value_get_boolean (i_value);
+    break;
+
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (io_obj, i_propId, pspec);
+    break;
+  }
+}
+
+static void gst_pgm_replay_src_get_property (GObject* io_obj, guint i_propId, GValue* o_value, GParamSpec* pspec)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_obj);
+
+  switch (i_propId) 
+  {
+  case PROP_LOCATION:
+    g_value_set_string (o_value, replay->location);
+    break;
+  case PROP_REALTIME:
+    g_value_set_boolean (o_value, replay->realtime);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (io_obj, i_propId, pspec);
+    break;
+  }
+}
+
+/* GstPgmSrcClass::open, map the capture file. As the transports of
+ * pgmsrc, it is opened again at every start, replay starts over.
+ */
+static gboolean gst_pgm_replay_src_open (GstPgmSrc* io_src)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_src);
+  GError* err = NULL;
+
+  if (NULL == replay->location)
+  {
+    GST_ELEMENT_ERROR (replay, RESOURCE, NOT_FOUND, (NULL), ("no capture file to replay, set location"));
+    return FALSE;
+  }
+
+  replay->reader = gst_pgm_capture_reader_new (replay->location, &err);
+  if (NULL == replay->reader)
+  {
+    GST_ELEMENT_ERROR (replay, RESOURCE, OPEN_READ, (NULL), ("cannot replay %s: %s", replay->location, err->message));
+    g_error_free (err);
+    return FALSE;
+  }
+
+  gst_pgm_src_choose_framing (io_src);
+
+  GstPoll* poll = gst_poll_new (TRUE);
+  GstAllocator* allocator = gst_pgm_allocator_new (-1, io_src->hugepages);
+  GST_OBJECT_LOCK (io_src);
+  io_src->poll      = poll;
+  io_src->allocator = allocator;
+  GST_OBJECT_UNLOCK (io_src);
+
+  io_src->transport_dirty = FALSE;
+  io_src->tiered          = 0 != io_src->droppable_port && GST_PGM_FRAMING_RAW != io_src->framing;
+  io_src->lost_sequences  = 0;
+  io_src->resets          = 0;
+  replay->have_base       = FALSE;
+
+  return TRUE;
+}
+
+static void gst_pgm_replay_src_close (GstPgmSrc* io_src)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_src);
+
+  gst_pgm_capture_reader_free (replay->reader);
+  replay->reader = NULL;
+
+  GST_OBJECT_LOCK (io_src);
+  GstPoll* poll = io_src->poll;
+  io_src->poll = NULL;
+  GST_OBJECT_UNLOCK (io_src);
+  if (poll) gst_poll_free (poll);
+
+  GST_OBJECT_LOCK (io_src);
+  GstAllocator* allocator = io_src->allocator;
+  io_src->allocator = NULL;
+  GST_OBJECT_UNLOCK (io_src);
+  if (allocator) gst_object_unref (allocator);
+}
+
+/* hold a record back until as long after the first one as it arrived,
+ * FALSE if unlocked meanwhile
+ */
+static gboolean gst_pgm_replay_src_wait (GstPgmReplaySrc* io_replay, pgm_time_t i_arrival)
+{
+  if (!io_replay->have_base)
+  {
+    io_replay->base_local   = g_get_monotonic_time ();
+    io_replay->base_arrival = i_arrival;
+    io_replay->have_base    = TRUE;
+    return TRUE;
+  }
+
+  const gint64 due = io_replay->base_local + (gint64) (i_arrival - io_replay->base_arrival);
+
+  for (;;)
+  {
+    const gint64 now = g_get_monotonic_time ();
+    if (now >= due) return TRUE;
+
+    if (gst_poll_wait (GST_PGM_SRC (io_replay)->poll, (due - now) * GST_USECOND) < 0 && EBUSY == errno) return FALSE;
+  }
+}
+
+/* GstPgmSrcClass::receive, the records in the order they were captured,
+ * through the same merge, framing and delivery as what pgmsrc receives
+ */
+static GstFlowReturn gst_pgm_replay_src_receive (GstPgmSrc* io_src, GstBuffer** o_buffer)
+{
+  GstPgmReplaySrc* replay = GST_PGM_REPLAY_SRC (io_src);
+  GstPgmCaptureRecord record;
+  GstFlowReturn ret;
+
+  for (;;)
+  {
+    if (gst_pgm_src_take_ready (io_src, o_buffer, &ret)) return ret;
+
+    if (!gst_pgm_capture_reader_next (replay->reader, &record)) return GST_FLOW_EOS;
+
+    if (replay->realtime && !gst_pgm_replay_src_wait (replay, record.arrival)) return GST_FLOW_FLUSHING;
+
+    if (GST_PGM_CAPTURE_RESET == record.kind)
+    {
+      gst_pgm_src_handle_reset (io_src, record.path, &record.msgv);
+      continue;
+    }
+
+    if (gst_pgm_src_handle_apdu (io_src, record.path, &record.msgv, record.len, o_buffer, &ret)) return ret;
+  }
+}
@@ -0,0 +1,66 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer replay of captured APDUs
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_REPLAY_SRC_H
+#define GST_PGM_REPLAY_SRC_H
+
+#include <gst/gst.h>
+
+#include "GstPGMSrc.h"
+#include "GstPGMCapture.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_REPLAY_SRC             (gst_pgm_replay_src_get_type())
+#define GST_PGM_REPLAY_SRC(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PGM_REPLAY_SRC,GstPgmReplaySrc))
+#define GST_PGM_REPLAY_SRC_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PGM_REPLAY_SRC,GstPgmReplaySrcClass))
+#define GST_IS_PGM_REPLAY_SRC(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_REPLAY_SRC))
+#define GST_IS_PGM_REPLAY_SRC_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PGM_REPLAY_SRC))
+
+typedef struct _GstPgmReplaySrc GstPgmReplaySrc;
+typedef struct _GstPgmReplaySrcClass GstPgmReplaySrcClass;
+
+/* pgmsrc reading a capture file instead of the network.
+ */
+struct _GstPgmReplaySrc
+{
+  GstPgmSrc  parent;
+
+  gchar*     location;
+  gboolean   realtime;
+
+  GstPgmCaptureReader*  reader;
+  gboolean              have_base;
+  gint64                base_local;     // monotonic when the first record was replayed
+  pgm_time_t            base_arrival;   // and when it had arrived
+};
+
+struct _GstPgmReplaySrcClass
+{
+  GstPgmSrcClass parent_class;
+};
+
+GType gst_pgm_replay_src_get_type (void);
+
+G_END_DECLS
+
+#endif // GST_PGM_REPLAY_SRC_H
@@ -0,0 +1,351 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer same-host shared memory ring
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "GstPGMShm.h"
+
+#define GST_PGM_SHM_MAGIC    0x50474d52   // "PGMR"
+#define GST_PGM_SHM_PAD      G_MAXUINT32  // rest of the ring is unused, go on at its start
+#define GST_PGM_SHM_ALIGN(n) (((n) + 7) & ~(guint64) 7)
+
+/* Start of the mapping, the ring follows. Fields the other side changes
+ * are only touched atomically.
+ */
+typedef struct
+{
+  guint32   magic;
+  guint32   size;       // of the ring, a power of two
+  gint32    writer;     // pid, 0 once closed
+  gint32    readers;
+  gint32    waiters;    // readers in FUTEX_WAIT
+  guint32   futex;      // bumped for every record
+  guint64   head;       // bytes ever written
+} GstPgmShmHeader;
+
+/* a record: 32 bit length, 8 bit path, 3 zero bytes, the APDU, padding */
+#define GST_PGM_SHM_RECORD_HEADER  8
+
+struct _GstPgmShm
+{
+  gchar*            name;
+  gboolean          writer;
+  gsize             map_size;
+  GstPgmShmHeader*  header;
+  guint8*           ring;
+  guint64           tail;       // reader, bytes consumed
+};
+
+/* one segment per session: multicast group and data-destination port
+ */
+static gchar* gst_pgm_shm_name (const gchar* i_network, guint i_port)
+{
+  const gchar* group = strrchr (i_network, ';');
+  gchar* name = g_strdup_printf ("/gstpgm-%s-%u", group ? group + 1 : i_network, i_port);
+
+  for (gchar* c = name + 1; *c; ++c)
+  {
+    if (!g_ascii_isalnum (*c) && '-' != *c) *c = '_';
+  }
+  return name;
+}
+
+static gboolean gst_pgm_shm_map (GstPgmShm* io_shm, int i_fd, gsize i_size)
+{
+  void* map = mmap (NULL, i_size, PROT_READ | PROT_WRITE, MAP_SHARED, i_fd, 0);
+  if (MAP_FAILED == map) return FALSE;
+
+  io_shm->map_size = i_size;
+  io_shm->header   = map;
+  io_shm->ring     = (guint8*) map + sizeof(GstPgmShmHeader);
+  return TRUE;
+}
+
+/* the writer recorded in a segment still runs
+ */
+static gboolean gst_pgm_shm_writer_alive (const GstPgmShmHeader* i_header)
+{
+  const gint32 writer = __atomic_load_n (&i_header->writer, __ATOMIC_SEQ_CST);
+  return 0 != writer && !(kill (writer, 0) < 0 && ESRCH == errno);
+}
+
+/* a live writer already publishes the session under i_name
+ */
+static gboolean gst_pgm_shm_taken (const gchar* i_name)
+{
+  const int fd = shm_open (i_name, O_RDONLY, 0);
+  if (fd < 0) return FALSE;
+
+  struct stat st;
+  gboolean taken = FALSE;
+
+  if (fstat (fd, &st) == 0 && (gsize) st.st_size >= sizeof(GstPgmShmHeader))
+  {
+    const GstPgmShmHeader* header = mmap (NULL, sizeof(GstPgmShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED != header)
+    {
+      taken = GST_PGM_SHM_MAGIC == __atomic_load_n (&header->magic, __ATOMIC_SEQ_CST) && gst_pgm_shm_writer_alive (header);
+      munmap ((void*) header, sizeof(GstPgmShmHeader));
+    }
+  }
+  close (fd);
+  return taken;
+}
+
+/* pgmsink: a fresh segment, replacing what a writer that died left. NULL
+ * with EEXIST while another writer of the session runs.
+ */
+GstPgmShm* gst_pgm_shm_create (const gchar* i_network, guint i_port, gsize i_size)
+{
+  guint32 size = 1u << g_bit_storage (MAX (i_size, 4096) - 1);
+  GstPgmShm* shm = g_new0 (GstPgmShm, 1);
+
+  shm->name   = gst_pgm_shm_name (i_network, i_port);
+  shm->writer = TRUE;
+
+  if (gst_pgm_shm_taken (shm->name))
+  {
+    errno = EEXIST;
+    goto failed;
+  }
+
+  shm_unlink (shm->name);
+  const int fd = shm_open (shm->name, O_RDWR | O_CREAT | O_EXCL, 0660);
+  if (fd < 0) goto failed;
+
+  if (ftruncate (fd, sizeof(GstPgmShmHeader) + size) < 0 || !gst_pgm_shm_map (shm, fd, sizeof(GstPgmShmHeader) + size))
+  {
+    close (fd);
+    shm_unlink (shm->name);
+    goto failed;
+  }
+  close (fd);
+
+  shm->header->size    = size;
+  shm->header->readers = 0;
+  shm->header->waiters = 0;
+  shm->header->futex   = 0;
+  shm->header->head    = 0;
+  shm->header->writer  = getpid ();
+  __atomic_store_n (&shm->header->magic, GST_PGM_SHM_MAGIC, __ATOMIC_SEQ_CST);
+  return shm;
+
+failed:
+  g_free (shm->name);
+  g_free (shm);
+  return NULL;
+}
+
+/* pgmsrc: the segment of a live writer of this session, NULL if there is
+ * none. Reading starts at the head.
+ */
+GstPgmShm* gst_pgm_shm_attach (const gchar* i_network, guint i_port)
+{
+  gchar* name = gst_pgm_shm_name (i_network, i_port);
+  struct stat st;
+
+  const int fd = shm_open (name, O_RDWR, 0);
+  g_free (name);
+  if (fd < 0) return NULL;
+
+  GstPgmShm* shm = g_new0 (GstPgmShm, 1);
+
+  if ( fstat (fd, &st) < 0 
+     || (gsize) st.st_size <= sizeof(GstPgmShmHeader) 
+     || !gst_pgm_shm_map (shm, fd, st.st_size)
+     )
+  {
+    close (fd);
+    g_free (shm);
+    return NULL;
+  }
+  close (fd);
+
+  const GstPgmShmHeader* header = shm->header;
+
+  if ( GST_PGM_SHM_MAGIC != __atomic_load_n (&header->magic, __ATOMIC_SEQ_CST)
+     || sizeof(GstPgmShmHeader) + header->size != shm->map_size
+     || !gst_pgm_shm_writer_alive (header)
+     )
+  {
+    munmap (shm->header, shm->map_size);
+    g_free (shm);
+    return NULL;
+  }
+
+  __atomic_add_fetch (&shm->header->readers, 1, __ATOMIC_SEQ_CST);
+  shm->tail = __atomic_load_n (&shm->header->head, __ATOMIC_SEQ_CST);
+  return shm;
+}
+
+static void gst_pgm_shm_wake (GstPgmShm* io_shm)
+{
+  syscall (SYS_futex, &io_shm->header->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void gst_pgm_shm_free (GstPgmShm* io_shm)
+{
+  if (NULL == io_shm) return;
+
+  if (io_shm->writer)
+  {
+    /* readers notice and fall back to PGM */
+    __atomic_store_n (&io_shm->header->writer, 0, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch (&io_shm->header->futex, 1, __ATOMIC_SEQ_CST);
+    gst_pgm_shm_wake (io_shm);
+    shm_unlink (io_shm->name);
+  }
+  else
+  {
+    __atomic_sub_fetch (&io_shm->header->readers, 1, __ATOMIC_SEQ_CST);
+  }
+
+  munmap (io_shm->header, io_shm->map_size);
+  g_free (io_shm->name);
+  g_free (io_shm);
+}
+
+/* nobody to publish for, the copy can be saved */
+gboolean gst_pgm_shm_has_readers (const GstPgmShm* i_shm)
+{
+  return __atomic_load_n (&i_shm->header->readers, __ATOMIC_SEQ_CST) > 0;
+}
+
+/* append one APDU, FALSE if it does not fit
+ */
+gboolean gst_pgm_shm_publish (GstPgmShm* io_shm, guint i_path, const struct pgm_iovec* i_vector, unsigned i_count)
+{
+  GstPgmShmHeader* header = io_shm->header;
+  const guint32 size = header->size;
+  gsize len = 0;
+
+  for (unsigned i = 0; i < i_count; ++i) len += i_vector[i].iov_len;
+
+  const guint64 record = GST_PGM_SHM_ALIGN (GST_PGM_SHM_RECORD_HEADER + len);
+  if (record > size / 2) return FALSE;  // readers could never tell it intact
+
+  guint64 head = header->head;
+  guint32 pos = head & (size - 1);
+
+  if (pos + record > size)
+  {
+    GST_WRITE_UINT32_LE (io_shm->ring + pos, GST_PGM_SHM_PAD);
+    head += size - pos;
+    pos = 0;
+  }
+
+  guint8* p = io_shm->ring + pos;
+  GST_WRITE_UINT32_LE (p, len);
+  p[4] = i_path;
+  p[5] = p[6] = p[7] = 0;
+  p += GST_PGM_SHM_RECORD_HEADER;
+  for (unsigned i = 0; i < i_count; ++i)
+  {
+    memcpy (p, i_vector[i].iov_base, i_vector[i].iov_len);
+    p += i_vector[i].iov_len;
+  }
+
+  __atomic_store_n (&header->head, head + record, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch (&header->futex, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&header->waiters, __ATOMIC_SEQ_CST) > 0) gst_pgm_shm_wake (io_shm);
+
+  return TRUE;
+}
+
+/* Copy the next record to io_record. The writer never waits for readers:
+ * a record is intact as long as the head is less than half the ring
+ * ahead, which is checked again once it is copied.
+ */
+GstPgmShmStatus gst_pgm_shm_next (GstPgmShm* io_shm, GByteArray* io_record, guint* o_path)
+{
+  GstPgmShmHeader* header = io_shm->header;
+  const guint32 size = header->size;
+
+  for (;;)
+  {
+    const guint64 head = __atomic_load_n (&header->head, __ATOMIC_SEQ_CST);
+
+    if (head == io_shm->tail)
+    {
+      return __atomic_load_n (&header->writer, __ATOMIC_SEQ_CST) ? GST_PGM_SHM_EMPTY : GST_PGM_SHM_CLOSED;
+    }
+    if (head - io_shm->tail > size / 2)
+    {
+      io_shm->tail = head;
+      return GST_PGM_SHM_LOST;
+    }
+
+    const guint32 pos = io_shm->tail & (size - 1);
+    const guint8* p = io_shm->ring + pos;
+    const guint32 len = GST_READ_UINT32_LE (p);
+
+    if (GST_PGM_SHM_PAD == len)
+    {
+      io_shm->tail += size - pos;
+      continue;
+    }
+    if (pos + GST_PGM_SHM_RECORD_HEADER + (guint64) len > size)
+    {
+      io_shm->tail = head;    // overwritten while we looked
+      return GST_PGM_SHM_LOST;
+    }
+
+    *o_path = p[4];
+    g_byte_array_set_size (io_record, len);
+    memcpy (io_record->data, p + GST_PGM_SHM_RECORD_HEADER, len);
+
+    if (__atomic_load_n (&header->head, __ATOMIC_SEQ_CST) - io_shm->tail > size / 2)
+    {
+      io_shm->tail = __atomic_load_n (&header->head, __ATOMIC_SEQ_CST);
+      return GST_PGM_SHM_LOST;
+    }
+
+    io_shm->tail += GST_PGM_SHM_ALIGN (GST_PGM_SHM_RECORD_HEADER + len);
+    return GST_PGM_SHM_RECORD;
+  }
+}
+
+/* sleep until the writer publishes, at most i_timeout microseconds
+ */
+void gst_pgm_shm_wait (GstPgmShm* io_shm, gint64 i_timeout)
+{
+  GstPgmShmHeader* header = io_shm->header;
+  struct timespec ts = { i_timeout / G_USEC_PER_SEC, (i_timeout % G_USEC_PER_SEC) * 1000 };
+
+  __atomic_add_fetch (&header->waiters, 1, __ATOMIC_SEQ_CST);
+  const guint32 futex = __atomic_load_n (&header->futex, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n (&header->head, __ATOMIC_SEQ_CST) == io_shm->tail && __atomic_load_n (&header->writer, __ATOMIC_SEQ_CST))
+  {
+    syscall (SYS_futex, &header->futex, FUTEX_WAIT, futex, &ts, NULL, 0);
+  }
+  __atomic_sub_fetch (&header->waiters, 1, __ATOMIC_SEQ_CST);
+}
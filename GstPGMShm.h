@@ -0,0 +1,59 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer same-host shared memory ring
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_SHM_H
+#define GST_PGM_SHM_H
+
+#include <gst/gst.h>
+#include <pgm/pgm.h>
+
+G_BEGIN_DECLS
+
+/* A ring in shared memory that pgmsink publishes its APDUs into, framed
+ * exactly as on the wire, and that pgmsrc instances on the same host read
+ * instead of looping multicast through the kernel. One writer, any number
+ * of readers with a cursor each; a reader that falls more than half the
+ * ring behind has lost data and starts over at the head.
+ */
+typedef struct _GstPgmShm GstPgmShm;
+
+typedef enum
+{
+  GST_PGM_SHM_EMPTY  = 0,
+  GST_PGM_SHM_RECORD = 1,
+  GST_PGM_SHM_LOST   = 2,   // overrun, records were skipped
+  GST_PGM_SHM_CLOSED = 3    // the writer went away
+} GstPgmShmStatus;
+
+GstPgmShm*       gst_pgm_shm_create (const gchar*, guint, gsize);
+GstPgmShm*       gst_pgm_shm_attach (const gchar*, guint);
+void             gst_pgm_shm_free (GstPgmShm*);
+
+gboolean         gst_pgm_shm_has_readers (const GstPgmShm*);
+gboolean         gst_pgm_shm_publish (GstPgmShm*, guint, const struct pgm_iovec*, unsigned);
+
+GstPgmShmStatus  gst_pgm_shm_next (GstPgmShm*, GByteArray*, guint*);
+void             gst_pgm_shm_wait (GstPgmShm*, gint64);
+
+G_END_DECLS
+
+#endif // GST_PGM_SHM_H
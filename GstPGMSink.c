@@ -21,11 +21,23 @@
  */
 
 #include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
 #include <netinet/ip.h>
 #include <pgm/packet.h>
 
 #include "GstPGMSink.h"
 #include "GstPGMConfig.h"
+#include "GstPGMFrame.h"
+#include "GstPGMTransport.h"
+
+#define PGM_SINK_MAX_POLL_FDS    8
+#define PGM_SINK_NAK_POLL_MSECS  100
+#define PGM_SINK_SEND_POLL_MSECS 10     // unlock latency while waiting to send
+#define PGM_SINK_CC_WINDOW_MSECS 1000
+#define PGM_SINK_CAPS_MSECS      1000     // caps repeat for late joiners, native framing
+#define GST_PGM_SINK_DROPPABLE_PATH  2
 
 enum
 {
@@ -40,6 +52,28 @@ enum
   PROP_SPM_AMBIENT,
   PROP_IHB_MIN,
   PROP_IHB_MAX,
+  PROP_REDUNDANT_NETWORK,
+  PROP_FRAMING,
+  PROP_HEARTBEAT_SPM,
+  PROP_HEARTBEAT_MODE,
+  PROP_TXW_SECS,
+  PROP_MAX_RATE,
+  PROP_WINDOW_BUDGET,
+  PROP_CONGESTION_CONTROL,
+  PROP_CLOCK_INTERVAL,
+  PROP_DROPPABLE_PORT,
+  PROP_LEAKY,
+  PROP_MAX_QUEUE_TIME,
+  PROP_DROPPED_NEW,
+  PROP_DROPPED_OLD,
+  PROP_SHM_SIZE,
+  PROP_KEYS,
+  PROP_KEY_EPOCH,
+  PROP_COMPRESSION,
+  PROP_DICTIONARY_INTERVAL,
+  PROP_HUGEPAGES,
+  PROP_ALLOCATOR_STATS,
+  PROP_SEND_STAMPS,
   PROP_LAST
 };
 
@@ -51,6 +85,14 @@ static GstStaticPadTemplate gst_pgm_sink_sink_template =
                           , GST_STATIC_CAPS_ANY
                           );
 
+/* further elementary streams in the same session, native framing */
+static GstStaticPadTemplate gst_pgm_sink_stream_template =
+  GST_STATIC_PAD_TEMPLATE ( "sink_%u"
+                          , GST_PAD_SINK
+                          , GST_PAD_REQUEST
+                          , GST_STATIC_CAPS_ANY
+                          );
+
 static gboolean       gst_pgm_sink_set_uri (GstPgmSink*, const gchar*);
 static void           gst_pgm_sink_uri_handler_init (gpointer, gpointer);
 static GstFlowReturn  gst_pgm_sink_render (GstBaseSink*, GstBuffer*);
@@ -59,9 +101,121 @@ static gboolean       gst_pgm_client_sink_start (GstBaseSink*);
 static void           gst_pgm_sink_finalize (GObject*);
 static void           gst_pgm_sink_set_property (GObject*, guint, const GValue*, GParamSpec*);
 static void           gst_pgm_sink_get_property (GObject*, guint, GValue*, GParamSpec*);
+static GstStateChangeReturn gst_pgm_sink_change_state (GstElement*, GstStateChange);
+static gboolean       gst_pgm_sink_set_caps (GstBaseSink*, GstCaps*);
+static gboolean       gst_pgm_sink_open (GstPgmSink*);
+static void           gst_pgm_sink_close (GstPgmSink*);
+static gboolean       gst_pgm_sink_unlock (GstBaseSink*);
+static gboolean       gst_pgm_sink_unlock_stop (GstBaseSink*);
+static gboolean       gst_pgm_sink_propose_allocation (GstBaseSink*, GstQuery*);
+static GstPad*        gst_pgm_sink_request_new_pad (GstElement*, GstPadTemplate*, const gchar*, const GstCaps*);
+static void           gst_pgm_sink_release_pad (GstElement*, GstPad*);
+static void           gst_pgm_sink_stream_init (GstPgmSinkStream*, guint16, gboolean);
+static void           gst_pgm_sink_queue_flush (GstPgmSink*, GstPgmSinkStream*, gboolean);
 
 G_DEFINE_TYPE (GstPgmSink, gst_pgm_sink, GST_TYPE_BASE_SINK)
 
+GType gst_pgm_heartbeat_mode_get_type (void)
+{
+  static GType mode_type = 0;
+  static const GEnumValue modes[] =
+    { { GST_PGM_HEARTBEAT_FIXED   , "Intervals of heartbeat-spm"                       , "fixed"    }
+    , { GST_PGM_HEARTBEAT_IHB     , "Doubling from ihb-min to ihb-max"                 , "ihb"      }
+    , { GST_PGM_HEARTBEAT_ADAPTIVE, "Shaped by the frame interval within ihb-min/max"  , "adaptive" }
+    , { 0, NULL, NULL }
+    };
+
+  if (!mode_type)
+  {
+    mode_type = g_enum_register_static ("GstPgmHeartbeatMode", modes);
+  }
+  return mode_type;
+}
+
+GType gst_pgm_leaky_get_type (void)
+{
+  static GType leaky_type = 0;
+  static const GEnumValue leaky[] =
+    { { GST_PGM_LEAKY_NONE       , "Block upstream"                              , "none"                     }
+    , { GST_PGM_LEAKY_DROP_NEW   , "Drop incoming buffers while the queue is full", "drop-new"                 }
+    , { GST_PGM_LEAKY_DROP_OLDEST, "Drop the oldest queued non-keyframes"        , "drop-oldest-non-keyframe" }
+    , { 0, NULL, NULL }
+    };
+
+  if (!leaky_type)
+  {
+    leaky_type = g_enum_register_static ("GstPgmLeaky", leaky);
+  }
+  return leaky_type;
+}
+
+/* parse comma separated microsecond intervals, NULL if malformed
+ */
+static GArray* gst_pgm_sink_parse_heartbeat (const gchar* i_spec)
+{
+  GArray* intervals = g_array_new (FALSE, FALSE, sizeof(int));
+  gchar** items = g_strsplit (i_spec, ",", -1);
+
+  for (gchar** item = items; *item; ++item)
+  {
+    gchar* end = NULL;
+    const guint64 value = g_ascii_strtoull (*item, &end, 10);
+
+    if (end == *item || *g_strstrip (end) != '\0' || value == 0 || value > G_MAXINT)
+    {
+      g_array_free (intervals, TRUE);
+      intervals = NULL;
+      break;
+    }
+    const int ivl = (int) value;
+    g_array_append_val (intervals, ivl);
+  }
+
+  g_strfreev (items);
+  return intervals;
+}
+
+/* The heartbeat restarts after every ODATA, so its first intervals decide
+ * how soon a receiver hears about the tail of a burst. Adaptive mode puts
+ * the first heartbeat a quarter frame after the data so that a lost tail is
+ * NAKed within the frame period; on busy streams the next frame's data
+ * comes first and no SPM is sent at all. *o_shaped is the frame interval
+ * the schedule was made for, GST_CLOCK_TIME_NONE if none.
+ */
+static GArray* gst_pgm_sink_heartbeat_schedule (GstPgmSink* io_sink, GstClockTime* o_shaped)
+{
+  const guint ihb_max = MAX (io_sink->ihb_min, io_sink->ihb_max);
+  guint first = io_sink->ihb_min;
+
+  *o_shaped = GST_CLOCK_TIME_NONE;
+
+  if (GST_PGM_HEARTBEAT_FIXED == io_sink->heartbeat_mode)
+  {
+    GArray* intervals = gst_pgm_sink_parse_heartbeat (io_sink->heartbeat_spm);
+    if (intervals) return intervals;
+    GST_WARNING_OBJECT (io_sink, "malformed heartbeat-spm, using ihb-min/ihb-max");
+  }
+
+  if (GST_PGM_HEARTBEAT_ADAPTIVE == io_sink->heartbeat_mode && GST_CLOCK_TIME_IS_VALID (io_sink->frame_interval))
+  {
+    const guint64 quarter = GST_TIME_AS_USECONDS (io_sink->frame_interval) / 4;
+    first = (guint) CLAMP (quarter, io_sink->ihb_min, ihb_max);
+    *o_shaped = io_sink->frame_interval;
+  }
+
+  GArray* intervals = g_array_new (FALSE, FALSE, sizeof(int));
+  int ivl = (int) first;
+
+  g_array_append_val (intervals, ivl);   // twice, one SPM may be lost as well
+  for (; (guint) ivl < ihb_max; ivl = (int) MIN ((guint64) ivl * 2, ihb_max))
+  {
+    g_array_append_val (intervals, ivl);
+  }
+  g_array_append_val (intervals, ivl);
+
+  return intervals;
+}
+
 static GstURIType gst_pgm_sink_uri_get_type (GType dummy) 
 {
   return GST_URI_SRC;
@@ -139,6 +293,7 @@ static gboolean gst_pgm_sink_set_uri (GstPgmSink* io_sink, const gchar* i_uri)
   g_free (location);
 
   gst_pgm_sink_update_uri (io_sink);
+  io_sink->transport_dirty = TRUE;
   return TRUE;
 
   }
@@ -156,15 +311,48 @@ wrong_protocol:
   return FALSE;
 }
 
+/* service NAKs and SPM timers of every path, waking up regularly to
+ * notice nak_quit
+ */
 static gpointer gst_pgm_sink_nak_thread (gpointer io_sink)
 {
   GstPgmSink* sink = (GstPgmSink*) io_sink;
+  struct pgm_sock_t* socks[] = 
+    { sink->transport->sock
+    , sink->redundant_transport ? sink->redundant_transport->sock : NULL 
+    , sink->droppable_transport ? sink->droppable_transport->sock : NULL 
+    };
   struct pgm_msgv_t msgv;
 
-  int result;
   do 
   {
-    result = pgm_recvmsg (sink->sock, &msgv, 0, NULL, NULL);
+    struct pollfd fds[PGM_SINK_MAX_POLL_FDS];
+    int n_fds = 0;
+    int timeout = PGM_SINK_NAK_POLL_MSECS;
+
+    for (unsigned i = 0; i < G_N_ELEMENTS(socks); ++i)
+    {
+      if (socks[i] == NULL) continue;
+
+      const int status = pgm_recvmsg (socks[i], &msgv, MSG_DONTWAIT, NULL, NULL);
+      if (PGM_IO_STATUS_TIMER_PENDING == status)
+      {
+        struct timeval tv;
+        socklen_t optlen = sizeof(tv);
+        if (pgm_getsockopt (socks[i], IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen))
+        {
+          timeout = MIN (timeout, (int)(tv.tv_sec * 1000 + tv.tv_usec / 1000));
+        }
+      }
+
+      int n = PGM_SINK_MAX_POLL_FDS - n_fds;
+      if (pgm_poll_info (socks[i], &fds[n_fds], &n, POLLIN) > 0)
+      {
+        n_fds += n;
+      }
+    }
+
+    poll (fds, n_fds, timeout);
   } 
   while (!sink->nak_quit);
 
@@ -181,18 +369,29 @@ static void gst_pgm_sink_class_init (GstPgmSinkClass* klass)
   gstbasesink_class->start   = GST_DEBUG_FUNCPTR(gst_pgm_client_sink_start);
   gstbasesink_class->stop    = GST_DEBUG_FUNCPTR(gst_pgm_client_sink_stop);
   gstbasesink_class->render  = GST_DEBUG_FUNCPTR(gst_pgm_sink_render);
+  gstbasesink_class->set_caps = GST_DEBUG_FUNCPTR(gst_pgm_sink_set_caps);
+  gstbasesink_class->unlock   = GST_DEBUG_FUNCPTR(gst_pgm_sink_unlock);
+  gstbasesink_class->unlock_stop = GST_DEBUG_FUNCPTR(gst_pgm_sink_unlock_stop);
+  gstbasesink_class->propose_allocation = GST_DEBUG_FUNCPTR(gst_pgm_sink_propose_allocation);
+
+  GstElementClass* elementClass = GST_ELEMENT_CLASS (klass);
+  elementClass->change_state = GST_DEBUG_FUNCPTR(gst_pgm_sink_change_state);
+  elementClass->request_new_pad = GST_DEBUG_FUNCPTR(gst_pgm_sink_request_new_pad);
+  elementClass->release_pad  = GST_DEBUG_FUNCPTR(gst_pgm_sink_release_pad);
 
   GObjectClass* gobjectClass = (GObjectClass*)klass;
   gobjectClass->finalize      = GST_DEBUG_FUNCPTR(gst_pgm_sink_finalize);
   gobjectClass->set_property  = GST_DEBUG_FUNCPTR(gst_pgm_sink_set_property);
   gobjectClass->get_property  = GST_DEBUG_FUNCPTR(gst_pgm_sink_get_property);
 
-  GstElementClass* elementClass = GST_ELEMENT_CLASS (klass);
-
   gst_element_class_add_pad_template
     ( elementClass 
     , gst_static_pad_template_get (&gst_pgm_sink_sink_template)
     );
+  gst_element_class_add_pad_template
+    ( elementClass 
+    , gst_static_pad_template_get (&gst_pgm_sink_stream_template)
+    );
 
   gst_element_class_set_static_metadata
     ( elementClass
@@ -337,11 +536,304 @@ static void gst_pgm_sink_class_init (GstPgmSinkClass* klass)
       , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
       )
     );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_REDUNDANT_NETWORK
+    , g_param_spec_string 
+      ( "redundant-network"
+      , "Redundant network"
+      , "Second rendezvous style multicast network over which every APDU is sent again, NULL to disable."
+      , NULL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_FRAMING
+    , g_param_spec_enum 
+      ( "framing"
+      , "Framing"
+      , "Header put in front of the payload of every APDU."
+      , GST_TYPE_PGM_FRAMING
+      , GST_PGM_FRAMING_RAW
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_HEARTBEAT_SPM
+    , g_param_spec_string 
+      ( "heartbeat-spm"
+      , "HEARTBEAT_SPM"
+      , "Comma separated SPM heartbeat intervals after data, in microseconds, used in fixed mode."
+      , PGM_DEFAULT_HEARTBEAT_SPM
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_HEARTBEAT_MODE
+    , g_param_spec_enum 
+      ( "heartbeat-mode"
+      , "Heartbeat mode"
+      , "How the SPM heartbeat schedule is made."
+      , GST_TYPE_PGM_HEARTBEAT_MODE
+      , GST_PGM_HEARTBEAT_FIXED
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_TXW_SECS
+    , g_param_spec_uint 
+      ( "txw-secs"
+      , "TXW_SECS"
+      , "Transmit window in seconds of the stream at max-rate, 0 to size it by txw-sqns."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_TXW_SECS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_MAX_RATE
+    , g_param_spec_uint 
+      ( "max-rate"
+      , "Maximum rate"
+      , "Maximum send rate in bits per second, sizes time based windows and limits the sender."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_MAX_RATE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_WINDOW_BUDGET
+    , g_param_spec_uint64 
+      ( "window-budget"
+      , "Window budget"
+      , "Maximum bytes of packets the transmit window may hold, 0 for no limit."
+      , 0 // minimum
+      , G_MAXUINT64
+      , PGM_DEFAULT_WINDOW_BUDGET
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_CONGESTION_CONTROL
+    , g_param_spec_enum 
+      ( "congestion-control"
+      , "Congestion control"
+      , "Pace sending to the receivers, the resulting bitrate is posted as pgm-congestion."
+      , GST_TYPE_PGM_CONGESTION_CONTROL
+      , GST_PGM_CONGESTION_CONTROL_NONE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_CLOCK_INTERVAL
+    , g_param_spec_uint 
+      ( "clock-interval"
+      , "Clock interval"
+      , "Milliseconds between samples of the pipeline clock sent in band with native framing, 0 for none."
+      , 0
+      , G_MAXUINT
+      , PGM_DEFAULT_CLOCK_INTERVAL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_DROPPABLE_PORT
+    , g_param_spec_uint 
+      ( "droppable-port"
+      , "Droppable port"
+      , "Data-destination port of a sibling session for droppable buffers, which receivers do not repair, 0 for none."
+      , 0
+      , 65535
+      , PGM_DEFAULT_DROPPABLE_PORT
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_LEAKY
+    , g_param_spec_enum 
+      ( "leaky"
+      , "Leaky"
+      , "Queue buffers and send them from a thread of their own, dropping what waits longer than max-queue-time."
+      , GST_TYPE_PGM_LEAKY
+      , GST_PGM_LEAKY_NONE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_MAX_QUEUE_TIME
+    , g_param_spec_uint 
+      ( "max-queue-time"
+      , "Maximum queue time"
+      , "Milliseconds a buffer may wait to be sent when leaky."
+      , 1
+      , G_MAXUINT
+      , PGM_DEFAULT_MAX_QUEUE_TIME
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_DROPPED_NEW
+    , g_param_spec_uint64 
+      ( "dropped-new"
+      , "Dropped new"
+      , "Incoming buffers dropped because the queue was full."
+      , 0
+      , G_MAXUINT64
+      , 0
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_DROPPED_OLD
+    , g_param_spec_uint64 
+      ( "dropped-old"
+      , "Dropped old"
+      , "Queued buffers dropped for waiting longer than max-queue-time."
+      , 0
+      , G_MAXUINT64
+      , 0
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_SHM_SIZE
+    , g_param_spec_uint 
+      ( "shm-size"
+      , "Shared memory size"
+      , "Bytes of the ring pgmsrc on this host reads instead of multicast loopback, 0 to loop back through the kernel. Receivers on this host that do not read the ring get nothing."
+      , 0
+      , 1 << 30
+      , PGM_DEFAULT_SHM_SIZE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_KEYS
+    , g_param_spec_string 
+      ( "keys"
+      , "Keys"
+      , "AES-GCM keys as epoch:hex-key[,epoch:hex-key...], 128 or 256 bit, to encrypt and authenticate every APDU with, NULL to send in the clear. Write-only."
+      , NULL
+      , (GParamFlags) G_PARAM_WRITABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_KEY_EPOCH
+    , g_param_spec_uint 
+      ( "key-epoch"
+      , "Key epoch"
+      , "Epoch of the key in keys to encrypt with, receivers need it among theirs before it is switched to."
+      , 0
+      , G_MAXUINT32
+      , PGM_DEFAULT_KEY_EPOCH
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_COMPRESSION
+    , g_param_spec_enum 
+      ( "compression"
+      , "Compression"
+      , "Compress payloads that shrink, needs a frame header. Payloads that do not shrink go out as they are."
+      , GST_TYPE_PGM_COMPRESSION
+      , GST_PGM_COMPRESSION_NONE
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_DICTIONARY_INTERVAL
+    , g_param_spec_uint 
+      ( "dictionary-interval"
+      , "Dictionary interval"
+      , "Milliseconds between reliable APDUs that become the compression dictionary of their stream, 0 to compress every APDU on its own."
+      , 0
+      , G_MAXUINT
+      , PGM_DEFAULT_DICTIONARY_INTERVAL
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_HUGEPAGES
+    , g_param_spec_boolean 
+      ( "hugepages"
+      , "Huge pages"
+      , "Offer upstream memory on huge pages of the NUMA node of the interface, plain pages if none are reserved."
+      , PGM_DEFAULT_HUGEPAGES
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_ALLOCATOR_STATS
+    , g_param_spec_boxed 
+      ( "allocator-stats"
+      , "Allocator statistics"
+      , "pgm-allocator-stats of the memory offered upstream, NULL before the transport is open."
+      , GST_TYPE_STRUCTURE
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_SEND_STAMPS
+    , g_param_spec_boolean 
+      ( "send-stamps"
+      , "Send stamps"
+      , "Tell receivers the wall clock time each framed buffer was sent and how long it waited before, the pgmlatency tracer turns it on."
+      , FALSE
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
 }
 
 static void gst_pgm_sink_init ( GstPgmSink* io_sink)
 {
-  io_sink->sock = NULL;
+  io_sink->transport = NULL;
+  io_sink->redundant_transport = NULL;
+  io_sink->transport_dirty = FALSE;
 
   io_sink->network         = g_strdup (PGM_DEFAULT_NETWORK);
   io_sink->port            = PGM_DEFAULT_PORT;
@@ -350,9 +842,58 @@ static void gst_pgm_sink_init ( GstPgmSink* io_sink)
   io_sink->max_tpdu        = PGM_DEFAULT_MAX_TPDU;
   io_sink->hops            = PGM_DEFAULT_HOPS;
   io_sink->txw_sqns        = PGM_DEFAULT_TXW_SQNS;
+  io_sink->txw_secs        = PGM_DEFAULT_TXW_SECS;
+  io_sink->max_rate        = PGM_DEFAULT_MAX_RATE;
+  io_sink->window_budget   = PGM_DEFAULT_WINDOW_BUDGET;
+  io_sink->congestion_control = GST_PGM_CONGESTION_CONTROL_NONE;
+  io_sink->streams         = NULL;
+  g_mutex_init (&io_sink->send_lock);
+  io_sink->pending[0]      = NULL;
+  io_sink->pending[1]      = NULL;
+  io_sink->pending[2]      = NULL;
+  gst_pgm_sink_stream_init (&io_sink->stream, 0, FALSE);
+  io_sink->clock_interval  = PGM_DEFAULT_CLOCK_INTERVAL;
+  io_sink->clock_next      = 0;
+  io_sink->droppable_port  = PGM_DEFAULT_DROPPABLE_PORT;
+  io_sink->droppable_transport = NULL;
+  io_sink->anchor          = 0;
+  io_sink->shm_size        = PGM_DEFAULT_SHM_SIZE;
+  io_sink->shm             = NULL;
+  io_sink->keys            = NULL;
+  io_sink->key_epoch       = PGM_DEFAULT_KEY_EPOCH;
+  io_sink->crypto          = NULL;
+  io_sink->sealed          = g_byte_array_new ();
+  io_sink->compression     = GST_PGM_COMPRESSION_NONE;
+  io_sink->dictionary_interval = PGM_DEFAULT_DICTIONARY_INTERVAL;
+  io_sink->deflated        = g_byte_array_new ();
+  io_sink->hugepages       = PGM_DEFAULT_HUGEPAGES;
+  io_sink->allocator       = NULL;
+  io_sink->send_stamps     = FALSE;
+  io_sink->leaky           = GST_PGM_LEAKY_NONE;
+  io_sink->max_queue_time  = PGM_DEFAULT_MAX_QUEUE_TIME;
+  io_sink->send_thread     = NULL;
+  io_sink->send_quit       = FALSE;
+  g_mutex_init (&io_sink->queue_lock);
+  g_cond_init (&io_sink->queue_cond);
+  g_queue_init (&io_sink->queue);
+  io_sink->queue_sending   = NULL;
+  io_sink->queue_ret       = GST_FLOW_OK;
+  io_sink->dropped_new     = 0;
+  io_sink->dropped_old     = 0;
   io_sink->spm_ambient     = PGM_DEFAULT_SPM_AMBIENT;
   io_sink->ihb_min         = PGM_DEFAULT_IHB_MIN;
   io_sink->ihb_max         = PGM_DEFAULT_IHB_MAX;
+  io_sink->redundant_network = NULL;
+  io_sink->framing         = GST_PGM_FRAMING_RAW;
+  io_sink->framing_set     = FALSE;
+  io_sink->async_disabled  = FALSE;
+  io_sink->heartbeat_spm   = g_strdup (PGM_DEFAULT_HEARTBEAT_SPM);
+  io_sink->heartbeat_mode  = GST_PGM_HEARTBEAT_FIXED;
+  io_sink->frame_interval  = GST_CLOCK_TIME_NONE;
+  io_sink->heartbeat_interval = GST_CLOCK_TIME_NONE;
+  io_sink->heartbeat_learned  = GST_CLOCK_TIME_NONE;
+  io_sink->last_pts        = GST_CLOCK_TIME_NONE;
+  io_sink->last_render     = 0;
 }
 
 static void gst_pgm_sink_finalize ( GObject* io_obj)
@@ -361,10 +902,45 @@ static void gst_pgm_sink_finalize ( GObject* io_obj)
 
   g_free (sink->network);
   g_free (sink->uri);
+  g_free (sink->redundant_network);
+  g_free (sink->heartbeat_spm);
+  g_free (sink->stream.caps_string);
+  g_free (sink->keys);
+  gst_pgm_crypto_unref (sink->crypto);
+  g_byte_array_free (sink->sealed, TRUE);
+  gst_pgm_deflate_clear (&sink->stream.deflate);
+  g_byte_array_free (sink->deflated, TRUE);
+  g_mutex_clear (&sink->send_lock);
+  g_mutex_clear (&sink->queue_lock);
+  g_cond_clear (&sink->queue_cond);
 
   G_OBJECT_CLASS(gst_pgm_sink_parent_class)->finalize(io_obj);
 }
 
+/* keys that do not parse leave no crypto behind, sending fails rather
+ * than going out in the clear
+ */
+static void gst_pgm_sink_set_keys (GstPgmSink* io_sink, const gchar* i_keys)
+{
+  GstPgmCrypto* crypto = NULL;
+  GError* err = NULL;
+
+  if (i_keys && NULL == (crypto = gst_pgm_crypto_new (i_keys, &err)))
+  {
+    GST_WARNING_OBJECT (io_sink, "invalid keys: %s", err->message);
+    g_error_free (err);
+  }
+
+  GST_OBJECT_LOCK (io_sink);
+  GstPgmCrypto* old = io_sink->crypto;
+  g_free (io_sink->keys);
+  io_sink->keys   = g_strdup (i_keys);
+  io_sink->crypto = crypto;
+  GST_OBJECT_UNLOCK (io_sink);
+
+  gst_pgm_crypto_unref (old);
+}
+
 static void gst_pgm_sink_set_property (GObject* io_obj, guint i_propId, const GValue* i_value, GParamSpec* pspec)
 {
   GstPgmSink* sink = GST_PGM_SINK (io_obj);
@@ -410,6 +986,22 @@ static void gst_pgm_sink_set_property (GObject* io_obj, guint i_propId, const GV
     sink->txw_sqns = g_value_get_uint (i_value);
     break;
 
+  case PROP_TXW_SECS:
+    sink->txw_secs = g_value_get_uint (i_value);
+    break;
+
+  case PROP_MAX_RATE:
+    sink->max_rate = g_value_get_uint (i_value);
+    break;
+
+  case PROP_WINDOW_BUDGET:
+    sink->window_budget = g_value_get_uint64 (i_value);
+    break;
+
+  case PROP_CONGESTION_CONTROL:
+    sink->congestion_control = g_value_get_enum (i_value);
+    break;
+
   case PROP_SPM_AMBIENT:
     sink->spm_ambient = g_value_get_uint (i_value);
     break;
@@ -421,7 +1013,84 @@ static void gst_pgm_sink_set_property (GObject* io_obj, guint i_propId, const GV
   case PROP_IHB_MAX:
     sink->ihb_max = g_value_get_uint (i_value);
     break;
+
+  case PROP_REDUNDANT_NETWORK:
+    g_free (sink->redundant_network);
+    sink->redundant_network = g_value_dup_string (i_value);
+    break;
+
+  case PROP_CLOCK_INTERVAL:
+    sink->clock_interval = g_value_get_uint (i_value);
+    return;
+
+  case PROP_DROPPABLE_PORT:
+    sink->droppable_port = g_value_get_uint (i_value);
+    break;
+
+  case PROP_LEAKY:
+    sink->leaky = g_value_get_enum (i_value);
+    return;
+
+  case PROP_SHM_SIZE:
+    sink->shm_size = g_value_get_uint (i_value);
+    break;
+
+  case PROP_KEYS:
+    gst_pgm_sink_set_keys (sink, g_value_get_string (i_value));
+    return;
+
+  case PROP_KEY_EPOCH:
+    GST_OBJECT_LOCK (sink);
+    sink->key_epoch = g_value_get_uint (i_value);
+    GST_OBJECT_UNLOCK (sink);
+    return;
+
+  case PROP_COMPRESSION:
+    sink->compression = g_value_get_enum (i_value);
+    return;
+
+  case PROP_DICTIONARY_INTERVAL:
+    sink->dictionary_interval = g_value_get_uint (i_value);
+    return;
+
+  case PROP_HUGEPAGES:
+    sink->hugepages = g_value_get_boolean (i_value);
+    break;
+
+  case PROP_SEND_STAMPS:
+    g_atomic_int_set (&sink->send_stamps, g_value_get_boolean (i_value));
+    return;
+
+  case PROP_MAX_QUEUE_TIME:
+    sink->max_queue_time = g_value_get_uint (i_value);
+    return;
+
+  case PROP_FRAMING:
+    sink->framing     = g_value_get_enum (i_value);
+    sink->framing_set = TRUE;
+    return;
+
+  case PROP_HEARTBEAT_SPM:
+  {
+    GArray* intervals = gst_pgm_sink_parse_heartbeat (g_value_get_string (i_value) ? g_value_get_string (i_value) : "");
+    if (intervals == NULL)
+    {
+      GST_WARNING_OBJECT (sink, "ignoring malformed heartbeat-spm %s", g_value_get_string (i_value));
+      return;
+    }
+    g_array_free (intervals, TRUE);
+    g_free (sink->heartbeat_spm);
+    sink->heartbeat_spm = g_value_dup_string (i_value);
+    break;
+  }
+
+  case PROP_HEARTBEAT_MODE:
+    sink->heartbeat_mode = g_value_get_enum (i_value);
+    break;
   }
+
+  /* everything but the framing is a socket option */
+  sink->transport_dirty = TRUE;
 }
 
 static void gst_pgm_sink_get_property (GObject* io_obj, guint i_propId, GValue* o_value, GParamSpec* pspec)
@@ -451,249 +1120,1462 @@ static void gst_pgm_sink_get_property (GObject* io_obj, guint i_propId, GValue*
   case PROP_TXW_SQNS:
     g_value_set_uint (o_value, sink->txw_sqns);
     break;
-  case PROP_SPM_AMBIENT:
-    g_value_set_uint (o_value, sink->spm_ambient);
+  case PROP_TXW_SECS:
+    g_value_set_uint (o_value, sink->txw_secs);
     break;
-  case PROP_IHB_MIN:
-    g_value_set_uint (o_value, sink->ihb_min);
+  case PROP_MAX_RATE:
+    g_value_set_uint (o_value, sink->max_rate);
     break;
-  case PROP_IHB_MAX:
-    g_value_set_uint (o_value, sink->ihb_max);
+  case PROP_WINDOW_BUDGET:
+    g_value_set_uint64 (o_value, sink->window_budget);
     break;
-  }
-}
+  case PROP_CONGESTION_CONTROL:
+    g_value_set_enum (o_value, sink->congestion_control);
+    break;
+  case PROP_CLOCK_INTERVAL:
+    g_value_set_uint (o_value, sink->clock_interval);
+    break;
+  case PROP_DROPPABLE_PORT:
+    g_value_set_uint (o_value, sink->droppable_port);
+    break;
+  case PROP_LEAKY:
+    g_value_set_enum (o_value, sink->leaky);
+    break;
+  case PROP_SHM_SIZE:
+    g_value_set_uint (o_value, sink->shm_size);
+    break;
+  case PROP_KEY_EPOCH:
+    g_value_set_uint (o_value, sink->key_epoch);
+    break;
+  case PROP_COMPRESSION:
+    g_value_set_enum (o_value, sink->compression);
+    break;
+  case PROP_DICTIONARY_INTERVAL:
+    g_value_set_uint (o_value, sink->dictionary_interval);
+    break;
+  case PROP_HUGEPAGES:
+    g_value_set_boolean (o_value, sink->hugepages);
+    break;
+  case PROP_ALLOCATOR_STATS:
+  {
+    /* open and close swap the allocator under the object lock */
+    GST_OBJECT_LOCK (sink);
+    GstAllocator* allocator = sink->allocator ? gst_object_ref (sink->allocator) : NULL;
+    GST_OBJECT_UNLOCK (sink);
 
-/* GstBaseSinkClass::render
+    g_value_take_boxed (o_value, allocator ? gst_pgm_allocator_get_stats (allocator) : NULL);
+    if (allocator) gst_object_unref (allocator);
+    break;
+  }
+  case PROP_SEND_STAMPS:
+    g_value_set_boolean (o_value, g_atomic_int_get (&sink->send_stamps));
+    break;
+  case PROP_MAX_QUEUE_TIME:
+    g_value_set_uint (o_value, sink->max_queue_time);
+    break;
+  case PROP_DROPPED_NEW:
+    g_mutex_lock (&sink->queue_lock);
+    g_value_set_uint64 (o_value, sink->dropped_new);
+    g_mutex_unlock (&sink->queue_lock);
+    break;
+  case PROP_DROPPED_OLD:
+    g_mutex_lock (&sink->queue_lock);
+    g_value_set_uint64 (o_value, sink->dropped_old);
+    g_mutex_unlock (&sink->queue_lock);
+    break;
+  case PROP_SPM_AMBIENT:
+    g_value_set_uint (o_value, sink->spm_ambient);
+    break;
+  case PROP_IHB_MIN:
+    g_value_set_uint (o_value, sink->ihb_min);
+    break;
+  case PROP_IHB_MAX:
+    g_value_set_uint (o_value, sink->ihb_max);
+    break;
+  case PROP_REDUNDANT_NETWORK:
+    g_value_set_string (o_value, sink->redundant_network);
+    break;
+  case PROP_FRAMING:
+    g_value_set_enum (o_value, sink->framing);
+    break;
+  case PROP_HEARTBEAT_SPM:
+    g_value_set_string (o_value, sink->heartbeat_spm);
+    break;
+  case PROP_HEARTBEAT_MODE:
+    g_value_set_enum (o_value, sink->heartbeat_mode);
+    break;
+  }
+}
+
+/* Remember the current frame interval for the adaptive heartbeat. OpenPGM
+ * refuses PGM_HEARTBEAT_SPM once a socket is connected, so the schedule is
+ * only made when the transport is opened: a frame interval learned while
+ * sending applies from the next start.
+ */
+static void gst_pgm_sink_learn_heartbeat (GstPgmSink* io_sink)
+{
+  io_sink->heartbeat_learned = io_sink->frame_interval;
+  if (io_sink->heartbeat_learned == io_sink->heartbeat_interval) return;
+
+  GST_DEBUG_OBJECT (io_sink, "frame interval %" GST_TIME_FORMAT ", heartbeat reshaped at the next start", GST_TIME_ARGS (io_sink->frame_interval));
+  io_sink->transport_dirty = TRUE;
+}
+
+/* Buffer interval of streams whose caps carry no framerate, smoothed over
+ * eight buffers: from the timestamps, or from the rate buffers are sent at
+ * when they have none. Learned for the adaptive heartbeat once it moved by
+ * more than an eighth.
+ */
+static void gst_pgm_sink_observe_interval (GstPgmSink* io_sink, GstBuffer* i_buffer, gint64 i_entered)
+{
+  const GstClockTime pts = GST_BUFFER_PTS (i_buffer);
+  GstClockTime delta = GST_CLOCK_TIME_NONE;
+
+  if (GST_CLOCK_TIME_IS_VALID (pts))
+  {
+    if (GST_CLOCK_TIME_IS_VALID (io_sink->last_pts) && pts > io_sink->last_pts) delta = pts - io_sink->last_pts;
+  }
+  else if (io_sink->last_render > 0)
+  {
+    delta = (GstClockTime) (i_entered - io_sink->last_render) * GST_USECOND;
+  }
+  io_sink->last_pts    = pts;
+  io_sink->last_render = i_entered;
+
+  if (!GST_CLOCK_TIME_IS_VALID (delta)) return;
+
+  if (!GST_CLOCK_TIME_IS_VALID (io_sink->frame_interval))
+  {
+    io_sink->frame_interval = delta;
+  }
+  else
+  {
+    io_sink->frame_interval = io_sink->frame_interval - io_sink->frame_interval / 8 + delta / 8;
+  }
+
+  if (GST_PGM_HEARTBEAT_ADAPTIVE != io_sink->heartbeat_mode) return;
+  if ( GST_CLOCK_TIME_IS_VALID (io_sink->heartbeat_learned)
+     && ABS ((gint64) io_sink->frame_interval - (gint64) io_sink->heartbeat_learned) <= (gint64) io_sink->heartbeat_learned / 8
+     )
+  {
+    return;
+  }
+
+  gst_pgm_sink_learn_heartbeat (io_sink);
+}
+
+static void gst_pgm_sink_stream_init (GstPgmSinkStream* o_stream, guint16 i_id, gboolean i_tagged)
+{
+  o_stream->pad          = NULL;
+  o_stream->id           = i_id;
+  o_stream->tagged       = i_tagged;
+  o_stream->flushing     = FALSE;
+  o_stream->eos          = FALSE;
+  o_stream->queue_gap    = FALSE;
+  o_stream->caps_string  = NULL;
+  o_stream->caps_changed = FALSE;
+  o_stream->caps_next    = 0;
+  gst_pgm_deflate_init (&o_stream->deflate);
+  gst_segment_init (&o_stream->segment, GST_FORMAT_TIME);
+}
+
+/* native framing sends the caps of every stream in band */
+static void gst_pgm_sink_stream_set_caps (GstPgmSink* io_sink, GstPgmSinkStream* io_stream, const GstCaps* i_caps)
+{
+  gchar* caps_string = gst_caps_to_string (i_caps);
+  if (strlen (caps_string) > G_MAXUINT16)
+  {
+    GST_WARNING_OBJECT (io_sink, "caps too long for native framing, not sent");
+    g_free (caps_string);
+    caps_string = NULL;
+  }
+
+  g_mutex_lock (&io_sink->send_lock);
+  g_free (io_stream->caps_string);
+  io_stream->caps_string  = caps_string;
+  io_stream->caps_changed = TRUE;
+  g_mutex_unlock (&io_sink->send_lock);
+}
+
+/* GstBaseSinkClass::set_caps
  *
- * As a GStreamer source, create data, so recv on PGM transport.
+ * Native framing sends the caps in band. The framerate gives the
+ * heartbeat schedule of the adaptive mode from the next start.
  */
-static GstFlowReturn gst_pgm_sink_render (GstBaseSink* io_basesink, GstBuffer* i_buffer)
+static gboolean gst_pgm_sink_set_caps (GstBaseSink* io_basesink, GstCaps* i_caps)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_basesink);
+  const GstStructure* structure = gst_caps_get_structure (i_caps, 0);
+  gint num = 0;
+  gint den = 1;
+
+  gst_pgm_sink_stream_set_caps (sink, &sink->stream, i_caps);
+
+  sink->caps_framerate = gst_structure_get_fraction (structure, "framerate", &num, &den) && num > 0 && den > 0;
+  if (!sink->caps_framerate) return TRUE;
+
+  sink->frame_interval = gst_util_uint64_scale_int (GST_SECOND, den, num);
+
+  if (GST_PGM_HEARTBEAT_ADAPTIVE == sink->heartbeat_mode) gst_pgm_sink_learn_heartbeat (sink);
+  return TRUE;
+}
+
+/* Park the APDU a path could not finish: OpenPGM resumes an interrupted
+ * APDU on the next call with the same data, so its bytes are kept until
+ * then, whichever pad sends next. A path still finishing the one before
+ * never started this one, it goes without.
+ */
+static void gst_pgm_sink_park (GstPgmSink* io_sink, guint i_path, const struct pgm_iovec* i_vector, unsigned i_count)
+{
+  if (io_sink->pending[i_path])
+  {
+    GST_LOG_OBJECT (io_sink, "path %u still behind, APDU skipped on it", i_path);
+    return;
+  }
+
+  gsize size = 0;
+  for (unsigned i = 0; i < i_count; ++i) size += i_vector[i].iov_len;
+
+  guint8* data = g_malloc (size);
+  guint8* dst = data;
+  for (unsigned i = 0; i < i_count; ++i)
+  {
+    memcpy (dst, i_vector[i].iov_base, i_vector[i].iov_len);
+    dst += i_vector[i].iov_len;
+  }
+  io_sink->pending[i_path] = g_bytes_new_take (data, size);
+  io_sink->pending_head[i_path] = (i_count > 1) ? i_vector[0].iov_len : 0;
+}
+
+/* One try on a path without waiting, what it parked first. Returns
+ * PGM_IO_STATUS_NORMAL once OpenPGM took the APDU, else what it waits for,
+ * with *io_timeout lowered to when to try again.
+ */
+static int gst_pgm_sink_try_send (GstPgmSink* io_sink, guint i_path, const struct pgm_iovec* i_vector, unsigned i_count, int* io_timeout)
+{
+  GstPgmTransport* transports[] = { io_sink->transport, io_sink->redundant_transport, io_sink->droppable_transport };
+  GstPgmTransport* transport = transports[i_path];
+
+  for (;;)
+  {
+    const gboolean resume = io_sink->pending[i_path] != NULL;
+    struct pgm_iovec pending[2];
+    unsigned pending_count = 0;
+
+    /* same vector layout as before, OpenPGM keeps its place by index */
+    if (resume)
+    {
+      gsize size;
+      guint8* data = (guint8*) g_bytes_get_data (io_sink->pending[i_path], &size);
+      const gsize head = io_sink->pending_head[i_path];
+
+      if (head > 0)
+      {
+        pending[pending_count].iov_base = data;
+        pending[pending_count].iov_len  = head;
+        pending_count++;
+      }
+      pending[pending_count].iov_base = data + head;
+      pending[pending_count].iov_len  = size - head;
+      pending_count++;
+    }
+
+    size_t written = 0u;
+    const int status = pgm_sendv ( transport->sock
+                                 , resume ? pending : i_vector
+                                 , resume ? pending_count : i_count
+                                 , TRUE  // one APDU
+                                 , &written
+                                 );
+
+    if (PGM_IO_STATUS_NORMAL == status)
+    {
+      if (!resume) return status;
+      g_bytes_unref (io_sink->pending[i_path]);
+      io_sink->pending[i_path] = NULL;
+      continue;   // now the APDU we were given
+    }
+
+    /* rate limit: when the next packet may go; PGMCC tokens and send
+     * buffer: until OpenPGM's next timer, ACKs and NAKs wake poll earlier */
+    struct timeval tv;
+    socklen_t optlen = sizeof(tv);
+    const int remain = (PGM_IO_STATUS_RATE_LIMITED == status) ? PGM_RATE_REMAIN : PGM_TIME_REMAIN;
+    if (pgm_getsockopt (transport->sock, IPPROTO_PGM, remain, &tv, &optlen))
+    {
+      *io_timeout = MIN (*io_timeout, (int)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000));
+    }
+    return status;
+  }
+}
+
+/* Send one APDU on the given paths. Sockets never block, rate limits,
+ * missing PGMCC tokens and full buffers are waited out here so that unlock
+ * or a flush of the sending pad can interrupt. Paths go at their own pace:
+ * once one took the APDU, the others that cannot keep up finish it on
+ * their next send instead of holding the stream up, receivers fill in
+ * from the path that was on time.
+ */
+static GstFlowReturn gst_pgm_sink_send (GstPgmSink* io_sink, const guint* i_paths, guint i_n_paths, const struct pgm_iovec* i_vector, unsigned i_count, gint* i_flushing)
+{
+  GstPgmTransport* transports[] = { io_sink->transport, io_sink->redundant_transport, io_sink->droppable_transport };
+  gboolean waiting[G_N_ELEMENTS(transports)];
+  GstFlowReturn ret = GST_FLOW_ERROR;
+
+  for (guint i = 0; i < i_n_paths; ++i) waiting[i] = TRUE;
+
+  for (;;)
+  {
+    struct pollfd fds[PGM_SINK_MAX_POLL_FDS];
+    int n_fds = 0;
+    int timeout = PGM_SINK_SEND_POLL_MSECS;
+    gboolean congested = FALSE;
+    guint n_waiting = 0;
+
+    for (guint i = 0; i < i_n_paths; ++i)
+    {
+      if (!waiting[i]) continue;
+
+      const int status = gst_pgm_sink_try_send (io_sink, i_paths[i], i_vector, i_count, &timeout);
+      switch (status)
+      {
+      case PGM_IO_STATUS_NORMAL:
+        waiting[i] = FALSE;
+        ret = GST_FLOW_OK;
+        break;
+
+      case PGM_IO_STATUS_CONGESTION:
+        congested = TRUE;
+        /* fall through */
+      case PGM_IO_STATUS_RATE_LIMITED:
+      case PGM_IO_STATUS_WOULD_BLOCK:
+      {
+        int n = PGM_SINK_MAX_POLL_FDS - n_fds;
+        if (pgm_poll_info (transports[i_paths[i]]->sock, fds + n_fds, &n, POLLIN) >= 0) n_fds += n;
+        n_waiting++;
+        break;
+      }
+
+      default:
+        waiting[i] = FALSE;
+        GST_WARNING_OBJECT (io_sink, "send failed on path %u", i_paths[i]);
+      }
+    }
+
+    if (0 == n_waiting)
+    {
+      if (GST_FLOW_ERROR == ret) GST_ELEMENT_ERROR (io_sink, RESOURCE, WRITE, (NULL), ("send failed on every path"));
+      return ret;
+    }
+
+    /* send_quit is only set while the send thread is stopped */
+    if (GST_FLOW_OK == ret || g_atomic_int_get (i_flushing) || g_atomic_int_get (&io_sink->send_quit))
+    {
+      for (guint i = 0; i < i_n_paths; ++i)
+      {
+        if (waiting[i]) gst_pgm_sink_park (io_sink, i_paths[i], i_vector, i_count);
+      }
+      return (GST_FLOW_OK == ret) ? ret : GST_FLOW_FLUSHING;
+    }
+
+    const gint64 begin = g_get_monotonic_time ();
+    poll (fds, n_fds, timeout);
+
+    if (congested) io_sink->cc_blocked += g_get_monotonic_time () - begin;
+  }
+}
+
+/* Once per window, turn the time spent waiting for PGMCC tokens into the
+ * bitrate the network currently allows. Congested, that is what got
+ * through; otherwise probe upwards by an eighth per window, up to max-rate.
+ * Encoders follow the pgm-congestion message, elements upstream also get
+ * a QoS overflow event while congested.
+ */
+static void gst_pgm_sink_update_congestion (GstPgmSink* io_sink, GstPad* i_pad, const GstSegment* i_segment, GstBuffer* i_buffer)
+{
+  const gint64 now = g_get_monotonic_time ();
+
+  if (0 == io_sink->cc_window_start)
+  {
+    io_sink->cc_window_start = now;
+    io_sink->cc_bytes = 0;
+    io_sink->cc_blocked = 0;
+    return;
+  }
+
+  const gint64 elapsed = now - io_sink->cc_window_start;
+  if (elapsed < PGM_SINK_CC_WINDOW_MSECS * 1000) return;
+
+  const guint64 send_rate = gst_util_uint64_scale (io_sink->cc_bytes * 8, G_USEC_PER_SEC, elapsed);
+  const gboolean congested = io_sink->cc_blocked * 20 > elapsed;   // more than 5% waiting
+
+  if (congested)
+  {
+    io_sink->allowed_rate = send_rate;
+  }
+  else
+  {
+    io_sink->allowed_rate = MAX (send_rate, io_sink->allowed_rate + io_sink->allowed_rate / 8);
+    if (io_sink->max_rate > 0) io_sink->allowed_rate = MIN (io_sink->allowed_rate, io_sink->max_rate);
+  }
+
+  gst_element_post_message 
+    ( GST_ELEMENT_CAST (io_sink)
+    , gst_message_new_element 
+      ( GST_OBJECT_CAST (io_sink)
+      , gst_structure_new 
+        ( "pgm-congestion"
+        , "congested"      , G_TYPE_BOOLEAN, congested
+        , "send-bitrate"   , G_TYPE_UINT64 , send_rate
+        , "allowed-bitrate", G_TYPE_UINT64 , io_sink->allowed_rate
+        , "blocked"        , G_TYPE_UINT64 , (guint64) io_sink->cc_blocked * GST_USECOND
+        , NULL
+        )
+      )
+    );
+
+  if (congested)
+  {
+    const GstClockTime running_time = gst_segment_to_running_time (i_segment, GST_FORMAT_TIME, GST_BUFFER_PTS (i_buffer));
+    const gdouble proportion = (gdouble) elapsed / MAX (elapsed - io_sink->cc_blocked, 1);
+
+    gst_pad_push_event 
+      ( i_pad
+      , gst_event_new_qos (GST_QOS_TYPE_OVERFLOW, proportion, io_sink->cc_blocked * GST_USECOND, running_time)
+      );
+  }
+
+  io_sink->cc_window_start = now;
+  io_sink->cc_bytes = 0;
+  io_sink->cc_blocked = 0;
+}
+
+/* Set or clear the flushing flag of every request pad.
+ */
+static void gst_pgm_sink_flush_streams (GstPgmSink* io_sink, gboolean i_flushing)
+{
+  GST_OBJECT_LOCK (io_sink);
+  for (GList* l = io_sink->streams; l; l = l->next)
+  {
+    GstPgmSinkStream* stream = l->data;
+
+    g_atomic_int_set (&stream->flushing, i_flushing);
+    if (i_flushing && io_sink->send_thread) gst_pgm_sink_queue_flush (io_sink, stream, FALSE);
+  }
+  GST_OBJECT_UNLOCK (io_sink);
+}
+
+/* The always pad is deactivated first when going to READY, a send waiting
+ * on a request pad has to let go of the send lock before theirs are. A
+ * flush of the always pad leaves them alone, they have their own.
+ */
+static gboolean gst_pgm_sink_unlock (GstBaseSink* io_basesink)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_basesink);
+
+  g_atomic_int_set (&sink->stream.flushing, TRUE);
+  if (sink->send_thread) gst_pgm_sink_queue_flush (sink, &sink->stream, FALSE);
+
+  const GstState next = GST_STATE_NEXT (sink);
+  if (GST_STATE_VOID_PENDING != next && next <= GST_STATE_READY) gst_pgm_sink_flush_streams (sink, TRUE);
+  return TRUE;
+}
+
+static gboolean gst_pgm_sink_unlock_stop (GstBaseSink* io_basesink)
 {
   GstPgmSink* sink = GST_PGM_SINK (io_basesink);
 
+  g_atomic_int_set (&sink->stream.flushing, FALSE);
+  return TRUE;
+}
+
+/* Upstream fills buffers in memory local to the interface they are sent
+ * from, OpenPGM copies them into its transmit window from there.
+ */
+static gboolean gst_pgm_sink_add_allocator (GstPgmSink* io_sink, GstQuery* io_query)
+{
+  if (NULL == io_sink->allocator) return TRUE;
+
+  GstAllocationParams params;
+  gst_allocation_params_init (&params);
+  gst_query_add_allocation_param (io_query, io_sink->allocator, &params);
+  return TRUE;
+}
+
+static gboolean gst_pgm_sink_propose_allocation (GstBaseSink* io_basesink, GstQuery* io_query)
+{
+  return gst_pgm_sink_add_allocator (GST_PGM_SINK (io_basesink), io_query);
+}
+
+/* Native framing: running time rather than stream time, the receiver has
+ * no segment to convert with. Caps go along whenever they change and every
+ * PGM_SINK_CAPS_MSECS for receivers that join late, the pipeline clock
+ * every clock-interval for receivers that slave to it.
+ */
+static void gst_pgm_sink_native_fields (GstPgmSink* io_sink, GstPgmSinkStream* io_stream, const GstSegment* i_segment, GstBuffer* i_buffer, GstPgmFrameHeader* io_frame)
+{
+  if (io_stream->tagged)
+  {
+    io_frame->stream_id = io_stream->id;
+    io_frame->flags |= GST_PGM_FRAME_FLAG_STREAM;
+  }
+
+  if (GST_BUFFER_PTS_IS_VALID (i_buffer))
+  {
+    io_frame->pts = gst_segment_to_running_time (i_segment, GST_FORMAT_TIME, GST_BUFFER_PTS (i_buffer));
+    if (GST_CLOCK_TIME_IS_VALID (io_frame->pts)) io_frame->flags |= GST_PGM_FRAME_FLAG_PTS;
+  }
+  if (GST_BUFFER_DTS_IS_VALID (i_buffer))
+  {
+    io_frame->dts = gst_segment_to_running_time (i_segment, GST_FORMAT_TIME, GST_BUFFER_DTS (i_buffer));
+    if (GST_CLOCK_TIME_IS_VALID (io_frame->dts)) io_frame->flags |= GST_PGM_FRAME_FLAG_DTS;
+  }
+  if (GST_BUFFER_DURATION_IS_VALID (i_buffer))
+  {
+    io_frame->duration = GST_BUFFER_DURATION (i_buffer);
+    io_frame->flags |= GST_PGM_FRAME_FLAG_DURATION;
+  }
+
+  io_frame->buffer_flags = GST_BUFFER_FLAGS (i_buffer) & GST_PGM_FRAME_BUFFER_FLAGS;
+  if (io_frame->buffer_flags) io_frame->flags |= GST_PGM_FRAME_FLAG_BUFFER_FLAGS;
+
+  const gint64 now = g_get_monotonic_time ();
+  if (io_stream->caps_string && (io_stream->caps_changed || now >= io_stream->caps_next))
+  {
+    io_frame->caps     = io_stream->caps_string;
+    io_frame->caps_len = strlen (io_stream->caps_string);
+    io_frame->flags   |= GST_PGM_FRAME_FLAG_CAPS;
+
+    io_stream->caps_changed = FALSE;
+    io_stream->caps_next    = now + PGM_SINK_CAPS_MSECS * 1000;
+  }
+
+  if (io_sink->clock_interval > 0 && now >= io_sink->clock_next)
+  {
+    GstClock* clock = gst_element_get_clock (GST_ELEMENT_CAST (io_sink));
+    if (clock)
+    {
+      io_frame->clock_time = gst_clock_get_time (clock);
+      io_frame->base_time  = gst_element_get_base_time (GST_ELEMENT_CAST (io_sink));
+      io_frame->flags     |= GST_PGM_FRAME_FLAG_CLOCK;
+      gst_object_unref (clock);
+    }
+    io_sink->clock_next = now + (gint64) io_sink->clock_interval * 1000;
+  }
+}
+
+/* With keys, the APDU in io_vector is replaced by its sealed copy in
+ * io_sink->sealed, encrypted on the way from the buffer.
+ */
+static gboolean gst_pgm_sink_seal (GstPgmSink* io_sink, struct pgm_iovec* io_vector, unsigned* io_count)
+{
+  GST_OBJECT_LOCK (io_sink);
+  const gboolean encrypt = NULL != io_sink->keys;
+  GstPgmCrypto* crypto = io_sink->crypto ? gst_pgm_crypto_ref (io_sink->crypto) : NULL;
+  const guint32 epoch = io_sink->key_epoch;
+  GST_OBJECT_UNLOCK (io_sink);
+
+  if (!encrypt) return TRUE;
+
+  gsize size = GST_PGM_CRYPTO_OVERHEAD;
+  for (unsigned i = 0; i < *io_count; ++i) size += io_vector[i].iov_len;
+  g_byte_array_set_size (io_sink->sealed, size);
+
+  const gboolean ok = crypto && gst_pgm_crypto_seal (crypto, epoch, io_vector, *io_count, io_sink->sealed->data);
+  gst_pgm_crypto_unref (crypto);
+
+  if (!ok)
+  {
+    GST_ELEMENT_ERROR (io_sink, RESOURCE, SETTINGS, (NULL), ("cannot encrypt, no valid key for epoch %u", epoch));
+    return FALSE;
+  }
+
+  io_vector[0].iov_base = io_sink->sealed->data;
+  io_vector[0].iov_len  = size;
+  *io_count = 1;
+  return TRUE;
+}
+
+/* Frame one buffer and send it as an APDU on every path. Pads stream from
+ * their own threads, the APDUs of one session go out one at a time.
+ * i_flushing interrupts a send that has to wait.
+ */
+static GstFlowReturn gst_pgm_sink_send_buffer (GstPgmSink* io_sink, GstPgmSinkStream* io_stream, GstPad* i_pad, const GstSegment* i_segment, GstBuffer* i_buffer, gint64 i_entered, gint* i_flushing)
+{
+  guint8 fixed[GST_PGM_FRAME_HEADER_SIZE + 3 * 8 + 4 + 16 + 2 + 4 + 8 + 12];
+  guint8* header = fixed;
+  struct pgm_iovec vector[2];
+  unsigned count = 0;
+
+  g_mutex_lock (&io_sink->send_lock);
+
+  /* droppable buffers go unrepaired through the sibling session, they
+   * tell after which reliable one they belong */
+  const gboolean droppable = io_sink->droppable_transport && GST_BUFFER_FLAG_IS_SET (i_buffer, GST_BUFFER_FLAG_DROPPABLE);
+
   GstMapInfo map;
   gst_buffer_map (i_buffer, &map, (GstMapFlags)GST_MAP_READ);
-  size_t written = 0u;
-  const int status = pgm_send ( sink->sock
-                              , map.data
-                              , map.size
-                              , &written
-                              );
+  gpointer payload = map.data;
+  gsize payload_size = map.size;
+
+  if (GST_PGM_FRAMING_RAW != io_sink->framing)
+  {
+    GstPgmFrameHeader frame = { 0, io_sink->sequence++ };
+    if (GST_PGM_FRAMING_NATIVE == io_sink->framing) gst_pgm_sink_native_fields (io_sink, io_stream, i_segment, i_buffer, &frame);
+
+    if (droppable)
+    {
+      frame.anchor = io_sink->anchor;
+      frame.flags |= GST_PGM_FRAME_FLAG_ANCHOR;
+    }
+    else
+    {
+      io_sink->anchor = frame.sequence;
+    }
+
+    /* the header tells how to get the payload back */
+    if (GST_PGM_COMPRESSION_NONE != io_sink->compression
+        && gst_pgm_deflate (&io_stream->deflate, map.data, map.size, !droppable, io_sink->dictionary_interval, io_sink->deflated, &frame))
+    {
+      payload      = io_sink->deflated->data;
+      payload_size = io_sink->deflated->len;
+    }
+
+    /* what waited for the lock, the send thread or the compressor counts
+     * as the sender's queue, the rate limiter as the wire */
+    if (g_atomic_int_get (&io_sink->send_stamps))
+    {
+      const gint64 waited = g_get_monotonic_time () - i_entered;
+      frame.sent         = g_get_real_time () * GST_USECOND;
+      frame.sender_queue = (guint32) CLAMP (waited, 0, G_MAXUINT32);
+      frame.flags       |= GST_PGM_FRAME_FLAG_SENT;
+    }
+
+    const gsize size = gst_pgm_frame_header_size (&frame);
+    if (size > sizeof(fixed)) header = g_malloc (size);
+
+    vector[count].iov_base = header;
+    vector[count].iov_len  = gst_pgm_frame_write_header (header, &frame);
+    ++count;
+  }
+
+  vector[count].iov_base = payload;
+  vector[count].iov_len  = payload_size;
+  ++count;
+
+  if (!gst_pgm_sink_seal (io_sink, vector, &count))
+  {
+    gst_buffer_unmap (i_buffer, &map);
+    if (header != fixed) g_free (header);
+    g_mutex_unlock (&io_sink->send_lock);
+    return GST_FLOW_ERROR;
+  }
+
+  /* local receivers get it once, whatever the paths */
+  if (io_sink->shm && gst_pgm_shm_has_readers (io_sink->shm))
+  {
+    if (!gst_pgm_shm_publish (io_sink->shm, droppable ? GST_PGM_SINK_DROPPABLE_PATH : 0, vector, count))
+    {
+      GST_WARNING_OBJECT (io_sink, "APDU of %" G_GSIZE_FORMAT " bytes too large for shm-size", map.size);
+    }
+  }
+
+  /* reliable APDUs go identical on the primary and redundant path, the
+   * stream survives as long as one of them takes it; droppable ones only
+   * on the droppable session */
+  guint paths[2];
+  guint n_paths = 0;
+
+  if (droppable)
+  {
+    paths[n_paths++] = GST_PGM_SINK_DROPPABLE_PATH;
+  }
+  else
+  {
+    paths[n_paths++] = 0;
+    if (io_sink->redundant_transport) paths[n_paths++] = 1;
+  }
+
+  const GstFlowReturn ret = gst_pgm_sink_send (io_sink, paths, n_paths, vector, count, i_flushing);
   gst_buffer_unmap (i_buffer, &map);                                      
+  if (header != fixed) g_free (header);
+
+  if (GST_FLOW_OK == ret)
+  {
+    if (GST_PGM_CONGESTION_CONTROL_NONE != io_sink->congestion_control)
+    {
+      io_sink->cc_bytes += payload_size;
+      gst_pgm_sink_update_congestion (io_sink, i_pad, i_segment, i_buffer);
+    }
+  }
+
+  g_mutex_unlock (&io_sink->send_lock);
+  return ret;
+}
+
+/* a buffer waiting for the send thread, with what it is framed by */
+typedef struct
+{
+  GstPgmSinkStream* stream;
+  GstPad*           pad;
+  GstSegment        segment;
+  GstBuffer*        buffer;
+  gint64            queued;     // monotonic, microseconds
+} GstPgmSinkQueued;
+
+static void gst_pgm_sink_queued_free (gpointer io_queued)
+{
+  GstPgmSinkQueued* queued = io_queued;
+
+  gst_buffer_unref (queued->buffer);
+  g_free (queued);
+}
+
+/* The deltas of a stream that lost a buffer cannot be decoded before its
+ * next key unit: drop those queued from l on, and those still to come if
+ * the key unit is not queued yet. Called with queue_lock.
+ */
+static void gst_pgm_sink_queue_skip_deltas (GstPgmSink* io_sink, GstPgmSinkStream* io_stream, GList* l)
+{
+  while (l)
+  {
+    GstPgmSinkQueued* queued = l->data;
+    GList* next = l->next;
 
-  if (PGM_IO_STATUS_NORMAL != status) return GST_FLOW_ERROR;
+    if (queued->stream == io_stream)
+    {
+      if (!GST_BUFFER_FLAG_IS_SET (queued->buffer, GST_BUFFER_FLAG_DELTA_UNIT)) return;
+
+      g_queue_delete_link (&io_sink->queue, l);
+      gst_pgm_sink_queued_free (queued);
+      io_sink->dropped_old++;
+    }
+    l = next;
+  }
+  io_stream->queue_gap = TRUE;
+}
+
+/* Drop-oldest: what waited longer than max-queue-time goes, oldest first,
+ * unless a decoder could start from it. Key units only go once they have
+ * waited twice as long, so that streams of nothing but key units stay
+ * bounded too. The deltas following what went go with it. Called with
+ * queue_lock.
+ */
+static void gst_pgm_sink_queue_trim (GstPgmSink* io_sink, gint64 i_now)
+{
+  const gint64 bound = (gint64) io_sink->max_queue_time * 1000;
+
+  for (GList* l = io_sink->queue.head; l; )
+  {
+    GstPgmSinkQueued* queued = l->data;
+    GList* next = l->next;
+
+    if (i_now - queued->queued < bound) break;   // the rest is younger
+
+    if ( GST_BUFFER_FLAG_IS_SET (queued->buffer, GST_BUFFER_FLAG_DELTA_UNIT)
+       || i_now - queued->queued >= 2 * bound
+       )
+    {
+      GstPgmSinkStream* stream = queued->stream;
+      GList* after = l->next;
+
+      /* next must survive the deltas skipped below */
+      while ( next
+            && ((GstPgmSinkQueued*) next->data)->stream == stream
+            && GST_BUFFER_FLAG_IS_SET (((GstPgmSinkQueued*) next->data)->buffer, GST_BUFFER_FLAG_DELTA_UNIT)
+            )
+      {
+        next = next->next;
+      }
+
+      g_queue_delete_link (&io_sink->queue, l);
+      gst_pgm_sink_queued_free (queued);
+      io_sink->dropped_old++;
+      gst_pgm_sink_queue_skip_deltas (io_sink, stream, after);
+    }
+    l = next;
+  }
+}
 
+/* Leaky: hand a buffer to the send thread rather than wait for the
+ * transport, and drop instead when the queue is over max-queue-time.
+ */
+static GstFlowReturn gst_pgm_sink_queue_buffer (GstPgmSink* io_sink, GstPgmSinkStream* io_stream, GstPad* i_pad, const GstSegment* i_segment, GstBuffer* i_buffer)
+{
+  const gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&io_sink->queue_lock);
+
+  if (GST_FLOW_OK != io_sink->queue_ret)
+  {
+    const GstFlowReturn ret = io_sink->queue_ret;
+    g_mutex_unlock (&io_sink->queue_lock);
+    return ret;   // the send thread posted the error
+  }
+
+  if (GST_PGM_LEAKY_DROP_NEW == io_sink->leaky)
+  {
+    GstPgmSinkQueued* oldest = g_queue_peek_head (&io_sink->queue);
+    if (oldest && now - oldest->queued >= (gint64) io_sink->max_queue_time * 1000)
+    {
+      io_sink->dropped_new++;
+      g_mutex_unlock (&io_sink->queue_lock);
+      return GST_FLOW_OK;
+    }
+  }
+  else
+  {
+    gst_pgm_sink_queue_trim (io_sink, now);
+  }
+
+  if (io_stream->queue_gap)
+  {
+    if (GST_BUFFER_FLAG_IS_SET (i_buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+    {
+      io_sink->dropped_old++;
+      g_mutex_unlock (&io_sink->queue_lock);
+      return GST_FLOW_OK;
+    }
+    io_stream->queue_gap = FALSE;
+  }
+
+  GstPgmSinkQueued* queued = g_new (GstPgmSinkQueued, 1);
+  queued->stream  = io_stream;
+  queued->pad     = i_pad;
+  queued->segment = *i_segment;
+  queued->buffer  = gst_buffer_ref (i_buffer);
+  queued->queued  = now;
+  g_queue_push_tail (&io_sink->queue, queued);
+
+  g_cond_signal (&io_sink->queue_cond);
+  g_mutex_unlock (&io_sink->queue_lock);
   return GST_FLOW_OK;
 }
 
-/* create PGM transport 
+/* forget what a stream has queued, after a flush, or before its pad goes
+ * when i_wait also for the buffer being sent
  */
-static gboolean gst_pgm_client_sink_start (GstBaseSink* basesink)
+static void gst_pgm_sink_queue_flush (GstPgmSink* io_sink, GstPgmSinkStream* i_stream, gboolean i_wait)
 {
-  GstPgmSink* sink = GST_PGM_SINK (basesink);
+  g_mutex_lock (&io_sink->queue_lock);
+  for (GList* l = io_sink->queue.head; l; )
+  {
+    GList* next = l->next;
+    GstPgmSinkQueued* queued = l->data;
 
-  const int valTrue  = 1;
-  const int valFalse = 0;
+    if (queued->stream == i_stream)
+    {
+      g_queue_delete_link (&io_sink->queue, l);
+      gst_pgm_sink_queued_free (queued);
+    }
+    l = next;
+  }
 
-	sa_family_t sa_family = AF_UNSPEC;
+  i_stream->queue_gap = FALSE;
 
-  struct pgm_addrinfo_t* res = NULL;
-  pgm_error_t* pErr = NULL;
-  GError* gErr = NULL;
+  while (i_wait && io_sink->queue_sending == i_stream) g_cond_wait (&io_sink->queue_cond, &io_sink->queue_lock);
+  g_mutex_unlock (&io_sink->queue_lock);
+}
 
-	if (!pgm_init (&pErr)) {
-		g_error ("Unable to start PGM engine: %s", pErr->message);
-		pgm_error_free (pErr);
-		goto destroy_transport;
-	}
-  if (!pgm_getaddrinfo (sink->network, NULL, &res, &pErr)) 
+/* Leaky: send what render and the request pads queued. Stopping or a
+ * flush of the pad a buffer came from interrupts its send, the queue
+ * absorbs the wait otherwise.
+ */
+static gpointer gst_pgm_sink_send_thread (gpointer io_sink)
+{
+  GstPgmSink* sink = (GstPgmSink*) io_sink;
+
+  g_mutex_lock (&sink->queue_lock);
+  for (;;)
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Parsing network parameter: %s", pErr->message));
-    pgm_error_free (pErr);
-    return FALSE;
+    while (g_queue_is_empty (&sink->queue) && !sink->send_quit) g_cond_wait (&sink->queue_cond, &sink->queue_lock);
+    if (sink->send_quit) break;
+
+    GstPgmSinkQueued* queued = g_queue_pop_head (&sink->queue);
+    sink->queue_sending = queued->stream;
+    g_mutex_unlock (&sink->queue_lock);
+
+    const GstFlowReturn ret = gst_pgm_sink_send_buffer (sink, queued->stream, queued->pad, &queued->segment, queued->buffer, queued->queued, &queued->stream->flushing);
+    gst_pgm_sink_queued_free (queued);
+
+    g_mutex_lock (&sink->queue_lock);
+    if (GST_FLOW_ERROR == ret) sink->queue_ret = ret;
+    sink->queue_sending = NULL;
+    g_cond_broadcast (&sink->queue_cond);
+  }
+  g_mutex_unlock (&sink->queue_lock);
+
+  return NULL;
+}
+
+static void gst_pgm_sink_stop_send_thread (GstPgmSink* io_sink)
+{
+  if (NULL == io_sink->send_thread) return;
+
+  g_mutex_lock (&io_sink->queue_lock);
+  g_atomic_int_set (&io_sink->send_quit, TRUE);
+  g_cond_broadcast (&io_sink->queue_cond);
+  g_mutex_unlock (&io_sink->queue_lock);
+
+  g_thread_join (io_sink->send_thread);
+  io_sink->send_thread = NULL;
+  g_atomic_int_set (&io_sink->send_quit, FALSE);
+
+  g_queue_clear_full (&io_sink->queue, gst_pgm_sink_queued_free);
+}
+
+/* GstBaseSinkClass::render
+ *
+ * As a GStreamer source, create data, so recv on PGM transport.
+ */
+static GstFlowReturn gst_pgm_sink_render (GstBaseSink* io_basesink, GstBuffer* i_buffer)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_basesink);
+  const gint64 entered = g_get_monotonic_time ();
+
+  if (!sink->caps_framerate) gst_pgm_sink_observe_interval (sink, i_buffer, entered);
+
+  if (sink->send_thread) return gst_pgm_sink_queue_buffer (sink, &sink->stream, GST_BASE_SINK_PAD (sink), &io_basesink->segment, i_buffer);
+  return gst_pgm_sink_send_buffer (sink, &sink->stream, GST_BASE_SINK_PAD (sink), &io_basesink->segment, i_buffer, entered, &sink->stream.flushing);
+}
+
+/* queries of a request pad, allocation as on the always pad
+ */
+static gboolean gst_pgm_sink_stream_query (GstPad* i_pad, GstObject* io_parent, GstQuery* io_query)
+{
+  if (GST_QUERY_ALLOCATION == GST_QUERY_TYPE (io_query)) return gst_pgm_sink_add_allocator (GST_PGM_SINK (io_parent), io_query);
+  return gst_pad_query_default (i_pad, io_parent, io_query);
+}
+
+/* chain of a request pad, not synchronised to the clock
+ */
+static GstFlowReturn gst_pgm_sink_stream_chain (GstPad* i_pad, GstObject* io_parent, GstBuffer* i_buffer)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_parent);
+  GstPgmSinkStream* stream = (GstPgmSinkStream*) gst_pad_get_element_private (i_pad);
+  GstFlowReturn ret = GST_FLOW_FLUSHING;
+  const gint64 entered = g_get_monotonic_time ();
+
+  /* the always pad may rebuild the transport from set_caps */
+  g_mutex_lock (&sink->send_lock);
+  const gboolean open = sink->transport != NULL;
+  g_mutex_unlock (&sink->send_lock);
+
+  if (open && !g_atomic_int_get (&stream->flushing))
+  {
+    ret = sink->send_thread
+        ? gst_pgm_sink_queue_buffer (sink, stream, i_pad, &stream->segment, i_buffer)
+        : gst_pgm_sink_send_buffer (sink, stream, i_pad, &stream->segment, i_buffer, entered, &stream->flushing);
   }
 
-	sa_family = res->ai_send_addrs[0].gsr_group.ss_family;
+  gst_buffer_unref (i_buffer);
+  return ret;
+}
+
+/* once every stream ended, the element has too if the always pad is not
+ * in use: the always pad gets the EOS so that basesink posts it
+ */
+static void gst_pgm_sink_check_eos (GstPgmSink* io_sink)
+{
+  GstPad* pad = GST_BASE_SINK_PAD (io_sink);
+  gboolean all = TRUE;
 
-  if (!pgm_socket (&sink->sock, sa_family, SOCK_SEQPACKET, IPPROTO_UDP, &pErr)) 
+  GST_OBJECT_LOCK (io_sink);
+  for (GList* l = io_sink->streams; l; l = l->next)
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Creating transport: %s", pErr->message));
-    pgm_freeaddrinfo (res);
-    return FALSE;
+    all = all && ((GstPgmSinkStream*) l->data)->eos;
+  }
+  GST_OBJECT_UNLOCK (io_sink);
+
+  if (!all || gst_pad_is_linked (pad)) return;
+
+  GstEvent* stream_start = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (stream_start == NULL)
+  {
+    gchar* stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT_CAST (io_sink), NULL);
+    gst_pad_send_event (pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+  }
+  else
+  {
+    gst_event_unref (stream_start);
+  }
+  gst_pad_send_event (pad, gst_event_new_eos ());
+}
+
+static gboolean gst_pgm_sink_stream_event (GstPad* i_pad, GstObject* io_parent, GstEvent* i_event)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_parent);
+  GstPgmSinkStream* stream = (GstPgmSinkStream*) gst_pad_get_element_private (i_pad);
+
+  switch (GST_EVENT_TYPE (i_event))
+  {
+  case GST_EVENT_CAPS:
+  {
+    GstCaps* caps;
+    gst_event_parse_caps (i_event, &caps);
+    gst_pgm_sink_stream_set_caps (sink, stream, caps);
+    break;
+  }
+  case GST_EVENT_SEGMENT:
+    gst_event_copy_segment (i_event, &stream->segment);
+    break;
+
+  case GST_EVENT_FLUSH_START:
+    g_atomic_int_set (&stream->flushing, TRUE);
+    if (sink->send_thread) gst_pgm_sink_queue_flush (sink, stream, FALSE);
+    break;
+
+  case GST_EVENT_FLUSH_STOP:
+    gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+    stream->eos = FALSE;
+    g_atomic_int_set (&stream->flushing, FALSE);
+    break;
+
+  case GST_EVENT_EOS:
+    stream->eos = TRUE;
+    gst_pgm_sink_check_eos (sink);
+    break;
+
+  default:
+    break;
+  }
+
+  gst_event_unref (i_event);
+  return TRUE;
+}
+
+/* GstElementClass::request_new_pad, sink_%u sends its buffers tagged with
+ * stream id %u
+ */
+static GstPad* gst_pgm_sink_request_new_pad (GstElement* io_element, GstPadTemplate* i_templ, const gchar* i_name, const GstCaps* i_caps)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_element);
+  guint id = 0;
+
+  /* the framing of a sink already sending is what receivers expect */
+  g_mutex_lock (&sink->send_lock);
+  const gboolean refuse = GST_PGM_FRAMING_NATIVE != sink->framing && (sink->framing_set || GST_STATE (sink) > GST_STATE_READY);
+  g_mutex_unlock (&sink->send_lock);
+  if (refuse)
+  {
+    GST_WARNING_OBJECT (sink, "streams need native framing, framing is set otherwise");
+    return NULL;
   }
 
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_IP_ROUTER_ALERT, &valFalse, sizeof(valFalse))) 
+  GST_OBJECT_LOCK (sink);
+  if (i_name && 1 == sscanf (i_name, "sink_%u", &id))
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot unset the router assist"));
-    goto destroy_transport;
+    for (GList* l = sink->streams; l; l = l->next)
+    {
+      if (((GstPgmSinkStream*) l->data)->id == id) 
+      {
+        GST_OBJECT_UNLOCK (sink);
+        GST_WARNING_OBJECT (sink, "stream %u already has a pad", id);
+        return NULL;
+      }
+    }
+  }
+  else
+  {
+    for (GList* l = sink->streams; l; l = l->next)
+    {
+      id = MAX (id, (guint)((GstPgmSinkStream*) l->data)->id + 1);
+    }
+  }
+  if (id > G_MAXUINT16)
+  {
+    GST_OBJECT_UNLOCK (sink);
+    return NULL;
   }
 
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_SEND_ONLY, &valTrue, sizeof(valTrue))) 
+  GstPgmSinkStream* stream = g_new (GstPgmSinkStream, 1);
+  gst_pgm_sink_stream_init (stream, id, TRUE);
+  sink->streams = g_list_append (sink->streams, stream);
+  GST_OBJECT_UNLOCK (sink);
+
+  g_mutex_lock (&sink->send_lock);
+  if (GST_PGM_FRAMING_NATIVE != sink->framing)
+  {
+    GST_WARNING_OBJECT (sink, "streams need native framing, using native framing");
+    sink->framing = GST_PGM_FRAMING_NATIVE;
+  }
+  g_mutex_unlock (&sink->send_lock);
+
+  gchar* name = g_strdup_printf ("sink_%u", id);
+  stream->pad = gst_pad_new_from_template (i_templ, name);
+  g_free (name);
+
+  gst_pad_set_element_private (stream->pad, stream);
+  gst_pad_set_chain_function (stream->pad, GST_DEBUG_FUNCPTR(gst_pgm_sink_stream_chain));
+  gst_pad_set_event_function (stream->pad, GST_DEBUG_FUNCPTR(gst_pgm_sink_stream_event));
+  gst_pad_set_query_function (stream->pad, GST_DEBUG_FUNCPTR(gst_pgm_sink_stream_query));
+
+  if (GST_STATE (sink) > GST_STATE_READY) gst_pad_set_active (stream->pad, TRUE);
+  gst_element_add_pad (io_element, stream->pad);
+
+  return stream->pad;
+}
+
+static void gst_pgm_sink_release_pad (GstElement* io_element, GstPad* io_pad)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_element);
+  GstPgmSinkStream* stream = (GstPgmSinkStream*) gst_pad_get_element_private (io_pad);
+
+  GST_OBJECT_LOCK (sink);
+  sink->streams = g_list_remove (sink->streams, stream);
+  GST_OBJECT_UNLOCK (sink);
+
+  gst_element_remove_pad (io_element, io_pad);
+
+  /* no send of this stream can be under way any more */
+  g_atomic_int_set (&stream->flushing, TRUE);
+  gst_pgm_sink_queue_flush (sink, stream, TRUE);
+  g_mutex_lock (&sink->send_lock);
+  g_mutex_unlock (&sink->send_lock);
+
+  g_free (stream->caps_string);
+  gst_pgm_deflate_clear (&stream->deflate);
+  g_free (stream);
+}
+
+/* sender side socket options, GstPgmTransportConfigure
+ */
+static gboolean gst_pgm_sink_configure (GstElement* element, struct pgm_sock_t* sock, gpointer droppable)
+{
+  GstPgmSink* sink = GST_PGM_SINK (element);
+
+  /* receivers of the droppable session are passive, nobody would ACK */
+  const gint congestion_control = droppable ? GST_PGM_CONGESTION_CONTROL_NONE : sink->congestion_control;
+
+  const int valTrue  = 1;
+  const int valFalse = 0;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_SEND_ONLY, &valTrue, sizeof(valTrue))) 
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set send-only mode"));
-    goto destroy_transport;
+    return FALSE;
   }
 
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_MTU, &sink->max_tpdu, sizeof(sink->max_tpdu))) 
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MTU, &sink->max_tpdu, sizeof(sink->max_tpdu))) 
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set maximum TPDU size"));
-    goto destroy_transport;
+    return FALSE;
   }
   
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_MULTICAST_LOOP, &valTrue, sizeof(valTrue)))
+  /* receivers on this host read the shared memory ring instead */
+  const int loop = sink->shm ? valFalse : valTrue;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_LOOP, &loop, sizeof(loop)))
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set multicast loop"));
-    goto destroy_transport;
+    return FALSE;
   }
   
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &sink->hops, sizeof(sink->hops))) 
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &sink->hops, sizeof(sink->hops))) 
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set IP hop limit"));
-    goto destroy_transport;
+    return FALSE;
   }
   
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_TXW_SQNS, &sink->txw_sqns, sizeof(sink->txw_sqns))) 
+  if (!gst_pgm_transport_set_window ( element
+                                    , sock
+                                    , TRUE
+                                    , sink->txw_sqns
+                                    , sink->txw_secs
+                                    , sink->max_rate
+                                    , sink->window_budget
+                                    , sink->max_tpdu
+                                    )
+     )
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set TXW_SQNS"));
-    goto destroy_transport;
+    return FALSE;
   }
   
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_AMBIENT_SPM, &sink->spm_ambient, sizeof(sink->spm_ambient))) 
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_AMBIENT_SPM, &sink->spm_ambient, sizeof(sink->spm_ambient))) 
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set SPM ambient interval"));
-    goto destroy_transport;
+    return FALSE;
   }
 
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_UDP_ENCAP_UCAST_PORT, &sink->udp_encap_port, sizeof(sink->udp_encap_port)))
-  {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set UDP encap ucast port"));
-    goto destroy_transport;
-  }
-  
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_UDP_ENCAP_MCAST_PORT, &sink->udp_encap_port, sizeof(sink->udp_encap_port)))
-  {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set UDP encap mcast port"));
-    goto destroy_transport;
-  }
+  /* PGMCC may hold a send back indefinitely and one path must not stall
+   * the others, wait in render instead */
+  const int noblock = 1;
 
-  if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_NOBLOCK, &valFalse, sizeof(valFalse)))
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NOBLOCK, &noblock, sizeof(noblock)))
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot unset no-block"));
-    goto destroy_transport;
+    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set no-block"));
+    return FALSE;
   }
 
+  if (!gst_pgm_transport_set_congestion_control (element, sock, congestion_control)) return FALSE;
+
   {
-    const int heartbeat_spm[] = { pgm_msecs (100)
-                                , pgm_msecs (100)
-                                , pgm_msecs (100)
-                                , pgm_msecs (100)
-                                , pgm_msecs (1300)
-                                , pgm_secs  (7)
-                                , pgm_secs  (16)
-                                , pgm_secs  (25)
-                                , pgm_secs  (30)
-                                };
+    GstClockTime shaped;
+    GArray* heartbeat_spm = gst_pgm_sink_heartbeat_schedule (sink, &shaped);
+    const gboolean ok = pgm_setsockopt (sock, IPPROTO_PGM, PGM_HEARTBEAT_SPM, heartbeat_spm->data, heartbeat_spm->len * sizeof(int));
+    g_array_free (heartbeat_spm, TRUE);
 
-    if (!pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_HEARTBEAT_SPM, &heartbeat_spm, sizeof(heartbeat_spm))) 
+    if (!ok) 
     {
       GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("cannot set SPM heartbeat intervals"));
-      goto destroy_transport;
+      return FALSE;
     }
+    sink->heartbeat_interval = sink->heartbeat_learned = shaped;
   }
 
-  struct pgm_sockaddr_t addr;
-  memset (&addr, '\0', sizeof(addr));
-  addr.sa_port = sink->port;
-  addr.sa_addr.sport = DEFAULT_DATA_SOURCE_PORT;
+  return TRUE;
+}
 
-  if (!pgm_gsi_create_from_hostname (&addr.sa_addr.gsi, &pErr))
+/* create PGM transports, one per path, and the thread servicing them
+ */
+static gboolean gst_pgm_sink_open (GstPgmSink* sink)
+{
+  pgm_error_t* pErr = NULL;
+
+	if (!pgm_init (&pErr)) {
+		g_error ("Unable to start PGM engine: %s", pErr->message);
+		pgm_error_free (pErr);
+		return FALSE;
+	}
+
+  /* a framing set by the user stays, what needs a header goes without */
+  const gchar* needs_header = NULL;
+  if (GST_PGM_COMPRESSION_NONE != sink->compression) needs_header = "compression";
+  if (sink->droppable_port)    needs_header = "droppable session";
+  if (sink->redundant_network) needs_header = "redundant path";
+
+  if (needs_header && GST_PGM_FRAMING_RAW == sink->framing)
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Creating GSI: %s", pErr->message));
-    pgm_error_free (pErr);
-    pgm_freeaddrinfo (res);
-    return FALSE;
+    if (sink->framing_set)
+    {
+      GST_WARNING_OBJECT (sink, "%s needs a frame header, framing is set to raw: receivers cannot merge paths or tiers, nothing is compressed", needs_header);
+    }
+    else
+    {
+      GST_WARNING_OBJECT (sink, "%s needs a frame header, using sequenced framing", needs_header);
+      sink->framing = GST_PGM_FRAMING_SEQUENCED;
+    }
   }
 
-  struct pgm_interface_req_t ifReq;
-  memset (&ifReq, '\0', sizeof(ifReq));
-  ifReq.ir_interface = res->ai_recv_addrs[0].gsr_interface;
-  ifReq.ir_scope_id  = 0;
+  sink->transport_dirty = FALSE;
+  sink->cc_window_start = 0;
+  sink->allowed_rate = sink->max_rate;
 
-	if (AF_INET6 == sa_family) 
-  {
-		struct sockaddr_in6 sa6;
-		memcpy (&sa6, &res->ai_recv_addrs[0].gsr_group, sizeof(sa6));
-		ifReq.ir_scope_id = sa6.sin6_scope_id;
-	}
+  /* request pads send while the always pad may be reopening */
+  g_mutex_lock (&sink->send_lock);
 
-  if (!pgm_bind3 ( sink->sock
-                 , &addr, sizeof(addr)
-                 , &ifReq, sizeof(ifReq)  // tx interface
-                 , &ifReq, sizeof(ifReq)  // rx interface
-                 , &pErr
-                 )
-     )
+  if (sink->shm_size > 0)
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Binding transport: %s", pErr->message));
-    pgm_error_free (pErr);
-    goto destroy_transport;
+    sink->shm = gst_pgm_shm_create (sink->network, sink->port, sink->shm_size);
+    if (NULL == sink->shm) GST_WARNING_OBJECT (sink, "no shared memory ring, looping back to receivers on this host: %s", g_strerror (errno));
   }
 
-	for (unsigned i = 0; i < res->ai_recv_addrs_len; ++i)
+  sink->transport = gst_pgm_transport_open 
+    ( GST_ELEMENT_CAST (sink)
+    , sink->network
+    , sink->port
+    , sink->udp_encap_port
+    , gst_pgm_sink_configure
+    , NULL
+    );
+  if (sink->transport == NULL) goto destroy_transport;
+
+  GstClockTime setup_time = sink->transport->setup_time;
+
+  if (sink->redundant_network)
   {
-		pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct group_req));
+    sink->redundant_transport = gst_pgm_transport_open 
+      ( GST_ELEMENT_CAST (sink)
+      , sink->redundant_network
+      , sink->port
+      , sink->udp_encap_port
+      , gst_pgm_sink_configure
+      , NULL
+      );
+    if (sink->redundant_transport == NULL) goto destroy_transport;
+
+    setup_time += sink->redundant_transport->setup_time;
   }
-	pgm_setsockopt (sink->sock, IPPROTO_PGM, PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct group_req));
-	pgm_freeaddrinfo (res);
 
-	if (!pgm_connect (sink->sock, &pErr))
+  if (sink->droppable_port)
   {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Connecting socket: %s", pErr->message));
-    pgm_error_free (pErr);
-    goto destroy_transport;
-	}
+    sink->droppable_transport = gst_pgm_transport_open 
+      ( GST_ELEMENT_CAST (sink)
+      , sink->network
+      , sink->droppable_port
+      , sink->udp_encap_port
+      , gst_pgm_sink_configure
+      , GINT_TO_POINTER (TRUE)
+      );
+    if (sink->droppable_transport == NULL) goto destroy_transport;
+
+    setup_time += sink->droppable_transport->setup_time;
+  }
+  g_mutex_unlock (&sink->send_lock);
 
+  GstAllocator* allocator = gst_pgm_allocator_new (gst_pgm_transport_numa_node (sink->transport), sink->hugepages);
+  GST_OBJECT_LOCK (sink);
+  sink->allocator = allocator;
+  GST_OBJECT_UNLOCK (sink);
 
   /* create NAK thread */
+  sink->nak_quit = FALSE;
   sink->nak_thread = g_thread_new 
     ( "nak_thread"
     , gst_pgm_sink_nak_thread
     , sink
     );
 
-  if (sink->nak_thread == NULL) 
-  {
-    GST_ELEMENT_ERROR (sink, RESOURCE, OPEN_WRITE, (NULL), ("Creating NAK processing thread:/%s", gErr->message));
-    g_error_free (gErr);
-    goto destroy_transport;
-  }
+  gst_pgm_transport_post_setup (GST_ELEMENT_CAST (sink), 1 + (sink->redundant_transport ? 1 : 0) + (sink->droppable_transport ? 1 : 0), setup_time);
   return TRUE;
 
 destroy_transport:
-  pgm_close (sink->sock, TRUE);
-  sink->sock = NULL;
+  gst_pgm_transport_close (sink->redundant_transport);
+  sink->redundant_transport = NULL;
+  gst_pgm_transport_close (sink->transport);
+  sink->transport = NULL;
+  gst_pgm_shm_free (sink->shm);
+  sink->shm = NULL;
+  g_mutex_unlock (&sink->send_lock);
   return FALSE;
 }
 
-static gboolean gst_pgm_client_sink_stop (GstBaseSink* io_basesink)
+static void gst_pgm_sink_close (GstPgmSink* sink)
 {
-  GstPgmSink* sink = GST_PGM_SINK (io_basesink);
-
   /* stop nak thread */
   if (sink->nak_thread) 
   {
     sink->nak_quit = TRUE;
     g_thread_join (sink->nak_thread);
+    sink->nak_thread = NULL;
   }
 
   GST_DEBUG_OBJECT (sink, "destroying transport");
-  
-  if (sink->sock) 
+
+  g_mutex_lock (&sink->send_lock);
+  for (unsigned i = 0; i < G_N_ELEMENTS(sink->pending); ++i)
   {
-    pgm_close (sink->sock, TRUE);
-    sink->sock = NULL;
+    if (sink->pending[i]) g_bytes_unref (sink->pending[i]);
+    sink->pending[i] = NULL;
   }
 
+  gst_pgm_transport_close (sink->droppable_transport);
+  sink->droppable_transport = NULL;
+
+  gst_pgm_transport_close (sink->redundant_transport);
+  sink->redundant_transport = NULL;
+
+  gst_pgm_transport_close (sink->transport);
+  sink->transport = NULL;
+
+  gst_pgm_shm_free (sink->shm);
+  sink->shm = NULL;
+  g_mutex_unlock (&sink->send_lock);
+
+  GST_OBJECT_LOCK (sink);
+  GstAllocator* allocator = sink->allocator;
+  sink->allocator = NULL;
+  GST_OBJECT_UNLOCK (sink);
+  if (allocator) gst_object_unref (allocator);
+}
+
+/* The transports live from READY to NULL, so that a pipeline cycling
+ * through READY and PAUSED does not set them up again every time.
+ */
+static GstStateChangeReturn gst_pgm_sink_change_state (GstElement* element, GstStateChange transition)
+{
+  GstPgmSink* sink = GST_PGM_SINK (element);
+
+  if (GST_STATE_CHANGE_NULL_TO_READY == transition)
+  {
+    if (!gst_pgm_sink_open (sink)) return GST_STATE_CHANGE_FAILURE;
+  }
+
+  if (GST_STATE_CHANGE_READY_TO_PAUSED == transition)
+  {
+    gst_pgm_sink_flush_streams (sink, FALSE);
+
+    /* request pads do not preroll, with only them in use the always pad
+     * would keep the state change waiting */
+    GST_OBJECT_LOCK (sink);
+    const gboolean streams = sink->streams != NULL;
+    GST_OBJECT_UNLOCK (sink);
+
+    if ( streams
+       && !gst_pad_is_linked (GST_BASE_SINK_PAD (sink))
+       && gst_base_sink_is_async_enabled (GST_BASE_SINK (sink))
+       )
+    {
+      gst_base_sink_set_async_enabled (GST_BASE_SINK (sink), FALSE);
+      sink->async_disabled = TRUE;
+    }
+  }
+
+  const GstStateChangeReturn ret = GST_ELEMENT_CLASS (gst_pgm_sink_parent_class)->change_state (element, transition);
+
+  if (GST_STATE_CHANGE_PAUSED_TO_READY == transition && sink->async_disabled)
+  {
+    gst_base_sink_set_async_enabled (GST_BASE_SINK (sink), TRUE);
+    sink->async_disabled = FALSE;
+  }
+
+  if ( GST_STATE_CHANGE_READY_TO_NULL == transition
+     || (GST_STATE_CHANGE_NULL_TO_READY == transition && GST_STATE_CHANGE_FAILURE == ret)
+     )
+  {
+    gst_pgm_sink_close (sink);
+  }
+
+  return ret;
+}
+
+/* rebuild the transports if a socket property changed since they were
+ * opened
+ */
+static gboolean gst_pgm_client_sink_start (GstBaseSink* basesink)
+{
+  GstPgmSink* sink = GST_PGM_SINK (basesink);
+
+  if (sink->transport_dirty || sink->transport == NULL)
+  {
+    GST_DEBUG_OBJECT (sink, "socket properties changed, rebuilding transport");
+    gst_pgm_sink_close (sink);
+    if (!gst_pgm_sink_open (sink)) return FALSE;
+  }
+
+  /* receivers drop what seems to be up to PGM_SRC_MERGE_WINDOW behind,
+   * a restarted sender must not look like that */
+  sink->sequence = g_random_int ();
+
+  /* receivers lose track of dictionaries with the sequence numbers, the
+   * first reliable APDU of every stream brings a new one */
+  GST_OBJECT_LOCK (sink);
+  gst_pgm_deflate_clear (&sink->stream.deflate);
+  for (GList* l = sink->streams; l; l = l->next) gst_pgm_deflate_clear (&((GstPgmSinkStream*) l->data)->deflate);
+  const gboolean keys_ok = NULL == sink->keys || (sink->crypto && gst_pgm_crypto_has_epoch (sink->crypto, sink->key_epoch));
+  GST_OBJECT_UNLOCK (sink);
+  if (!keys_ok)
+  {
+    GST_ELEMENT_ERROR (sink, RESOURCE, SETTINGS, (NULL), ("keys do not parse or have no key for key-epoch %u", sink->key_epoch));
+    return FALSE;
+  }
+
+  if (GST_PGM_LEAKY_NONE != sink->leaky)
+  {
+    sink->send_quit   = FALSE;
+    sink->queue_ret   = GST_FLOW_OK;
+    sink->dropped_new = 0;
+    sink->dropped_old = 0;
+    sink->send_thread = g_thread_new ("send_thread", gst_pgm_sink_send_thread, sink);
+  }
   return TRUE;
 }
 
+static gboolean gst_pgm_client_sink_stop (GstBaseSink* io_basesink)
+{
+  GstPgmSink* sink = GST_PGM_SINK (io_basesink);
+
+  gst_pgm_sink_stop_send_thread (sink);
+  return TRUE;
+}
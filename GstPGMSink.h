@@ -28,6 +28,12 @@
 
 #include <pgm/pgm.h>
 
+#include "GstPGMTransport.h"
+#include "GstPGMShm.h"
+#include "GstPGMCrypto.h"
+#include "GstPGMCompress.h"
+#include "GstPGMAllocator.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_PGM_SINK             (gst_pgm_sink_get_type())
@@ -36,6 +42,46 @@ G_BEGIN_DECLS
 #define GST_IS_PGM_SINK(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_SINK))
 #define GST_IS_PGM_SINK_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PGM_SINK))
 
+#define GST_TYPE_PGM_HEARTBEAT_MODE   (gst_pgm_heartbeat_mode_get_type())
+#define GST_TYPE_PGM_LEAKY            (gst_pgm_leaky_get_type())
+
+/* Where the SPM heartbeat schedule comes from.
+ */
+typedef enum
+{
+  GST_PGM_HEARTBEAT_FIXED     = 0,  // heartbeat-spm property
+  GST_PGM_HEARTBEAT_IHB       = 1,  // doubling from ihb-min up to ihb-max
+  GST_PGM_HEARTBEAT_ADAPTIVE  = 2   // first heartbeat a quarter frame after data, set at start
+} GstPgmHeartbeatMode;
+
+/* What pgmsink gives up when sending falls behind.
+ */
+typedef enum
+{
+  GST_PGM_LEAKY_NONE        = 0,  // block upstream
+  GST_PGM_LEAKY_DROP_NEW    = 1,  // drop incoming buffers while the queue is full
+  GST_PGM_LEAKY_DROP_OLDEST = 2   // drop the oldest queued delta units
+} GstPgmLeaky;
+
+/* One elementary stream, the always pad or a request pad.
+ */
+typedef struct _GstPgmSinkStream GstPgmSinkStream;
+
+struct _GstPgmSinkStream
+{
+  GstPad*       pad;
+  guint16       id;
+  gboolean      tagged;         // carries its id, FALSE for the always pad
+  GstSegment    segment;        // request pads, the always pad has basesink's
+  gint          flushing;
+  gboolean      eos;
+  gboolean      queue_gap;      // lost a queued buffer, deltas go until a key unit, queue_lock
+  gchar*        caps_string;    // native framing sends these in band
+  gboolean      caps_changed;
+  gint64        caps_next;
+  GstPgmDeflate deflate;
+};
+
 typedef struct _GstPgmSink GstPgmSink;
 typedef struct _GstPgmSinkClass GstPgmSinkClass;
 
@@ -44,7 +90,10 @@ struct _GstPgmSink
   GstBaseSink    parent;
   GstPad*        sinkpad;
 
-  struct pgm_sock_t*  sock;
+  GstPgmTransport*  transport;
+  GstPgmTransport*  redundant_transport;
+  GstPgmTransport*  droppable_transport;
+  gboolean          transport_dirty;
 
   GThread*    nak_thread;
   gboolean    nak_quit;
@@ -55,10 +104,73 @@ struct _GstPgmSink
   guint   udp_encap_port;
   guint   max_tpdu;
   guint   txw_sqns;
+  guint   txw_secs;
+  guint   max_rate;
+  guint64 window_budget;
+  gint    congestion_control;
   guint   hops;
   guint   spm_ambient;
   guint   ihb_min;
   guint   ihb_max;
+  gchar*  redundant_network;
+  gint    framing;
+  gboolean framing_set;         // by the user, not changed for features that need a header
+  gchar*  heartbeat_spm;
+  gint    heartbeat_mode;
+
+  GstPgmSinkStream  stream;     // the always pad
+  GList*            streams;    // request pads
+  gboolean          async_disabled;   // by us, for request pads without the always pad
+  GMutex            send_lock;
+
+  guint32 sequence;
+  GBytes*  pending[3];      // APDU per path OpenPGM has to finish first
+  gsize    pending_head[3]; // and its header length, 0 if none
+  guint32  anchor;          // sequence of the last reliable APDU
+
+  guint       shm_size;
+  GstPgmShm*  shm;          // ring for receivers on this host
+
+  gchar*         keys;
+  guint          key_epoch;
+  GstPgmCrypto*  crypto;    // NULL if keys do not parse
+  GByteArray*    sealed;    // the APDU being sent, encrypted
+
+  gint         compression;
+  guint        dictionary_interval;   // milliseconds
+  GByteArray*  deflated;              // the payload being sent, compressed
+
+  gboolean       hugepages;
+  GstAllocator*  allocator; // proposed upstream, local to the interface
+
+  gint           send_stamps;   // boolean, set from other threads by the tracer
+
+  gint              leaky;
+  guint             max_queue_time;   // milliseconds
+  GThread*          send_thread;
+  gint              send_quit;
+  GMutex            queue_lock;
+  GCond             queue_cond;
+  GQueue            queue;            // buffers waiting for the send thread
+  GstPgmSinkStream* queue_sending;    // stream of the buffer being sent
+  GstFlowReturn     queue_ret;
+  guint64           dropped_new;
+  guint64           dropped_old;
+
+  gint64   cc_window_start;
+  guint64  cc_bytes;
+  gint64   cc_blocked;      // microseconds waiting for PGMCC tokens
+  guint64  allowed_rate;
+
+  gboolean      caps_framerate;
+  guint         clock_interval;
+  guint         droppable_port;
+  gint64        clock_next;
+  GstClockTime  frame_interval;
+  GstClockTime  heartbeat_interval;   // frame interval the open transports' schedule was made for
+  GstClockTime  heartbeat_learned;    // and the one the next start makes it for
+  GstClockTime  last_pts;
+  gint64        last_render;          // monotonic, microseconds
 };
 
 struct _GstPgmSinkClass
@@ -67,6 +179,8 @@ struct _GstPgmSinkClass
 };
 
 GType gst_pgm_sink_get_type (void);
+GType gst_pgm_heartbeat_mode_get_type (void);
+GType gst_pgm_leaky_get_type (void);
 
 G_END_DECLS
 
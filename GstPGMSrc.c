@@ -20,13 +20,34 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <errno.h>
 #include <string.h>
-#include <stdio.h>  // for debug puts() & printf() only
+#include <poll.h>
 #include <netinet/ip.h>
 #include <pgm/packet.h>
 
 #include "GstPGMSrc.h"
 #include "GstPGMConfig.h"
+#include "GstPGMFrame.h"
+#include "GstPGMTransport.h"
+#include "GstPGMRepair.h"
+#include "GstPGMMeta.h"
+#include "GstPGMClock.h"
+#include "GstPGMKeyframe.h"
+
+#define PGM_SRC_MAX_POLL_FDS  8
+
+/* a sequence number this far behind the expected one is a restarted
+ * sender rather than a late duplicate */
+#define PGM_SRC_MERGE_WINDOW  (1 << 16)
+
+/* droppable APDUs waiting for the reliable one they follow, by count and
+ * by size */
+#define PGM_SRC_TIER_HELD_MAX    64
+#define PGM_SRC_TIER_HELD_BYTES  (4 << 20)
+
+#define PGM_SRC_SHM_ATTACH_MSECS  1000  // between looking for a sender on this host
+#define PGM_SRC_SHM_WAIT_MSECS    10    // unlock latency while waiting on the ring
 
 enum
 {
@@ -46,6 +67,33 @@ enum
   PROP_NAK_RDATA_IVL,
   PROP_NAK_DATA_RETRIES,
   PROP_NAK_NCF_RETRIES,
+  PROP_REDUNDANT_NETWORK,
+  PROP_FRAMING,
+  PROP_STANDBY_URIS,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_NAK_ADAPTIVE,
+  PROP_NAK_ADAPT_MIN,
+  PROP_NAK_ADAPT_MAX,
+  PROP_REPAIR_RTT,
+  PROP_EFFECTIVE_NAK_BO_IVL,
+  PROP_EFFECTIVE_NAK_RPT_IVL,
+  PROP_EFFECTIVE_NAK_RDATA_IVL,
+  PROP_RXW_SECS,
+  PROP_MAX_RATE,
+  PROP_WINDOW_BUDGET,
+  PROP_CONGESTION_CONTROL,
+  PROP_PROVIDE_CLOCK,
+  PROP_LATENCY,
+  PROP_DROPPABLE_PORT,
+  PROP_WAIT_KEYFRAME,
+  PROP_CAPTURE_LOCATION,
+  PROP_SHM,
+  PROP_KEYS,
+  PROP_HUGEPAGES,
+  PROP_ALLOCATOR_STATS,
+  PROP_PEER_THRESHOLD,
+  PROP_PEERS,
   PROP_LAST
 };
 
@@ -56,15 +104,47 @@ static GstStaticPadTemplate gst_pgm_src_src_template =
                           , GST_STATIC_CAPS_ANY
                           );
 
+/* elementary streams tagged by pgmsink request pads, native framing */
+static GstStaticPadTemplate gst_pgm_src_stream_template =
+  GST_STATIC_PAD_TEMPLATE ( "src_%u"
+                          , GST_PAD_SRC
+                          , GST_PAD_SOMETIMES
+                          , GST_STATIC_CAPS_ANY
+                          );
+
+/* one APDU on its way out, see gst_pgm_src_merge_tiers */
+typedef struct
+{
+  GstBuffer*        buffer;
+  GstPgmSrcStream*  stream;       // NULL for the always pad
+  guint32           sequence;
+  guint32           anchor;
+  gboolean          droppable;
+} GstPgmSrcApdu;
+
 static void          gst_pgm_src_finalize (GObject*);
 static void          gst_pgm_src_set_property (GObject*, guint, const GValue*, GParamSpec*);
 static void          gst_pgm_src_get_property (GObject*, guint, GValue*, GParamSpec*);
 static GstCaps*      gst_pgm_src_get_caps (GstBaseSrc*, GstCaps*);
 static gboolean      gst_pgm_src_set_uri (GstPgmSrc*, const gchar*);
+static void          gst_pgm_src_request_switch (GstPgmSrc*);
+static gboolean      gst_pgm_src_switch_channel (GstPgmSrc*);
+static void          gst_pgm_src_push_flush (GstPgmSrc*);
+static void          gst_pgm_src_drain_standby (GstPgmSrc*, GstClockTime*);
+static void          gst_pgm_src_poll_transport (GstPgmSrc*, const GstPgmTransport*, gboolean);
+static GstPgmTransport* gst_pgm_src_open_transport (GstPgmSrc*, const gchar*, guint, guint);
 static void          gst_pgm_src_uri_handler_init (gpointer, gpointer);
 static GstFlowReturn gst_pgm_src_create (GstPushSrc*, GstBuffer**);
 static gboolean      gst_pgm_client_src_stop (GstBaseSrc*);
 static gboolean      gst_pgm_client_src_start (GstBaseSrc*);
+static gboolean      gst_pgm_src_unlock (GstBaseSrc*);
+static gboolean      gst_pgm_src_unlock_stop (GstBaseSrc*);
+static gboolean      gst_pgm_src_query (GstBaseSrc*, GstQuery*);
+static GstClock*     gst_pgm_src_provide_clock (GstElement*);
+static gboolean      gst_pgm_src_open (GstPgmSrc*);
+static void          gst_pgm_src_close (GstPgmSrc*);
+static GstFlowReturn gst_pgm_src_receive (GstPgmSrc*, GstBuffer**);
+static GstStateChangeReturn gst_pgm_src_change_state (GstElement*, GstStateChange);
 
 G_DEFINE_TYPE (GstPgmSrc, gst_pgm_src, GST_TYPE_PUSH_SRC)
 
@@ -106,57 +186,74 @@ static void gst_pgm_src_update_uri (GstPgmSrc* io_src)
   io_src->uri = g_strdup_printf ("pgm://%s:%i:%i", io_src->network, io_src->port, io_src->udp_encap_port);
 }
 
-static gboolean gst_pgm_src_set_uri (GstPgmSrc* io_src, const gchar* i_uri)
+/* split pgm://network:dport:udp-encap-port into its parts
+ */
+static gboolean gst_pgm_src_parse_uri (const gchar* i_uri, gchar** o_network, guint* o_port, guint* o_udp_encap_port)
 {
   if (!gst_uri_is_valid(i_uri)) return FALSE;
 
   gchar* protocol = gst_uri_get_protocol (i_uri);
-  if (strncmp (protocol, "pgm", strlen("pgm")) != 0) goto wrong_protocol;
+  const gboolean is_pgm = (strncmp (protocol, "pgm", strlen("pgm")) == 0);
+  g_free (protocol);
 
-  {
+  if (!is_pgm) return FALSE;
 
-  g_free (protocol);
   gchar* location = gst_uri_get_location (i_uri);
 
   if (location == NULL) return FALSE;
 
   gchar* port = strstr (location, ":");
-  g_free (io_src->network);
 
   if (port == NULL) 
   {
-    io_src->network  = g_strdup (location);
-    io_src->port = PGM_DEFAULT_PORT;
-    io_src->udp_encap_port = PGM_DEFAULT_UDP_ENCAP_PORT;
+    *o_network  = g_strdup (location);
+    *o_port = PGM_DEFAULT_PORT;
+    *o_udp_encap_port = PGM_DEFAULT_UDP_ENCAP_PORT;
   } 
   else 
   {
-    io_src->network  = g_strndup (location, port - location);
-    io_src->port = atoi (port + 1);
+    *o_network  = g_strndup (location, port - location);
+    *o_port = atoi (port + 1);
     gchar* udp_encap_port = strstr (port + 1, ":");
     if (udp_encap_port == NULL) 
     {
-      io_src->udp_encap_port = PGM_DEFAULT_UDP_ENCAP_PORT;
+      *o_udp_encap_port = PGM_DEFAULT_UDP_ENCAP_PORT;
     } 
     else 
     {
-      io_src->udp_encap_port = atoi (udp_encap_port + 1);
+      *o_udp_encap_port = atoi (udp_encap_port + 1);
     }
   }
   g_free (location);
-  
-  gst_pgm_src_update_uri (io_src);
+
   return TRUE;
+}
 
-  }
+static gboolean gst_pgm_src_set_uri (GstPgmSrc* io_src, const gchar* i_uri)
+{
+  gchar* network = NULL;
+  guint port;
+  guint udp_encap_port;
+
+  if (!gst_pgm_src_parse_uri (i_uri, &network, &port, &udp_encap_port)) goto wrong_protocol;
+
+  GST_OBJECT_LOCK (io_src);
+  g_free (io_src->network);
+  io_src->network        = network;
+  io_src->port           = port;
+  io_src->udp_encap_port = udp_encap_port;
+  gst_pgm_src_update_uri (io_src);
+  GST_OBJECT_UNLOCK (io_src);
+
+  gst_pgm_src_request_switch (io_src);
+  return TRUE;
 
 wrong_protocol:
-  g_free (protocol);
   GST_ELEMENT_ERROR ( io_src
                     , RESOURCE
                     , READ
                     , (NULL)
-                    , ("error parsing uri %s: wrong protocol (%s != udp)", i_uri, protocol)
+                    , ("error parsing uri %s: wrong protocol (!= pgm)", i_uri)
                     );
   return FALSE;
 }
@@ -171,21 +268,34 @@ static void gst_pgm_src_class_init (GstPgmSrcClass* klass)
   gstbasesrcClass->start     = GST_DEBUG_FUNCPTR(gst_pgm_client_src_start);
   gstbasesrcClass->stop      = GST_DEBUG_FUNCPTR(gst_pgm_client_src_stop);
   gstbasesrcClass->get_caps  = GST_DEBUG_FUNCPTR(gst_pgm_src_get_caps);
+  gstbasesrcClass->unlock    = GST_DEBUG_FUNCPTR(gst_pgm_src_unlock);
+  gstbasesrcClass->unlock_stop = GST_DEBUG_FUNCPTR(gst_pgm_src_unlock_stop);
+  gstbasesrcClass->query     = GST_DEBUG_FUNCPTR(gst_pgm_src_query);
 
   GstPushSrcClass* gstpushsrcClass = (GstPushSrcClass*)klass;
   gstpushsrcClass->create  = GST_DEBUG_FUNCPTR(gst_pgm_src_create);
 
+  klass->open    = GST_DEBUG_FUNCPTR(gst_pgm_src_open);
+  klass->close   = GST_DEBUG_FUNCPTR(gst_pgm_src_close);
+  klass->receive = GST_DEBUG_FUNCPTR(gst_pgm_src_receive);
+
   GObjectClass* gobjectClass = (GObjectClass*)klass;
   gobjectClass->finalize     = GST_DEBUG_FUNCPTR(gst_pgm_src_finalize);
   gobjectClass->set_property = GST_DEBUG_FUNCPTR(gst_pgm_src_set_property);
   gobjectClass->get_property = GST_DEBUG_FUNCPTR(gst_pgm_src_get_property);
 
   GstElementClass* elementClass = GST_ELEMENT_CLASS (klass);
+  elementClass->change_state = GST_DEBUG_FUNCPTR(gst_pgm_src_change_state);
+  elementClass->provide_clock = GST_DEBUG_FUNCPTR(gst_pgm_src_provide_clock);
 
   gst_element_class_add_pad_template 
     ( elementClass
     , gst_static_pad_template_get (&gst_pgm_src_src_template)
     );
+  gst_element_class_add_pad_template 
+    ( elementClass
+    , gst_static_pad_template_get (&gst_pgm_src_stream_template)
+    );
 
   gst_element_class_set_static_metadata
     ( elementClass
@@ -239,7 +349,7 @@ static void gst_pgm_src_class_init (GstPgmSrcClass* klass)
     , g_param_spec_boxed 
         ( "caps"
         , "CAPS"
-        , "The caps of the source pad"
+        , "The caps of the source pad, native framing takes them from the sender"
         , GST_TYPE_CAPS
         , (GParamFlags) G_PARAM_READWRITE
         )
@@ -398,11 +508,374 @@ static void gst_pgm_src_class_init (GstPgmSrcClass* klass)
       , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
       )
     );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_REDUNDANT_NETWORK
+    , g_param_spec_string 
+      ( "redundant-network"
+      , "Redundant network"
+      , "Second rendezvous-style multicast network carrying a copy of the stream, NULL to disable."
+      , NULL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_FRAMING
+    , g_param_spec_enum 
+      ( "framing"
+      , "Framing"
+      , "Header expected in front of the payload of every APDU."
+      , GST_TYPE_PGM_FRAMING
+      , GST_PGM_FRAMING_RAW
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_STANDBY_URIS
+    , g_param_spec_string 
+      ( "standby-uris"
+      , "Standby URIs"
+      , "Space separated pgm:// URIs of channels kept bound and joined for instant switching."
+      , NULL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_STATS_INTERVAL
+    , g_param_spec_uint 
+      ( "stats-interval"
+      , "Statistics interval"
+      , "Milliseconds between pgm-receive-stats messages, 0 to disable."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_STATS_INTERVAL
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_STATS
+    , g_param_spec_boxed 
+      ( "stats"
+      , "Statistics"
+      , "Last pgm-receive-stats: PGM loss next to socket, interface and host receive drops."
+      , GST_TYPE_STRUCTURE
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_NAK_ADAPTIVE
+    , g_param_spec_boolean 
+      ( "nak-adaptive"
+      , "Adaptive NAK timing"
+      , "Derive NAK back-off and repeat intervals from the measured repair round trip."
+      , FALSE
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_NAK_ADAPT_MIN
+    , g_param_spec_uint 
+      ( "nak-adapt-min"
+      , "Adaptive NAK minimum"
+      , "Lower bound of adapted NAK intervals."
+      , 1 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_NAK_ADAPT_MIN
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_NAK_ADAPT_MAX
+    , g_param_spec_uint 
+      ( "nak-adapt-max"
+      , "Adaptive NAK maximum"
+      , "Upper bound of adapted NAK intervals."
+      , 1 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_NAK_ADAPT_MAX
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_REPAIR_RTT
+    , g_param_spec_uint 
+      ( "repair-rtt"
+      , "Repair RTT"
+      , "Smoothed repair round trip of the slowest sender, 0 until measured."
+      , 0 // minimum
+      , UINT_MAX
+      , 0
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_EFFECTIVE_NAK_BO_IVL
+    , g_param_spec_uint 
+      ( "effective-nak-bo-ivl"
+      , "Effective NAK_BO_IVL"
+      , "Back-off interval the transport was given."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_NAK_BO_IVL
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_EFFECTIVE_NAK_RPT_IVL
+    , g_param_spec_uint 
+      ( "effective-nak-rpt-ivl"
+      , "Effective NAK_RPT_IVL"
+      , "Repeat interval the transport was given."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_NAK_RPT_IVL
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_EFFECTIVE_NAK_RDATA_IVL
+    , g_param_spec_uint 
+      ( "effective-nak-rdata-ivl"
+      , "Effective NAK_RDATA_IVL"
+      , "Wait-for-data interval the transport was given."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_NAK_RDATA_IVL
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_RXW_SECS
+    , g_param_spec_uint 
+      ( "rxw-secs"
+      , "RXW_SECS"
+      , "Receive window in seconds of the stream at max-rate, 0 to size it by rxw-sqns."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_RXW_SECS
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_MAX_RATE
+    , g_param_spec_uint 
+      ( "max-rate"
+      , "Maximum rate"
+      , "Highest expected stream rate in bits per second, sizes time based windows."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_MAX_RATE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_WINDOW_BUDGET
+    , g_param_spec_uint64 
+      ( "window-budget"
+      , "Window budget"
+      , "Maximum bytes of packets a receive window may hold, 0 for no limit."
+      , 0 // minimum
+      , G_MAXUINT64
+      , PGM_DEFAULT_WINDOW_BUDGET
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_CONGESTION_CONTROL
+    , g_param_spec_enum 
+      ( "congestion-control"
+      , "Congestion control"
+      , "Take part in the sender's congestion control, must match pgmsink."
+      , GST_TYPE_PGM_CONGESTION_CONTROL
+      , GST_PGM_CONGESTION_CONTROL_NONE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_PROVIDE_CLOCK
+    , g_param_spec_boolean 
+      ( "provide-clock"
+      , "Provide clock"
+      , "Offer a clock slaved to the sender's, needs native framing and clock-interval on pgmsink."
+      , FALSE
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_LATENCY
+    , g_param_spec_uint 
+      ( "latency"
+      , "Latency"
+      , "Milliseconds of latency to report, room for network delay and repairs when playing out on the sender's clock, 0 for none."
+      , 0
+      , G_MAXUINT
+      , PGM_DEFAULT_LATENCY
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_DROPPABLE_PORT
+    , g_param_spec_uint 
+      ( "droppable-port"
+      , "Droppable port"
+      , "Data-destination port of pgmsink's session for droppable buffers, joined without repairs, 0 for none."
+      , 0
+      , 65535
+      , PGM_DEFAULT_DROPPABLE_PORT
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_WAIT_KEYFRAME
+    , g_param_spec_boolean 
+      ( "wait-keyframe"
+      , "Wait for keyframe"
+      , "Drop data after joining and after unrecoverable loss until a key unit, told by native framing buffer flags or by H.264 and H.263 RTP payloads."
+      , PGM_DEFAULT_WAIT_KEYFRAME
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_CAPTURE_LOCATION
+    , g_param_spec_string 
+      ( "capture-location"
+      , "Capture location"
+      , "File to append every APDU and loss received to, for pgmreplaysrc, NULL for none."
+      , NULL
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_SHM
+    , g_param_spec_boolean 
+      ( "shm"
+      , "Shared memory"
+      , "Read the shared memory ring of a pgmsink on this host for the session, which does not loop its data back then."
+      , PGM_DEFAULT_SHM
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_KEYS
+    , g_param_spec_string 
+      ( "keys"
+      , "Keys"
+      , "AES-GCM keys as epoch:hex-key[,epoch:hex-key...] the sender may encrypt with, APDUs that do not authenticate are dropped, NULL for clear text. Write-only."
+      , NULL
+      , (GParamFlags) G_PARAM_WRITABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_HUGEPAGES
+    , g_param_spec_boolean 
+      ( "hugepages"
+      , "Huge pages"
+      , "Receive into huge pages of the NUMA node of the interface, plain pages if none are reserved."
+      , PGM_DEFAULT_HUGEPAGES
+      , (GParamFlags) G_PARAM_READWRITE /*| G_PARAM_CONSTRUCT_ONLY*/
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_ALLOCATOR_STATS
+    , g_param_spec_boxed 
+      ( "allocator-stats"
+      , "Allocator statistics"
+      , "pgm-allocator-stats of the memory APDUs are received into, NULL before the transport is open."
+      , GST_TYPE_STRUCTURE
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_PEER_THRESHOLD
+    , g_param_spec_uint 
+      ( "peer-threshold"
+      , "Peer threshold"
+      , "Percent a sender's rate has to move within a stats-interval for a pgm-peer-stats message, which new senders and any loss get anyway."
+      , 0 // minimum
+      , UINT_MAX
+      , PGM_DEFAULT_PEER_THRESHOLD
+      , (GParamFlags) G_PARAM_READWRITE
+      )
+    );
+
+  g_object_class_install_property 
+    ( gobjectClass
+    , PROP_PEERS
+    , gst_param_spec_array 
+      ( "peers"
+      , "Peers"
+      , "pgm-peer-stats of every sender heard from within peer-expiry, as of the last stats-interval."
+      , g_param_spec_boxed 
+        ( "peer"
+        , "Peer"
+        , "pgm-peer-stats of one sender."
+        , GST_TYPE_STRUCTURE
+        , (GParamFlags) G_PARAM_READABLE
+        )
+      , (GParamFlags) G_PARAM_READABLE
+      )
+    );
 }
 
 static void gst_pgm_src_init (GstPgmSrc* io_src)
 {
-    io_src->sock = NULL;
+    io_src->transport = NULL;
+    io_src->redundant_transport = NULL;
+    io_src->retune[0] = io_src->retune[1] = NULL;
+    io_src->retune_thread = NULL;
+    io_src->transport_dirty = FALSE;
+    io_src->poll = NULL;
 
     io_src->network          = g_strdup (PGM_DEFAULT_NETWORK);
     io_src->port             = PGM_DEFAULT_PORT;
@@ -411,6 +884,10 @@ static void gst_pgm_src_init (GstPgmSrc* io_src)
     io_src->max_tpdu         = PGM_DEFAULT_MAX_TPDU;
     io_src->hops             = PGM_DEFAULT_HOPS;
     io_src->rxw_sqns         = PGM_DEFAULT_RXW_SQNS;
+    io_src->rxw_secs         = PGM_DEFAULT_RXW_SECS;
+    io_src->max_rate         = PGM_DEFAULT_MAX_RATE;
+    io_src->window_budget    = PGM_DEFAULT_WINDOW_BUDGET;
+    io_src->congestion_control = GST_PGM_CONGESTION_CONTROL_NONE;
     io_src->peer_expiry      = PGM_DEFAULT_PEER_EXPIRY;
     io_src->spmr_expiry      = PGM_DEFAULT_SPMR_EXPIRY;
     io_src->nak_bo_ivl       = PGM_DEFAULT_NAK_BO_IVL;
@@ -418,11 +895,66 @@ static void gst_pgm_src_init (GstPgmSrc* io_src)
     io_src->nak_rdata_ivl    = PGM_DEFAULT_NAK_RDATA_IVL;
     io_src->nak_data_retries = PGM_DEFAULT_NAK_DATA_RETRIES;
     io_src->nak_ncf_retries  = PGM_DEFAULT_NAK_NCF_RETRIES;
+    io_src->redundant_network = NULL;
+    io_src->framing          = GST_PGM_FRAMING_RAW;
+    io_src->framing_set      = FALSE;
+    io_src->standby_uris     = NULL;
+    io_src->stats_interval   = PGM_DEFAULT_STATS_INTERVAL;
+    io_src->stats            = NULL;
+    io_src->nak_adaptive     = FALSE;
+    io_src->nak_adapt_min    = PGM_DEFAULT_NAK_ADAPT_MIN;
+    io_src->nak_adapt_max    = PGM_DEFAULT_NAK_ADAPT_MAX;
+    io_src->nak_estimated    = FALSE;
+    io_src->repair_rtt       = 0;
+    io_src->nak_effective.bo_ivl    = PGM_DEFAULT_NAK_BO_IVL;
+    io_src->nak_effective.rpt_ivl   = PGM_DEFAULT_NAK_RPT_IVL;
+    io_src->nak_effective.rdata_ivl = PGM_DEFAULT_NAK_RDATA_IVL;
+    io_src->senders          = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, g_free);
+    io_src->peer_threshold   = PGM_DEFAULT_PEER_THRESHOLD;
+    io_src->peers            = NULL;
+    io_src->standby          = NULL;
+    io_src->switch_pending   = FALSE;
+    io_src->flush_pending    = FALSE;
+    io_src->caps_fixed       = FALSE;
+    io_src->native_caps      = NULL;
+    io_src->have_ts_offset   = FALSE;
+    io_src->main_discont     = FALSE;
+    io_src->main_end         = GST_CLOCK_TIME_NONE;
+    io_src->wait_keyframe    = PGM_DEFAULT_WAIT_KEYFRAME;
+    io_src->main_waiting     = FALSE;
+    io_src->keyframe_skipped = 0;
+    gst_pgm_inflate_init (&io_src->main_inflate);
+    io_src->decompress_failed = 0;
+    io_src->tiered           = FALSE;
+    io_src->capture_location = NULL;
+    io_src->capture          = NULL;
+    io_src->use_shm          = PGM_DEFAULT_SHM;
+    io_src->shm              = NULL;
+    io_src->shm_record       = g_byte_array_new ();
+    io_src->shm_next_attach  = 0;
+    io_src->keys             = NULL;
+    io_src->crypto           = NULL;
+    io_src->decrypt_failed   = 0;
+    io_src->hugepages        = PGM_DEFAULT_HUGEPAGES;
+    io_src->allocator        = NULL;
+    io_src->droppable_port   = PGM_DEFAULT_DROPPABLE_PORT;
+    io_src->droppable_transport = NULL;
+    g_queue_init (&io_src->tier_ready);
+    g_queue_init (&io_src->tier_held);
+    io_src->tier_held_bytes = 0;
+    io_src->streams          = g_hash_table_new (g_direct_hash, g_direct_equal);
+    io_src->provide_clock    = FALSE;
+    io_src->latency          = PGM_DEFAULT_LATENCY;
+    io_src->clock            = gst_pgm_clock_new ("pgmclock");
+    io_src->clock_synced     = FALSE;
+    io_src->remote_base_time = GST_CLOCK_TIME_NONE;
+    gst_pgm_clock_filter_reset (&io_src->clock_filter);
 
 /* ensure source provides live, time based output, with timestamps */
     gst_base_src_set_live (GST_BASE_SRC (io_src), TRUE);
     gst_base_src_set_format (GST_BASE_SRC (io_src), GST_FORMAT_TIME);
     gst_base_src_set_do_timestamp (GST_BASE_SRC (io_src), TRUE);
+    io_src->do_timestamp_auto = TRUE;
 }
 
 static void gst_pgm_src_finalize (GObject* io_obj)
@@ -436,6 +968,20 @@ static void gst_pgm_src_finalize (GObject* io_obj)
 
   g_free (src->network);
   g_free (src->uri);
+  g_free (src->redundant_network);
+  g_free (src->standby_uris);
+  g_free (src->native_caps);
+  g_free (src->capture_location);
+  g_byte_array_free (src->shm_record, TRUE);
+  g_free (src->keys);
+  gst_pgm_crypto_unref (src->crypto);
+  gst_object_unref (src->clock);
+  g_hash_table_destroy (src->streams);
+  gst_pgm_inflate_clear (&src->main_inflate);
+
+  if (src->stats) gst_structure_free (src->stats);
+  g_hash_table_destroy (src->senders);
+  if (src->peers) g_ptr_array_unref (src->peers);
 
   G_OBJECT_CLASS(gst_pgm_src_parent_class)->finalize(io_obj);
 }
@@ -452,6 +998,30 @@ static GstCaps* gst_pgm_src_get_caps (GstBaseSrc* i_basesrc, GstCaps* i_filter)
   return gst_caps_ref(src->caps);
 }
 
+/* keys that do not parse leave no crypto behind, everything is dropped
+ * rather than taken as clear text
+ */
+static void gst_pgm_src_set_keys (GstPgmSrc* io_src, const gchar* i_keys)
+{
+  GstPgmCrypto* crypto = NULL;
+  GError* err = NULL;
+
+  if (i_keys && NULL == (crypto = gst_pgm_crypto_new (i_keys, &err)))
+  {
+    GST_WARNING_OBJECT (io_src, "invalid keys: %s", err->message);
+    g_error_free (err);
+  }
+
+  GST_OBJECT_LOCK (io_src);
+  GstPgmCrypto* old = io_src->crypto;
+  g_free (io_src->keys);
+  io_src->keys   = g_strdup (i_keys);
+  io_src->crypto = crypto;
+  GST_OBJECT_UNLOCK (io_src);
+
+  gst_pgm_crypto_unref (old);
+}
+
 static void gst_pgm_src_set_property (GObject* io_obj, guint i_propId, const GValue* i_value, GParamSpec* i_pspec)
 {
   GstPgmSrc* src = GST_PGM_SRC (io_obj);
@@ -460,6 +1030,7 @@ static void gst_pgm_src_set_property (GObject* io_obj, guint i_propId, const GVa
   {
 
   case PROP_NETWORK:
+    GST_OBJECT_LOCK (src);
     g_free (src->network);
     if (g_value_get_string (i_value) == NULL)
     {
@@ -470,16 +1041,24 @@ static void gst_pgm_src_set_property (GObject* io_obj, guint i_propId, const GVa
       src->network = g_value_dup_string (i_value);
     }
     gst_pgm_src_update_uri (src);
+    GST_OBJECT_UNLOCK (src);
+    gst_pgm_src_request_switch (src);
     break;
 
   case PROP_PORT:
+    GST_OBJECT_LOCK (src);
     src->port = g_value_get_uint (i_value);
     gst_pgm_src_update_uri (src);
+    GST_OBJECT_UNLOCK (src);
+    gst_pgm_src_request_switch (src);
     break;
 
   case PROP_UDP_ENCAP_PORT:
+    GST_OBJECT_LOCK (src);
     src->udp_encap_port = g_value_get_uint (i_value);
     gst_pgm_src_update_uri (src);
+    GST_OBJECT_UNLOCK (src);
+    gst_pgm_src_request_switch (src);
     break;
   
   case PROP_URI:
@@ -489,6 +1068,7 @@ static void gst_pgm_src_set_property (GObject* io_obj, guint i_propId, const GVa
   case PROP_CAPS:
   {
     const GstCaps* new_caps_value = gst_value_get_caps (i_value);
+    src->caps_fixed = (new_caps_value != NULL);
     GstCaps* new_caps = new_caps_value ? gst_caps_copy (new_caps_value) : gst_caps_new_any();
     GstCaps* old_caps = src->caps;
     src->caps = new_caps; 
@@ -504,42 +1084,156 @@ static void gst_pgm_src_set_property (GObject* io_obj, guint i_propId, const GVa
   
   case PROP_MAX_TPDU:
     src->max_tpdu = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
   
   case PROP_HOPS:
     src->hops = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
   
   case PROP_RXW_SQNS:
     src->rxw_sqns = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
-  
-  case PROP_PEER_EXPIRY:
-    src->peer_expiry = g_value_get_uint (i_value);
+
+  case PROP_RXW_SECS:
+    src->rxw_secs = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
-  
-  case PROP_SPMR_EXPIRY:
-    src->spmr_expiry = g_value_get_uint (i_value);
+
+  case PROP_MAX_RATE:
+    src->max_rate = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
-  
-  case PROP_NAK_BO_IVL:
-    src->nak_bo_ivl = g_value_get_uint (i_value);
+
+  case PROP_WINDOW_BUDGET:
+    src->window_budget = g_value_get_uint64 (i_value);
+    src->transport_dirty = TRUE;
     break;
-  
-  case PROP_NAK_RPT_IVL:
-    src->nak_rpt_ivl = g_value_get_uint (i_value);
+
+  case PROP_CONGESTION_CONTROL:
+    src->congestion_control = g_value_get_enum (i_value);
+    src->transport_dirty = TRUE;
     break;
-  
-  case PROP_NAK_RDATA_IVL:
-    src->nak_rdata_ivl = g_value_get_uint (i_value);
+
+  case PROP_PROVIDE_CLOCK:
+    src->provide_clock = g_value_get_boolean (i_value);
+    if (src->provide_clock) GST_OBJECT_FLAG_SET (src, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+    else GST_OBJECT_FLAG_UNSET (src, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
     break;
-  
+
+  case PROP_LATENCY:
+    src->latency = g_value_get_uint (i_value);
+    break;
+
+  case PROP_DROPPABLE_PORT:
+    src->droppable_port = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+
+  case PROP_WAIT_KEYFRAME:
+    src->wait_keyframe = g_value_get_boolean (i_value);
+    break;
+
+  case PROP_CAPTURE_LOCATION:
+    g_free (src->capture_location);
+    src->capture_location = g_value_dup_string (i_value);
+    break;
+
+  case PROP_SHM:
+    src->use_shm = g_value_get_boolean (i_value);
+    break;
+
+  case PROP_KEYS:
+    gst_pgm_src_set_keys (src, g_value_get_string (i_value));
+    break;
+
+  case PROP_HUGEPAGES:
+    src->hugepages = g_value_get_boolean (i_value);
+    src->transport_dirty = TRUE;
+    break;
+
+  case PROP_STATS_INTERVAL:
+    g_atomic_int_set (&src->stats_interval, g_value_get_uint (i_value));
+    break;
+
+  case PROP_PEER_THRESHOLD:
+    src->peer_threshold = g_value_get_uint (i_value);
+    break;
+  
+  case PROP_PEER_EXPIRY:
+    src->peer_expiry = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+  
+  case PROP_SPMR_EXPIRY:
+    src->spmr_expiry = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+  
+  case PROP_NAK_BO_IVL:
+    src->nak_bo_ivl = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+  
+  case PROP_NAK_RPT_IVL:
+    src->nak_rpt_ivl = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+  
+  case PROP_NAK_RDATA_IVL:
+    src->nak_rdata_ivl = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+  
+  case PROP_NAK_ADAPTIVE:
+    GST_OBJECT_LOCK (src);
+    src->nak_adaptive = g_value_get_boolean (i_value);
+    if (!src->nak_adaptive && src->nak_estimated)
+    {
+      /* back to the configured intervals */
+      src->nak_estimated   = FALSE;
+      src->transport_dirty = TRUE;
+    }
+    GST_OBJECT_UNLOCK (src);
+    break;
+
+  case PROP_NAK_ADAPT_MIN:
+    src->nak_adapt_min = g_value_get_uint (i_value);
+    break;
+
+  case PROP_NAK_ADAPT_MAX:
+    src->nak_adapt_max = g_value_get_uint (i_value);
+    break;
+
   case PROP_NAK_DATA_RETRIES:
     src->nak_data_retries = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
     break;
   
   case PROP_NAK_NCF_RETRIES:
     src->nak_ncf_retries = g_value_get_uint (i_value);
+    src->transport_dirty = TRUE;
+    break;
+
+  case PROP_REDUNDANT_NETWORK:
+    g_free (src->redundant_network);
+    src->redundant_network = g_value_dup_string (i_value);
+
+    src->transport_dirty = TRUE;
+    break;
+
+  case PROP_FRAMING:
+    src->framing     = g_value_get_enum (i_value);
+    src->framing_set = TRUE;
+    break;
+
+  case PROP_STANDBY_URIS:
+    g_free (src->standby_uris);
+    src->standby_uris = g_value_dup_string (i_value);
+
+    src->transport_dirty = TRUE;
     break;
 
   default:
@@ -555,7 +1249,9 @@ static void gst_pgm_src_get_property (GObject* io_obj, guint i_propId, GValue* o
   switch (i_propId) 
   {
   case PROP_NETWORK:
+    GST_OBJECT_LOCK (src);
     g_value_set_string (o_value, src->network);
+    GST_OBJECT_UNLOCK (src);
     break;
   case PROP_PORT:
     g_value_set_uint (o_value, src->port);
@@ -564,7 +1260,9 @@ static void gst_pgm_src_get_property (GObject* io_obj, guint i_propId, GValue* o
     g_value_set_uint (o_value, src->udp_encap_port);
     break;
   case PROP_URI:
+    GST_OBJECT_LOCK (src);
     g_value_set_string (o_value, src->uri);
+    GST_OBJECT_UNLOCK (src);
     break;
   case PROP_CAPS:
     gst_value_set_caps (o_value, src->caps);
@@ -578,6 +1276,64 @@ static void gst_pgm_src_get_property (GObject* io_obj, guint i_propId, GValue* o
   case PROP_RXW_SQNS:
     g_value_set_uint (o_value, src->rxw_sqns);
     break;
+  case PROP_RXW_SECS:
+    g_value_set_uint (o_value, src->rxw_secs);
+    break;
+  case PROP_MAX_RATE:
+    g_value_set_uint (o_value, src->max_rate);
+    break;
+  case PROP_WINDOW_BUDGET:
+    g_value_set_uint64 (o_value, src->window_budget);
+    break;
+  case PROP_CONGESTION_CONTROL:
+    g_value_set_enum (o_value, src->congestion_control);
+    break;
+  case PROP_PROVIDE_CLOCK:
+    g_value_set_boolean (o_value, src->provide_clock);
+    break;
+  case PROP_LATENCY:
+    g_value_set_uint (o_value, src->latency);
+    break;
+  case PROP_DROPPABLE_PORT:
+    g_value_set_uint (o_value, src->droppable_port);
+    break;
+  case PROP_WAIT_KEYFRAME:
+    g_value_set_boolean (o_value, src->wait_keyframe);
+    break;
+  case PROP_CAPTURE_LOCATION:
+    g_value_set_string (o_value, src->capture_location);
+    break;
+  case PROP_SHM:
+    g_value_set_boolean (o_value, src->use_shm);
+    break;
+  case PROP_HUGEPAGES:
+    g_value_set_boolean (o_value, src->hugepages);
+    break;
+  case PROP_ALLOCATOR_STATS:
+  {
+    /* open and close swap the allocator under the object lock */
+    GST_OBJECT_LOCK (src);
+    GstAllocator* allocator = src->allocator ? gst_object_ref (src->allocator) : NULL;
+    GST_OBJECT_UNLOCK (src);
+
+    g_value_take_boxed (o_value, allocator ? gst_pgm_allocator_get_stats (allocator) : NULL);
+    if (allocator) gst_object_unref (allocator);
+    break;
+  }
+  case PROP_PEER_THRESHOLD:
+    g_value_set_uint (o_value, src->peer_threshold);
+    break;
+  case PROP_PEERS:
+    GST_OBJECT_LOCK (src);
+    for (guint i = 0; src->peers && i < src->peers->len; ++i)
+    {
+      GValue peer = G_VALUE_INIT;
+      g_value_init (&peer, GST_TYPE_STRUCTURE);
+      g_value_set_boxed (&peer, g_ptr_array_index (src->peers, i));
+      gst_value_array_append_and_take_value (o_value, &peer);
+    }
+    GST_OBJECT_UNLOCK (src);
+    break;
   case PROP_PEER_EXPIRY:
     g_value_set_uint (o_value, src->peer_expiry);
     break;
@@ -599,267 +1355,2162 @@ static void gst_pgm_src_get_property (GObject* io_obj, guint i_propId, GValue* o
   case PROP_NAK_NCF_RETRIES:
     g_value_set_uint (o_value, src->nak_ncf_retries);
     break;
+  case PROP_REDUNDANT_NETWORK:
+    g_value_set_string (o_value, src->redundant_network);
+    break;
+  case PROP_FRAMING:
+    g_value_set_enum (o_value, src->framing);
+    break;
+  case PROP_STANDBY_URIS:
+    g_value_set_string (o_value, src->standby_uris);
+    break;
+  case PROP_STATS_INTERVAL:
+    g_value_set_uint (o_value, g_atomic_int_get (&src->stats_interval));
+    break;
+  case PROP_STATS:
+    GST_OBJECT_LOCK (src);
+    g_value_set_boxed (o_value, src->stats);
+    GST_OBJECT_UNLOCK (src);
+    break;
+  case PROP_NAK_ADAPTIVE:
+    g_value_set_boolean (o_value, src->nak_adaptive);
+    break;
+  case PROP_NAK_ADAPT_MIN:
+    g_value_set_uint (o_value, src->nak_adapt_min);
+    break;
+  case PROP_NAK_ADAPT_MAX:
+    g_value_set_uint (o_value, src->nak_adapt_max);
+    break;
+  case PROP_REPAIR_RTT:
+    GST_OBJECT_LOCK (src);
+    g_value_set_uint (o_value, src->repair_rtt);
+    GST_OBJECT_UNLOCK (src);
+    break;
+  case PROP_EFFECTIVE_NAK_BO_IVL:
+    GST_OBJECT_LOCK (src);
+    g_value_set_uint (o_value, src->nak_effective.bo_ivl);
+    GST_OBJECT_UNLOCK (src);
+    break;
+  case PROP_EFFECTIVE_NAK_RPT_IVL:
+    GST_OBJECT_LOCK (src);
+    g_value_set_uint (o_value, src->nak_effective.rpt_ivl);
+    GST_OBJECT_UNLOCK (src);
+    break;
+  case PROP_EFFECTIVE_NAK_RDATA_IVL:
+    GST_OBJECT_LOCK (src);
+    g_value_set_uint (o_value, src->nak_effective.rdata_ivl);
+    GST_OBJECT_UNLOCK (src);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (io_obj, i_propId, i_pspec);
     break;
   }
 }
 
-/* GstPushSrcClass::create
- *
- * As a GStreamer source, create data, so recv on PGM transport.
+/* Copies of one APDU may arrive over several paths: the first copy of a
+ * sequence number is delivered, later copies are dropped.
  */
-static GstFlowReturn gst_pgm_src_create ( GstPushSrc* pushsrc, GstBuffer** buffer)
+static gboolean gst_pgm_src_merge_sequence (GstPgmSrc* io_src, guint32 i_sequence)
 {
-  GstPgmSrc* src = GST_PGM_SRC(pushsrc);
+  if (io_src->have_sequence)
+  {
+    const gint32 diff = GST_PGM_FRAME_SEQUENCE_DIFF (i_sequence, io_src->next_sequence);
 
-  /* read in waiting data */
-  struct pgm_msgv_t msgv;
-  size_t len;
-  struct pgm_error_t* pErr = NULL;
-  int status = pgm_recvmsg (src->sock, &msgv, 0, &len, &pErr);
+    if (diff < 0 && diff > -PGM_SRC_MERGE_WINDOW) return FALSE;
 
-  if (PGM_IO_STATUS_NORMAL != status) 
-  {
-    puts ("read not normal");
-    GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("Receive error: %s)", pErr->message));
-    pgm_error_free (pErr);
-    return GST_FLOW_ERROR;
+    if (diff != 0)
+    {
+      GST_DEBUG_OBJECT (io_src, "sequence jump of %d APDUs", diff);
+      io_src->discont = TRUE;
+    }
   }
-
-  /* try to allocate memory from GStreamer pool */
-  *buffer = gst_buffer_new_and_alloc (len);
-  if (NULL == *buffer)
+  else
   {
-    puts ("Could not allocate a buffer?!");
-    return GST_FLOW_ERROR;
+    io_src->discont = TRUE;
   }
 
-  /* return contiguous copy */
-  GstMapInfo map;
-  gst_buffer_map (*buffer, &map, (GstMapFlags)GST_MAP_READWRITE);
-  guint8* dst = map.data;
-  for (unsigned j = 0; j < msgv.msgv_len; j++)
-  {
-    memcpy (dst, msgv.msgv_skb[j]->data, msgv.msgv_skb[j]->len);
-    dst += msgv.msgv_skb[j]->len;
-    len -= msgv.msgv_skb[j]->len;
-  }
-  gst_buffer_unmap (*buffer, &map);
+  io_src->have_sequence = TRUE;
+  io_src->next_sequence = i_sequence + 1;
+  return TRUE;
+}
 
-  //?gst_buffer_set_caps (GST_BUFFER_CAST (*buffer), src->caps);
+/* Native framing: the elementary stream an APDU was tagged with, its pad
+ * appears with the first caps.
+ */
+static GstPgmSrcStream* gst_pgm_src_stream_get (GstPgmSrc* io_src, guint16 i_id)
+{
+  GstPgmSrcStream* stream = g_hash_table_lookup (io_src->streams, GUINT_TO_POINTER (i_id));
 
-  return GST_FLOW_OK;
+  if (NULL == stream)
+  {
+    stream = g_new (GstPgmSrcStream, 1);
+    stream->id      = i_id;
+    stream->pad     = NULL;
+    stream->caps    = NULL;
+    stream->discont = TRUE;
+    stream->end     = GST_CLOCK_TIME_NONE;
+    stream->waiting = io_src->wait_keyframe;
+    stream->droppable_lost = FALSE;
+    gst_pgm_inflate_init (&stream->inflate);
+    gst_segment_init (&stream->segment, GST_FORMAT_TIME);
+    g_hash_table_insert (io_src->streams, GUINT_TO_POINTER (i_id), stream);
+  }
+  return stream;
 }
 
-/* create PGM transport 
- */
-static gboolean gst_pgm_client_src_start ( GstBaseSrc* basesrc)
+static void gst_pgm_src_stream_caps (GstPgmSrc* io_src, GstPgmSrcStream* io_stream, const GstPgmFrameHeader* i_frame)
 {
-  GstPgmSrc* src = GST_PGM_SRC (basesrc);
+  if (io_stream->caps && strlen (io_stream->caps) == i_frame->caps_len 
+      && 0 == memcmp (io_stream->caps, i_frame->caps, i_frame->caps_len)) return;
 
-  const int valTrue  = 1;
-  const int valFalse = 0;
+  gchar* caps_string = g_strndup (i_frame->caps, i_frame->caps_len);
+  GstCaps* caps = gst_caps_from_string (caps_string);
+  if (NULL == caps)
+  {
+    GST_WARNING_OBJECT (io_src, "cannot parse caps %s of stream %u", caps_string, io_stream->id);
+    g_free (caps_string);
+    return;
+  }
+  g_free (io_stream->caps);
+  io_stream->caps = caps_string;
 
-	sa_family_t sa_family = AF_UNSPEC;
-  struct pgm_addrinfo_t* res = NULL;
-  struct pgm_error_t* pErr = NULL;
+  if (NULL == io_stream->pad)
+  {
+    GstElementClass* klass = GST_ELEMENT_GET_CLASS (io_src);
+    gchar* name = g_strdup_printf ("src_%u", io_stream->id);
+    io_stream->pad = gst_pad_new_from_template (gst_element_class_get_pad_template (klass, "src_%u"), name);
+    g_free (name);
 
-	if (!pgm_init (&pErr)) {
-		g_error ("Unable to start PGM engine: %s", pErr->message);
-		pgm_error_free (pErr);
-		goto destroy_transport;
-	}
+    gst_pad_use_fixed_caps (io_stream->pad);
+    gst_pad_set_active (io_stream->pad, TRUE);
+
+    gchar* stream_id = gst_pad_create_stream_id_printf (io_stream->pad, GST_ELEMENT_CAST (io_src), "%u", io_stream->id);
+    gst_pad_push_event (io_stream->pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
 
-  if (!pgm_getaddrinfo (src->network, NULL, &res, &pErr)) 
+    gst_pad_push_event (io_stream->pad, gst_event_new_caps (caps));
+    gst_pad_push_event (io_stream->pad, gst_event_new_segment (&io_stream->segment));
+    gst_element_add_pad (GST_ELEMENT_CAST (io_src), io_stream->pad);
+
+    GST_DEBUG_OBJECT (io_src, "stream %u appeared with caps %s", io_stream->id, caps_string);
+  }
+  else
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("Parsing network parameter: %s", pErr->message));
-    pgm_error_free (pErr);
-    return FALSE;
+    gst_pad_push_event (io_stream->pad, gst_event_new_caps (caps));
   }
+  gst_caps_unref (caps);
+}
 
-	sa_family = res->ai_send_addrs[0].gsr_group.ss_family;
+/* drop the stream pads, they come back with the data */
+static void gst_pgm_src_remove_streams (GstPgmSrc* io_src)
+{
+  GHashTableIter iter;
+  gpointer value;
 
-  if (!pgm_socket (&src->sock, sa_family, SOCK_SEQPACKET, IPPROTO_UDP, &pErr)) 
+  g_hash_table_iter_init (&iter, io_src->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("Creating transport: %s", pErr->message));
-    pgm_error_free (pErr);
-    pgm_freeaddrinfo (res);
-    return FALSE;
+    GstPgmSrcStream* stream = value;
+    if (stream->pad)
+    {
+      gst_pad_set_active (stream->pad, FALSE);
+      gst_element_remove_pad (GST_ELEMENT_CAST (io_src), stream->pad);
+    }
+    g_free (stream->caps);
+    gst_pgm_inflate_clear (&stream->inflate);
+    g_free (stream);
   }
+  g_hash_table_remove_all (io_src->streams);
+}
+
+/* Native framing: take over caps that changed on the sender, unless they
+ * were given as a property.
+ */
+static void gst_pgm_src_native_caps (GstPgmSrc* io_src, const GstPgmFrameHeader* i_frame)
+{
+  if (io_src->caps_fixed) return;
+  if (io_src->native_caps && strlen (io_src->native_caps) == i_frame->caps_len 
+      && 0 == memcmp (io_src->native_caps, i_frame->caps, i_frame->caps_len)) return;
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_RECV_ONLY, &valTrue, sizeof(valTrue))) 
+  gchar* caps_string = g_strndup (i_frame->caps, i_frame->caps_len);
+  GstCaps* caps = gst_caps_from_string (caps_string);
+  if (NULL == caps)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set receive-only mode"));
-    goto destroy_transport;
+    GST_WARNING_OBJECT (io_src, "cannot parse caps %s", caps_string);
+    g_free (caps_string);
+    return;
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_MTU, &src->max_tpdu, sizeof(src->max_tpdu))) 
+  GST_DEBUG_OBJECT (io_src, "caps from sender %s", caps_string);
+  g_free (io_src->native_caps);
+  io_src->native_caps = caps_string;
+
+  GstCaps* old_caps = io_src->caps;
+  io_src->caps = caps;
+  if (old_caps) gst_caps_unref (old_caps);
+
+  gst_base_src_set_caps (GST_BASE_SRC (io_src), caps);
+}
+
+/* Forget the sender clock, a new session may bring another one.
+ */
+static void gst_pgm_src_clock_reset (GstPgmSrc* io_src)
+{
+  io_src->clock_synced     = FALSE;
+  io_src->remote_base_time = GST_CLOCK_TIME_NONE;
+  gst_pgm_clock_filter_reset (&io_src->clock_filter);
+}
+
+/* Native framing: a sample of the sender clock. The arrival time is when
+ * OpenPGM read the packet, not when the APDU was taken from it.
+ */
+static void gst_pgm_src_observe_clock (GstPgmSrc* io_src, const GstPgmFrameHeader* i_frame, const struct pgm_msgv_t* i_msgv)
+{
+  const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[i_msgv->msgv_len - 1];
+  const pgm_time_t queued = pgm_time_update_now () - skb->tstamp;
+  const GstClockTime local = gst_clock_get_internal_time (io_src->clock) - queued * GST_USECOND;
+  GstClockTime internal;
+  GstClockTime external;
+  gdouble r_squared;
+
+  io_src->remote_base_time = i_frame->base_time;
+
+  if (!gst_pgm_clock_filter_push (&io_src->clock_filter, local, i_frame->clock_time, &internal, &external)) return;
+
+  if (gst_clock_add_observation (io_src->clock, internal, external, &r_squared))
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set maximum TPDU size"));
-    goto destroy_transport;
+    GST_LOG_OBJECT (io_src, "clock observation, r squared %f", r_squared);
+    io_src->clock_synced = TRUE;
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_MULTICAST_LOOP, &valTrue, sizeof(valTrue))) 
+}
+
+/* Native framing: the sender's running time is moved onto ours. On the
+ * sender's clock that is its base time against ours, so all receivers play
+ * out together. Otherwise it is anchored at the first timestamped APDU
+ * after a start or channel switch.
+ */
+static GstClockTime gst_pgm_src_native_time (GstPgmSrc* io_src, GstClockTime i_remote)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (i_remote)) return GST_CLOCK_TIME_NONE;
+
+  if (io_src->clock_synced && GST_CLOCK_TIME_IS_VALID (io_src->remote_base_time))
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set multicast loop"));
-    goto destroy_transport;
+    GstClock* clock = gst_element_get_clock (GST_ELEMENT_CAST (io_src));
+    const gboolean own = (clock == io_src->clock);
+    if (clock) gst_object_unref (clock);
+
+    if (own)
+    {
+      const gint64 local = (gint64) (i_remote + io_src->remote_base_time) - (gint64) gst_element_get_base_time (GST_ELEMENT_CAST (io_src));
+      return local > 0 ? (GstClockTime) local : 0;
+    }
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &src->hops, sizeof(src->hops))) 
+
+  if (!io_src->have_ts_offset)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set IP hop limit"));
-    goto destroy_transport;
+    GstClock* clock = gst_element_get_clock (GST_ELEMENT_CAST (io_src));
+    gint64 now = (gint64) i_remote;
+
+    if (clock)
+    {
+      now = (gint64) (gst_clock_get_time (clock) - gst_element_get_base_time (GST_ELEMENT_CAST (io_src)));
+      gst_object_unref (clock);
+    }
+    io_src->ts_offset = now - (gint64) i_remote;
+    io_src->have_ts_offset = TRUE;
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_RXW_SQNS, &src->rxw_sqns, sizeof(src->rxw_sqns))) 
+  const gint64 local = (gint64) i_remote + io_src->ts_offset;
+  return local > 0 ? (GstClockTime) local : 0;
+}
+
+/* Whether a decoder can start at this buffer: not if native framing
+ * flagged it a delta unit, otherwise as far as its RTP payload tells.
+ */
+static gboolean gst_pgm_src_is_key_unit (GstPgmSrc* io_src, GstPgmSrcStream* i_stream, GstBuffer* i_buffer)
+{
+  if (GST_BUFFER_FLAG_IS_SET (i_buffer, GST_BUFFER_FLAG_DELTA_UNIT)) return FALSE;
+
+  GstCaps* caps = i_stream ? gst_pad_get_current_caps (i_stream->pad) : io_src->caps ? gst_caps_ref (io_src->caps) : NULL;
+  const GstPgmKeyframeCodec codec = gst_pgm_keyframe_codec (caps);
+  if (caps) gst_caps_unref (caps);
+
+  if (GST_PGM_KEYFRAME_UNKNOWN == codec) return TRUE;
+
+  GstMapInfo map;
+  gst_buffer_map (i_buffer, &map, GST_MAP_READ);
+  const gboolean key = gst_pgm_keyframe_rtp_is_key (codec, map.data, map.size);
+  gst_buffer_unmap (i_buffer, &map);
+
+  return key;
+}
+
+/* an APDU that is not sealed with one of our keys is as good as lost
+ */
+static gboolean gst_pgm_src_drop_unauthentic (GstPgmSrc* io_src)
+{
+  GST_LOG_OBJECT (io_src, "dropping APDU that does not authenticate");
+  io_src->decrypt_failed++;
+  if (GST_PGM_FRAMING_RAW == io_src->framing) io_src->discont = TRUE;
+  return FALSE;
+}
+
+/* Turn one received APDU into a buffer, FALSE if it is a duplicate.
+ */
+static gboolean gst_pgm_src_take_apdu (GstPgmSrc* io_src, const struct pgm_msgv_t* i_msgv, size_t i_len, GstPgmSrcApdu* o_apdu)
+{
+  GstPgmSrcStream* stream = NULL;
+  GstPgmFrameHeader frame;
+  gsize size = i_len;
+
+  GST_OBJECT_LOCK (io_src);
+  const gboolean decrypt = NULL != io_src->keys;
+  GstPgmCrypto* crypto = io_src->crypto ? gst_pgm_crypto_ref (io_src->crypto) : NULL;
+  GST_OBJECT_UNLOCK (io_src);
+
+  if (decrypt)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set RXW_SQNS"));
-    goto destroy_transport;
+    if (NULL == crypto || i_len < GST_PGM_CRYPTO_OVERHEAD)
+    {
+      gst_pgm_crypto_unref (crypto);
+      return gst_pgm_src_drop_unauthentic (io_src);
+    }
+    size = i_len - GST_PGM_CRYPTO_OVERHEAD;
   }
-
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_PEER_EXPIRY, &src->peer_expiry, sizeof(src->peer_expiry))) 
+  /* sealed, the frame header can only be read once decrypted */
+  else if (GST_PGM_FRAMING_RAW != io_src->framing)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set peer expiration timeout"));
-    goto destroy_transport;
+    const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[0];
+
+    if (!gst_pgm_frame_read_header (skb->data, skb->len, &frame))
+    {
+      GST_WARNING_OBJECT (io_src, "dropping APDU without frame header");
+      return FALSE;
+    }
+
+    /* with a droppable session, gaps are expected and ordering is done by
+     * gst_pgm_src_merge_tiers */
+    if (!io_src->tiered && !gst_pgm_src_merge_sequence (io_src, frame.sequence)) return FALSE;
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_SPMR_EXPIRY, &src->spmr_expiry, sizeof(src->spmr_expiry))) 
+  GstBuffer* buffer = gst_buffer_new_allocate (io_src->allocator, size, NULL);
+  if (NULL == buffer)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set SPMR timeout"));
-    goto destroy_transport;
+    GST_WARNING_OBJECT (io_src, "cannot allocate a buffer of %" G_GSIZE_FORMAT " bytes, APDU dropped", size);
+    gst_pgm_crypto_unref (crypto);
+    return FALSE;
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_NAK_BO_IVL, &src->nak_bo_ivl, sizeof(src->nak_bo_ivl))) 
+  GstMapInfo map;
+  gst_buffer_map (buffer, &map, (GstMapFlags)GST_MAP_READWRITE);
+
+  if (decrypt)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_BO_IVL"));
-    goto destroy_transport;
-  }
+    /* decrypted on the way out of the fragments, in place of the copy */
+    const gboolean authentic = gst_pgm_crypto_open (crypto, i_msgv, i_len, map.data);
+    gst_pgm_crypto_unref (crypto);
+
+    if (!authentic)
+    {
+      gst_buffer_unmap (buffer, &map);
+      gst_buffer_unref (buffer);
+      return gst_pgm_src_drop_unauthentic (io_src);
+    }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_NAK_RPT_IVL, &src->nak_rpt_ivl, sizeof(src->nak_rpt_ivl))) 
+    if (GST_PGM_FRAMING_RAW != io_src->framing)
+    {
+      gboolean keep = gst_pgm_frame_read_header (map.data, map.size, &frame);
+      if (!keep) GST_WARNING_OBJECT (io_src, "dropping APDU without frame header");
+      else if (!io_src->tiered) keep = gst_pgm_src_merge_sequence (io_src, frame.sequence);
+
+      if (!keep)
+      {
+        gst_buffer_unmap (buffer, &map);
+        gst_buffer_unref (buffer);
+        return FALSE;
+      }
+    }
+  }
+  else
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_RPT_IVL"));
-    goto destroy_transport;
+    /* return contiguous copy */
+    guint8* dst = map.data;
+    for (unsigned j = 0; j < i_msgv->msgv_len; j++)
+    {
+      memcpy (dst, i_msgv->msgv_skb[j]->data, i_msgv->msgv_skb[j]->len);
+      dst += i_msgv->msgv_skb[j]->len;
+    }
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_NAK_RDATA_IVL, &src->nak_rdata_ivl, sizeof(src->nak_rdata_ivl))) 
+
+  /* headers may run over several fragments, they are parsed from the
+   * contiguous copy */
+  gsize header_size = 0;
+  if (GST_PGM_FRAMING_RAW != io_src->framing)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_RDATA_IVL"));
-    goto destroy_transport;
+    header_size = gst_pgm_frame_read_fields (map.data, map.size, &frame);
+    if (0 == header_size)
+    {
+      gst_buffer_unmap (buffer, &map);
+      gst_buffer_unref (buffer);
+      GST_WARNING_OBJECT (io_src, "dropping APDU with truncated frame header");
+      return FALSE;
+    }
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_NAK_DATA_RETRIES, &src->nak_data_retries, sizeof(src->nak_data_retries))) 
+
+  if (GST_PGM_FRAMING_NATIVE == io_src->framing)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_DATA_RETRIES"));
-    goto destroy_transport;
+    if (frame.flags & GST_PGM_FRAME_FLAG_STREAM)
+    {
+      stream = gst_pgm_src_stream_get (io_src, frame.stream_id);
+      if (frame.caps) gst_pgm_src_stream_caps (io_src, stream, &frame);
+    }
+    else if (frame.caps) 
+    {
+      gst_pgm_src_native_caps (io_src, &frame);
+    }
+
+    if (stream ? NULL == stream->pad : NULL == io_src->caps)
+    {
+      gst_buffer_unmap (buffer, &map);
+      gst_buffer_unref (buffer);
+      GST_LOG_OBJECT (io_src, "no caps from the sender yet, dropping APDU");
+      return FALSE;
+    }
+    if (io_src->provide_clock && (frame.flags & GST_PGM_FRAME_FLAG_CLOCK)) gst_pgm_src_observe_clock (io_src, &frame, i_msgv);
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_NAK_NCF_RETRIES, &src->nak_ncf_retries, sizeof(src->nak_ncf_retries))) 
+
+  /* compressed payloads come back in a buffer of their own */
+  GstBuffer* inflated = NULL;
+  if (GST_PGM_FRAMING_RAW != io_src->framing)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_NCF_RETRIES"));
-    goto destroy_transport;
+    GstPgmInflate* inflate = stream ? &stream->inflate : &io_src->main_inflate;
+
+    if (frame.flags & GST_PGM_FRAME_FLAG_DICTIONARY)
+    {
+      gst_pgm_inflate_dictionary (inflate, map.data + header_size, map.size - header_size);
+    }
+    if (frame.flags & GST_PGM_FRAME_FLAG_COMPRESSED)
+    {
+      inflated = gst_pgm_inflate (inflate, io_src->allocator, &frame, map.data + header_size, map.size - header_size);
+      if (NULL == inflated)
+      {
+        gst_buffer_unmap (buffer, &map);
+        gst_buffer_unref (buffer);
+        GST_LOG_OBJECT (io_src, "dropping APDU that does not decompress");
+        io_src->decompress_failed++;
+        /* only this stream lost something, its next key unit resumes it */
+        if (stream)
+        {
+          stream->discont = TRUE;
+          stream->waiting = io_src->wait_keyframe;
+        }
+        else
+        {
+          io_src->main_discont = TRUE;
+          io_src->main_waiting = io_src->wait_keyframe;
+        }
+        return FALSE;
+      }
+    }
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_UDP_ENCAP_UCAST_PORT, &src->udp_encap_port, sizeof(src->udp_encap_port)))
+  gst_buffer_unmap (buffer, &map);
+
+  if (inflated)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("cannot set UDP encap ucast port"));
-    goto destroy_transport;
+    gst_buffer_unref (buffer);
+    buffer = inflated;
   }
-  
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_UDP_ENCAP_MCAST_PORT, &src->udp_encap_port, sizeof(src->udp_encap_port)))
+  else if (header_size > 0)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("cannot set UDP encap mcast port"));
-    goto destroy_transport;
+    gst_buffer_resize (buffer, header_size, -1);
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_PASSIVE, &valFalse, sizeof(valFalse))) 
+  if (GST_PGM_FRAMING_NATIVE == io_src->framing)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("cannot unset passive"));
-    goto destroy_transport;
+    GST_BUFFER_PTS (buffer)      = gst_pgm_src_native_time (io_src, frame.pts);
+    GST_BUFFER_DTS (buffer)      = gst_pgm_src_native_time (io_src, frame.dts);
+    GST_BUFFER_DURATION (buffer) = frame.duration;
+    GST_BUFFER_FLAG_SET (buffer, frame.buffer_flags);
   }
 
-  if (!pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_IP_ROUTER_ALERT, &valFalse, sizeof(valFalse))) 
+  GstPgmMeta* meta = gst_buffer_add_pgm_meta (buffer, i_msgv);
+  if (meta && GST_PGM_FRAMING_RAW != io_src->framing && (frame.flags & GST_PGM_FRAME_FLAG_SENT))
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("cannot unset the router assist"));
-    goto destroy_transport;
+    meta->sent         = frame.sent;
+    meta->sender_queue = frame.sender_queue * GST_USECOND;
   }
 
-
-  struct pgm_sockaddr_t addr;
-  memset (&addr, '\0', sizeof(addr));
-  addr.sa_port = src->port;
-  addr.sa_addr.sport = DEFAULT_DATA_SOURCE_PORT;
-
-  if (!pgm_gsi_create_from_hostname (&addr.sa_addr.gsi, &pErr))
+  /* a gap in the session may have hit any of the streams */
+  if (io_src->discont)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("Creating GSI: %s", pErr->message));
-    pgm_error_free (pErr);
-    pgm_freeaddrinfo (res);
-    return FALSE;
-  }
+    GHashTableIter iter;
+    gpointer value;
 
-  struct pgm_interface_req_t ifReq;
-  memset (&ifReq, '\0', sizeof(ifReq));
-  ifReq.ir_interface = res->ai_recv_addrs[0].gsr_interface;
-  ifReq.ir_scope_id  = 0;
+    g_hash_table_iter_init (&iter, io_src->streams);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) 
+    {
+      GstPgmSrcStream* lost = value;
+      lost->discont = TRUE;
+      lost->waiting = io_src->wait_keyframe;
+    }
 
-	if (AF_INET6 == sa_family) 
-  {
-		struct sockaddr_in6 sa6;
-		memcpy (&sa6, &res->ai_recv_addrs[0].gsr_group, sizeof(sa6));
-		ifReq.ir_scope_id = sa6.sin6_scope_id;
-	}
+    io_src->main_discont = TRUE;
+    io_src->main_waiting = io_src->wait_keyframe;
+    io_src->discont = FALSE;
+  }
 
-  if (!pgm_bind3 ( src->sock
-                 , &addr, sizeof(addr)
-                 , &ifReq, sizeof(ifReq)  // tx interface
-                 , &ifReq, sizeof(ifReq)  // rx interface
-                 , &pErr
-                 )
-     )
+  /* decoders only choke on what comes before the next key unit, the
+   * DISCONT stays pending for that one */
+  gboolean* waiting = stream ? &stream->waiting : &io_src->main_waiting;
+  if (*waiting)
   {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("Binding transport: %s", pErr->message));
-    pgm_error_free (pErr);
-    goto destroy_transport;
+    if (!gst_pgm_src_is_key_unit (io_src, stream, buffer))
+    {
+      io_src->keyframe_skipped++;
+      gst_buffer_unref (buffer);
+      return FALSE;
+    }
+    GST_DEBUG_OBJECT (io_src, "key unit after %" G_GUINT64_FORMAT " skipped buffers", io_src->keyframe_skipped);
+    *waiting = FALSE;
   }
 
-	for (unsigned i = 0; i < res->ai_recv_addrs_len; ++i)
+  gboolean* discont = stream ? &stream->discont : &io_src->main_discont;
+  if (*discont)
   {
-		pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct group_req));
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    *discont = FALSE;
   }
-	pgm_setsockopt (src->sock, IPPROTO_PGM, PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct group_req));
-	pgm_freeaddrinfo (res);
 
-	if (!pgm_connect (src->sock, &pErr))
-  {
-    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("Connecting socket: %s", pErr->message));
-    pgm_error_free (pErr);
-    goto destroy_transport;
-	}
+  o_apdu->buffer    = buffer;
+  o_apdu->stream    = stream;
+  o_apdu->sequence  = frame.sequence;
+  o_apdu->anchor    = frame.anchor;
+  o_apdu->droppable = (GST_PGM_FRAMING_RAW != io_src->framing) && (frame.flags & GST_PGM_FRAME_FLAG_ANCHOR);
+
+  //?gst_buffer_set_caps (GST_BUFFER_CAST (*buffer), src->caps);
 
   return TRUE;
+}
 
-destroy_transport:
+static void gst_pgm_src_apdu_free (gpointer io_apdu)
+{
+  GstPgmSrcApdu* apdu = io_apdu;
 
-  pgm_close (src->sock, TRUE);
-  src->sock = NULL;
-  return FALSE;
+  gst_buffer_unref (apdu->buffer);
+  g_free (apdu);
 }
 
-/* destroy PGM transport 
- */
-static gboolean gst_pgm_client_src_stop (GstBaseSrc* io_basesrc)
+static GstPgmSrcApdu* gst_pgm_src_apdu_copy (const GstPgmSrcApdu* i_apdu)
 {
-  GstPgmSrc* src = GST_PGM_SRC (io_basesrc);
+  GstPgmSrcApdu* apdu = g_new (GstPgmSrcApdu, 1);
 
-  GST_DEBUG_OBJECT (src, "destroying transport");
+  *apdu = *i_apdu;
+  return apdu;
+}
+
+/* Sequence numbers are shared by all streams, a gap in them does not tell
+ * whose droppable APDU it was. Every pad hears about it, gst_pgm_src_deliver
+ * only pushes a gap where its own buffers leave one.
+ */
+static void gst_pgm_src_droppable_lost (GstPgmSrc* io_src, gboolean i_lost)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  io_src->main_droppable_lost = i_lost;
+  g_hash_table_iter_init (&iter, io_src->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    ((GstPgmSrcStream*) value)->droppable_lost = i_lost;
+  }
+}
+
+static void gst_pgm_src_tier_ready (GstPgmSrc* io_src, const GstPgmSrcApdu* i_apdu)
+{
+  g_queue_push_tail (&io_src->tier_ready, gst_pgm_src_apdu_copy (i_apdu));
+}
+
+/* Droppable APDUs that were waiting for a reliable one before i_sequence
+ * can go, in order.
+ */
+static void gst_pgm_src_tier_release (GstPgmSrc* io_src, guint32 i_sequence, gboolean i_anchored)
+{
+  while (!g_queue_is_empty (&io_src->tier_held))
+  {
+    GstPgmSrcApdu* held = g_queue_peek_head (&io_src->tier_held);
+
+    const gboolean due = i_anchored 
+                       ? GST_PGM_FRAME_SEQUENCE_DIFF (held->anchor, i_sequence) <= 0
+                       : GST_PGM_FRAME_SEQUENCE_DIFF (held->sequence, i_sequence) < 0;
+    if (!due) break;
+
+    g_queue_pop_head (&io_src->tier_held);
+    io_src->tier_held_bytes -= gst_buffer_get_size (held->buffer);
+    if (GST_PGM_FRAME_SEQUENCE_DIFF (held->sequence, io_src->next_sequence) > 0) gst_pgm_src_droppable_lost (io_src, TRUE);
+    io_src->next_sequence = held->sequence + 1;
+    g_queue_push_tail (&io_src->tier_ready, held);
+  }
+}
+
+/* Put the reliable and the droppable session back into sending order.
+ * Reliable APDUs arrive complete and in order and are never held back.
+ * A droppable one follows the reliable APDU it was sent after, and waits
+ * for it if it is still being repaired. What arrives after its place in
+ * the order has passed is late and dropped, and what never arrives leaves
+ * a gap downstream.
+ */
+static void gst_pgm_src_merge_tiers (GstPgmSrc* io_src, GstPgmSrcApdu* io_apdu)
+{
+  if (!io_apdu->droppable)
+  {
+    if (io_src->have_anchor && GST_PGM_FRAME_SEQUENCE_DIFF (io_apdu->sequence, io_src->anchor) <= 0)
+    {
+      gst_buffer_unref (io_apdu->buffer);  // copy from the redundant path
+      return;
+    }
+
+    gst_pgm_src_tier_release (io_src, io_apdu->sequence, FALSE);
+
+    if (io_src->have_anchor && GST_PGM_FRAME_SEQUENCE_DIFF (io_apdu->sequence, io_src->next_sequence) > 0) gst_pgm_src_droppable_lost (io_src, TRUE);
+    io_src->have_anchor   = TRUE;
+    io_src->anchor        = io_apdu->sequence;
+    io_src->next_sequence = io_apdu->sequence + 1;
+    gst_pgm_src_tier_ready (io_src, io_apdu);
+
+    gst_pgm_src_tier_release (io_src, io_apdu->sequence, TRUE);
+    return;
+  }
+
+  /* droppable ones only make sense after the reliable one they refer to */
+  if (!io_src->have_anchor || GST_PGM_FRAME_SEQUENCE_DIFF (io_apdu->sequence, io_src->next_sequence) < 0)
+  {
+    GST_LOG_OBJECT (io_src, "late droppable APDU %u", io_apdu->sequence);
+    gst_buffer_unref (io_apdu->buffer);
+    return;
+  }
+
+  if (GST_PGM_FRAME_SEQUENCE_DIFF (io_apdu->anchor, io_src->anchor) <= 0)
+  {
+    if (GST_PGM_FRAME_SEQUENCE_DIFF (io_apdu->sequence, io_src->next_sequence) > 0) gst_pgm_src_droppable_lost (io_src, TRUE);
+    io_src->next_sequence = io_apdu->sequence + 1;
+    gst_pgm_src_tier_ready (io_src, io_apdu);
+    return;
+  }
+
+  /* the oldest goes first, its gap shows when the next one is released */
+  const gsize size = gst_buffer_get_size (io_apdu->buffer);
+  while ( !g_queue_is_empty (&io_src->tier_held)
+        && ( g_queue_get_length (&io_src->tier_held) >= PGM_SRC_TIER_HELD_MAX
+           || io_src->tier_held_bytes + size > PGM_SRC_TIER_HELD_BYTES
+           )
+        )
+  {
+    GstPgmSrcApdu* oldest = g_queue_pop_head (&io_src->tier_held);
+    io_src->tier_held_bytes -= gst_buffer_get_size (oldest->buffer);
+    gst_pgm_src_apdu_free (oldest);
+  }
+  g_queue_push_tail (&io_src->tier_held, gst_pgm_src_apdu_copy (io_apdu));
+  io_src->tier_held_bytes += size;
+}
+
+/* Hand one APDU on, TRUE when it is for the always pad and now in
+ * o_buffer. After a lost droppable APDU the pad hears about the gap.
+ */
+static gboolean gst_pgm_src_deliver (GstPgmSrc* io_src, GstPgmSrcApdu* io_apdu, GstBuffer** o_buffer, GstFlowReturn* o_ret)
+{
+  GstPad* pad = io_apdu->stream ? io_apdu->stream->pad : GST_BASE_SRC_PAD (io_src);
+  GstClockTime* end = io_apdu->stream ? &io_apdu->stream->end : &io_src->main_end;
+  gboolean* lost = io_apdu->stream ? &io_apdu->stream->droppable_lost : &io_src->main_droppable_lost;
+  const GstClockTime pts = GST_BUFFER_PTS (io_apdu->buffer);
+
+  if (*lost && GST_CLOCK_TIME_IS_VALID (*end) && GST_CLOCK_TIME_IS_VALID (pts) && pts > *end)
+  {
+    gst_pad_push_event (pad, gst_event_new_gap (*end, pts - *end));
+  }
+  *lost = FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (pts))
+  {
+    *end = pts + (GST_BUFFER_DURATION_IS_VALID (io_apdu->buffer) ? GST_BUFFER_DURATION (io_apdu->buffer) : 0);
+  }
+
+  *o_ret = GST_FLOW_OK;
+
+  if (NULL == io_apdu->stream)
+  {
+    *o_buffer = io_apdu->buffer;
+    return TRUE;
+  }
+
+  /* elementary streams are pushed from here, the next APDU may be for the
+   * always pad */
+  const GstFlowReturn ret = gst_pad_push (pad, io_apdu->buffer);
+  if (GST_FLOW_OK != ret && GST_FLOW_NOT_LINKED != ret && GST_FLOW_FLUSHING != ret) *o_ret = ret;
+  return FALSE;
+}
+
+/* forget the order of the two tiers, after a start or channel switch */
+static void gst_pgm_src_tier_reset (GstPgmSrc* io_src)
+{
+  g_queue_clear_full (&io_src->tier_held, gst_pgm_src_apdu_free);
+  io_src->tier_held_bytes = 0;
+  g_queue_clear_full (&io_src->tier_ready, gst_pgm_src_apdu_free);
+  io_src->have_anchor    = FALSE;
+  gst_pgm_src_droppable_lost (io_src, FALSE);
+}
+
+
+/* Stop retuning a path, the old socket stays.
+ */
+static void gst_pgm_src_close_retune (GstPgmSrc* io_src, guint i_path)
+{
+  if (io_src->retune[i_path] == NULL) return;
+
+  gst_pgm_src_poll_transport (io_src, io_src->retune[i_path], FALSE);
+  gst_pgm_transport_close (io_src->retune[i_path]);
+  io_src->retune[i_path] = NULL;
+}
+
+/* The channels a retune thread opens sockets on, copied from the paths
+ * when it starts.
+ */
+typedef struct
+{
+  GstPgmSrc* src;
+  gchar*     network[2];
+  guint      port[2];
+  guint      udp_encap_port[2];
+} GstPgmSrcRetuneJob;
+
+/* GThreadFunc of retune_thread: open the retune sockets, which takes a
+ * while, and wake the receive loop to pick them up.
+ */
+static gpointer gst_pgm_src_retune_thread (gpointer i_job)
+{
+  GstPgmSrcRetuneJob* job = i_job;
+  GstPgmSrc* src = job->src;
+
+  for (guint i = 0; i < G_N_ELEMENTS(job->network); ++i)
+  {
+    if (job->network[i] == NULL) continue;
+
+    GstPgmTransport* retune = gst_pgm_src_open_transport (src, job->network[i], job->port[i], job->udp_encap_port[i]);
+    g_free (job->network[i]);
+
+    GST_OBJECT_LOCK (src);
+    src->retune_built[i] = retune;
+    GST_OBJECT_UNLOCK (src);
+  }
+  g_free (job);
+
+  GST_OBJECT_LOCK (src);
+  g_atomic_int_set (&src->retune_done, TRUE);
+  if (src->poll) gst_poll_write_control (src->poll);
+  GST_OBJECT_UNLOCK (src);
+
+  return NULL;
+}
+
+/* Open sockets with the current NAK intervals for the paths due a retune,
+ * unless that already happens or an old socket still waits for its
+ * repairs; the receive loop then tries again in gst_pgm_src_finish_retune.
+ */
+static void gst_pgm_src_start_retune (GstPgmSrc* io_src)
+{
+  const GstPgmTransport* transports[] = { io_src->transport, io_src->redundant_transport };
+
+  if (io_src->retune_paths == 0 || io_src->retune_thread != NULL) return;
+
+  for (guint i = 0; i < G_N_ELEMENTS(transports); ++i)
+  {
+    if (io_src->retune[i] && io_src->retune_until[i] != 0) return;
+  }
+
+  GstPgmSrcRetuneJob* job = g_new0 (GstPgmSrcRetuneJob, 1);
+  job->src = io_src;
+
+  for (guint i = 0; i < G_N_ELEMENTS(transports); ++i)
+  {
+    if (transports[i] == NULL || !(io_src->retune_paths & (1u << i))) continue;
+
+    job->network[i]        = g_strdup (transports[i]->network);
+    job->port[i]           = transports[i]->port;
+    job->udp_encap_port[i] = transports[i]->udp_encap_port;
+  }
+  io_src->retune_building = io_src->retune_paths;
+  io_src->retune_paths    = 0;
+
+  io_src->retune_thread = g_thread_new ("retune_thread", gst_pgm_src_retune_thread, job);
+}
+
+/* Wait for the retune thread, its sockets are closed unless i_take, then
+ * they replace the retunes that have not delivered yet.
+ */
+static void gst_pgm_src_join_retune (GstPgmSrc* io_src, gboolean i_take)
+{
+  if (io_src->retune_thread == NULL) return;
+
+  g_thread_join (io_src->retune_thread);
+  io_src->retune_thread = NULL;
+
+  GST_OBJECT_LOCK (io_src);
+  const gboolean woke = g_atomic_int_get (&io_src->retune_done) && io_src->poll != NULL;
+  g_atomic_int_set (&io_src->retune_done, FALSE);
+  GstPgmTransport* built[] = { io_src->retune_built[0], io_src->retune_built[1] };
+  io_src->retune_built[0] = io_src->retune_built[1] = NULL;
+  GST_OBJECT_UNLOCK (io_src);
+
+  if (woke) gst_poll_read_control (io_src->poll);
+
+  const guint building = io_src->retune_building;
+  io_src->retune_building = 0;
+
+  for (guint i = 0; i < G_N_ELEMENTS(built); ++i)
+  {
+    if (!i_take)
+    {
+      gst_pgm_transport_close (built[i]);
+      continue;
+    }
+
+    if (built[i] == NULL)
+    {
+      /* the intervals then apply when the transport is next opened */
+      if (building & (1u << i)) io_src->transport_dirty = TRUE;
+      continue;
+    }
+
+    gst_pgm_src_close_retune (io_src, i);
+    io_src->retune[i]       = built[i];
+    io_src->retune_until[i] = 0;
+    gst_pgm_src_poll_transport (io_src, io_src->retune[i], TRUE);
+  }
+}
+
+/* Apply new NAK intervals to the running primary and redundant paths.
+ * OpenPGM refuses them on a connected socket, so such a path gets a second
+ * socket on the same channel configured with them, received from like a
+ * redundant path. Once it delivers, the old socket is given the time its
+ * pending repairs can take and then closed; duplicates meanwhile are
+ * dropped by sequence. Raw framing has no sequence to drop them by, the
+ * intervals then apply when the transport is next opened. Intervals that
+ * move again while a retune is under way are applied by a further one.
+ */
+static void gst_pgm_src_apply_nak_intervals (GstPgmSrc* io_src, const GstPgmNakIntervals* i_ivl)
+{
+  GstPgmTransport* transports[] = { io_src->transport, io_src->redundant_transport };
+
+  for (guint i = 0; i < G_N_ELEMENTS(transports); ++i)
+  {
+    if (transports[i] == NULL) continue;
+
+    struct pgm_sock_t* sock = transports[i]->sock;
+    if ( pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_BO_IVL   , &i_ivl->bo_ivl   , sizeof(i_ivl->bo_ivl))
+       && pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RPT_IVL  , &i_ivl->rpt_ivl  , sizeof(i_ivl->rpt_ivl))
+       && pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RDATA_IVL, &i_ivl->rdata_ivl, sizeof(i_ivl->rdata_ivl))
+       )
+    {
+      continue;
+    }
+
+    if (GST_PGM_FRAMING_RAW == io_src->framing)
+    {
+      GST_DEBUG_OBJECT (io_src, "NAK intervals apply when the transport is next opened");
+      io_src->transport_dirty = TRUE;
+      continue;
+    }
+
+    io_src->retune_paths |= 1u << i;
+  }
+
+  gst_pgm_src_start_retune (io_src);
+}
+
+/* A retune socket delivered: the old one of its path has as long as a
+ * loss it saw can take to be repaired or given up on.
+ */
+static void gst_pgm_src_retune_delivered (GstPgmSrc* io_src, guint i_path)
+{
+  if (io_src->retune_until[i_path] != 0) return;
+
+  GST_OBJECT_LOCK (io_src);
+  const GstPgmNakIntervals old = 
+    { .bo_ivl = io_src->nak_bo_ivl, .rpt_ivl = io_src->nak_rpt_ivl, .rdata_ivl = io_src->nak_rdata_ivl };
+  const GstPgmNakIntervals* cur = &io_src->nak_effective;
+  const gint64 repair = MAX (old.bo_ivl, cur->bo_ivl)
+                      + (gint64) (io_src->nak_ncf_retries + 1) * MAX (old.rpt_ivl, cur->rpt_ivl)
+                      + (gint64) (io_src->nak_data_retries + 1) * MAX (old.rdata_ivl, cur->rdata_ivl);
+  GST_OBJECT_UNLOCK (io_src);
+
+  io_src->retune_until[i_path] = g_get_monotonic_time () + repair;
+}
+
+/* Replace the old sockets whose retune overlap is over, lowers *io_timeout
+ * to the next one due.
+ */
+static void gst_pgm_src_finish_retune (GstPgmSrc* io_src, GstClockTime* io_timeout)
+{
+  GstPgmTransport** transports[] = { &io_src->transport, &io_src->redundant_transport };
+  const gint64 now = g_get_monotonic_time ();
+
+  if (g_atomic_int_get (&io_src->retune_done)) gst_pgm_src_join_retune (io_src, TRUE);
+
+  for (guint i = 0; i < G_N_ELEMENTS(transports); ++i)
+  {
+    if (io_src->retune[i] == NULL || io_src->retune_until[i] == 0) continue;
+
+    if (now < io_src->retune_until[i])
+    {
+      *io_timeout = MIN (*io_timeout, (GstClockTime) (io_src->retune_until[i] - now) * GST_USECOND);
+      continue;
+    }
+
+    gst_pgm_src_poll_transport (io_src, *transports[i], FALSE);
+    gst_pgm_transport_close (*transports[i]);
+    *transports[i] = io_src->retune[i];
+    io_src->retune[i] = NULL;
+
+    GST_DEBUG_OBJECT (io_src, "path %u retuned", i);
+  }
+
+  gst_pgm_src_start_retune (io_src);
+}
+
+/* The sender of what a path delivered, first heard from now if unknown.
+ * Receive thread only.
+ */
+static GstPgmPeer* gst_pgm_src_peer (GstPgmSrc* io_src, guint i_path, const pgm_tsi_t* i_tsi)
+{
+  guint64 key = 0;
+  memcpy (&key, i_tsi, MIN (sizeof(key), sizeof(pgm_tsi_t)));
+
+  GstPgmPeer* peer = g_hash_table_lookup (io_src->senders, &key);
+  if (peer == NULL)
+  {
+    guint64* tsi = g_new (guint64, 1);
+    *tsi = key;
+    peer = g_new (GstPgmPeer, 1);
+    gst_pgm_peer_init (peer, i_tsi, i_path, pgm_time_update_now ());
+    g_hash_table_insert (io_src->senders, tsi, peer);
+  }
+  return peer;
+}
+
+/* Update the repair round trip of the APDU's sender and, when the slowest
+ * sender's estimate moved noticeably, the NAK intervals. NAK options are per
+ * socket, so the slowest sender decides.
+ */
+static void gst_pgm_src_observe_repair (GstPgmSrc* io_src, GstPgmPeer* io_peer, const struct pgm_msgv_t* i_msgv)
+{
+  GstPgmRepairRtt* rtt = &io_peer->rtt;
+
+  if (!gst_pgm_repair_rtt_observe (rtt, i_msgv, io_src->nak_effective.bo_ivl)) return;
+
+  const GstPgmRepairRtt* slowest = rtt;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, io_src->senders);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    const GstPgmRepairRtt* other = &((const GstPgmPeer*) value)->rtt;
+    if (other->valid && other->srtt > slowest->srtt) slowest = other;
+  }
+
+  GstPgmNakIntervals ivl;
+  gst_pgm_repair_rtt_intervals (slowest->srtt, slowest->rttvar, io_src->nak_adapt_min, io_src->nak_adapt_max, &ivl);
+
+  const GstPgmNakIntervals* cur = &io_src->nak_effective;
+  const gboolean moved = 
+       ABS ((gint64)ivl.bo_ivl    - cur->bo_ivl)    > cur->bo_ivl / 8
+    || ABS ((gint64)ivl.rpt_ivl   - cur->rpt_ivl)   > cur->rpt_ivl / 8
+    || ABS ((gint64)ivl.rdata_ivl - cur->rdata_ivl) > cur->rdata_ivl / 8;
+
+  GST_OBJECT_LOCK (io_src);
+  io_src->repair_rtt    = (guint) MIN (slowest->srtt, (gint64)G_MAXUINT);
+  io_src->nak_estimated = TRUE;
+  if (moved) io_src->nak_effective = ivl;
+  GST_OBJECT_UNLOCK (io_src);
+
+  if (!moved) return;
+
+  GST_DEBUG_OBJECT (io_src, "repair rtt %u us, NAK intervals %u/%u/%u us", io_src->repair_rtt, ivl.bo_ivl, ivl.rpt_ivl, ivl.rdata_ivl);
+  gst_pgm_src_apply_nak_intervals (io_src, &ivl);
+}
+
+/* Kernel drop counters of the receive paths, the interface of the
+ * redundant path only if it differs from the primary one.
+ */
+static void gst_pgm_src_read_drops (GstPgmSrc* io_src, GstPgmKernelDrops* o_drops)
+{
+  memset (o_drops, 0, sizeof(*o_drops));
+
+  gst_pgm_transport_read_drops (io_src->transport, TRUE, o_drops);
+
+  if (io_src->redundant_transport)
+  {
+    const gboolean same_interface = 
+      io_src->redundant_transport->res->ai_recv_addrs[0].gsr_interface == io_src->transport->res->ai_recv_addrs[0].gsr_interface;
+    gst_pgm_transport_read_drops (io_src->redundant_transport, !same_interface, o_drops);
+  }
+
+  gst_pgm_kernel_drops_read_host (o_drops);
+}
+
+/* Publish PGM loss next to the kernel's drop counters so that NAKs caused
+ * by our own overruns can be told from loss on the network. Interface and
+ * host counters count from the moment the transports were opened, socket
+ * counters from when the current sockets were.
+ */
+static void gst_pgm_src_update_stats (GstPgmSrc* io_src)
+{
+  GstPgmKernelDrops drops;
+  const GstPgmKernelDrops* base = &io_src->drops_base;
+
+  gst_pgm_src_read_drops (io_src, &drops);
+
+  GstStructure* stats = gst_structure_new 
+    ( "pgm-receive-stats"
+    , "pgm-lost-sequences"        , G_TYPE_UINT64, io_src->lost_sequences
+    , "pgm-resets"                , G_TYPE_UINT64, io_src->resets
+    , "keyframe-skipped"          , G_TYPE_UINT64, io_src->keyframe_skipped
+    , "decrypt-failed"            , G_TYPE_UINT64, io_src->decrypt_failed
+    , "decompress-failed"         , G_TYPE_UINT64, io_src->decompress_failed
+    , "socket-drops"              , G_TYPE_UINT64, drops.socket_drops
+    , "interface-rx-dropped"      , G_TYPE_UINT64, drops.rx_dropped - base->rx_dropped
+    , "interface-rx-fifo-errors"  , G_TYPE_UINT64, drops.rx_fifo_errors - base->rx_fifo_errors
+    , "interface-rx-missed-errors", G_TYPE_UINT64, drops.rx_missed_errors - base->rx_missed_errors
+    , "udp-rcvbuf-errors"         , G_TYPE_UINT64, drops.udp_rcvbuf_errors - base->udp_rcvbuf_errors
+    , NULL
+    );
+
+  gst_element_post_message 
+    ( GST_ELEMENT_CAST (io_src)
+    , gst_message_new_element (GST_OBJECT_CAST (io_src), gst_structure_copy (stats))
+    );
+
+  GST_OBJECT_LOCK (io_src);
+  if (io_src->stats) gst_structure_free (io_src->stats);
+  io_src->stats = stats;
+  GST_OBJECT_UNLOCK (io_src);
+}
+
+/* Close every sender's period, post pgm-peer-stats of those that changed
+ * enough and publish the table. Senders OpenPGM expired are forgotten.
+ */
+static void gst_pgm_src_update_peers (GstPgmSrc* io_src)
+{
+  const pgm_time_t now = pgm_time_update_now ();
+  GPtrArray* peers = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_structure_free);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, io_src->senders);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    GstPgmPeer* peer = value;
+
+    if (now > peer->last_arrival && now - peer->last_arrival > io_src->peer_expiry)
+    {
+      g_hash_table_iter_remove (&iter);
+      continue;
+    }
+
+    const gboolean changed = gst_pgm_peer_update (peer, now, io_src->peer_threshold);
+    GstStructure* stats = gst_pgm_peer_to_structure (peer, now);
+    if (changed)
+    {
+      gst_element_post_message 
+        ( GST_ELEMENT_CAST (io_src)
+        , gst_message_new_element (GST_OBJECT_CAST (io_src), gst_structure_copy (stats))
+        );
+    }
+    g_ptr_array_add (peers, stats);
+  }
+
+  GST_OBJECT_LOCK (io_src);
+  GPtrArray* old = io_src->peers;
+  io_src->peers = peers;
+  GST_OBJECT_UNLOCK (io_src);
+
+  if (old) g_ptr_array_unref (old);
+}
+
+/* Forget every sender, their counters belong to the session before a
+ * start, stop or channel switch.
+ */
+static void gst_pgm_src_peers_reset (GstPgmSrc* io_src)
+{
+  g_hash_table_remove_all (io_src->senders);
+
+  GST_OBJECT_LOCK (io_src);
+  GPtrArray* old = io_src->peers;
+  io_src->peers = NULL;
+  GST_OBJECT_UNLOCK (io_src);
+
+  if (old) g_ptr_array_unref (old);
+}
+
+/* Hand what arrived on a path in one pgm_recvmsg on, also for subclasses
+ * that replay it. TRUE when create has to return *o_ret, with a buffer
+ * for the always pad if it is GST_FLOW_OK.
+ */
+gboolean gst_pgm_src_handle_apdu (GstPgmSrc* io_src, guint i_path, const struct pgm_msgv_t* i_msgv, size_t i_len, GstBuffer** o_buffer, GstFlowReturn* o_ret)
+{
+  GstPgmSrcApdu apdu;
+
+  if (io_src->capture && !gst_pgm_capture_write (io_src->capture, GST_PGM_CAPTURE_APDU, i_path, i_msgv))
+  {
+    GST_WARNING_OBJECT (io_src, "capture failed, stopping it: %s", g_strerror (errno));
+    fclose (io_src->capture);
+    io_src->capture = NULL;
+  }
+
+  if (!gst_pgm_src_take_apdu (io_src, i_msgv, i_len, &apdu)) return FALSE;
+
+  if (io_src->flush_pending) gst_pgm_src_push_flush (io_src);
+  if (io_src->tiered)
+  {
+    gst_pgm_src_merge_tiers (io_src, &apdu);
+    return gst_pgm_src_take_ready (io_src, o_buffer, o_ret);
+  }
+
+  if (gst_pgm_src_deliver (io_src, &apdu, o_buffer, o_ret)) return TRUE;
+  return GST_FLOW_OK != *o_ret;
+}
+
+/* Sequenced framing when several paths or tiers need merging, a framing
+ * set by the user stays and what needs a header goes without.
+ */
+void gst_pgm_src_choose_framing (GstPgmSrc* io_src)
+{
+  const gchar* needs_header = NULL;
+  if (io_src->droppable_port)    needs_header = "droppable session";
+  if (io_src->redundant_network) needs_header = "redundant path";
+
+  if (needs_header && GST_PGM_FRAMING_RAW == io_src->framing)
+  {
+    if (io_src->framing_set)
+    {
+      GST_WARNING_OBJECT (io_src, "%s needs a frame header, framing is set to raw: paths and tiers are not merged", needs_header);
+    }
+    else
+    {
+      GST_WARNING_OBJECT (io_src, "%s needs a frame header, using sequenced framing", needs_header);
+      io_src->framing = GST_PGM_FRAMING_SEQUENCED;
+    }
+  }
+}
+
+/* unrecoverable loss on a path, the others may still fill in
+ */
+void gst_pgm_src_handle_reset (GstPgmSrc* io_src, guint i_path, const struct pgm_msgv_t* i_msgv)
+{
+  const struct pgm_sk_buff_t* skb = i_msgv->msgv_skb[0];
+
+  if (io_src->capture) gst_pgm_capture_write (io_src->capture, GST_PGM_CAPTURE_RESET, i_path, i_msgv);
+
+  GST_DEBUG_OBJECT (io_src, "path %u lost %u sequences from %s", i_path, skb->sequence, pgm_tsi_print (&skb->tsi));
+  io_src->lost_sequences += skb->sequence;
+  io_src->resets++;
+  if (GST_PGM_FRAMING_RAW == io_src->framing) io_src->discont = TRUE;
+  /* reliable data lost for good, unlike gaps in the droppable tier */
+  if (io_src->tiered && GST_PGM_SRC_PATH_DROPPABLE != i_path) io_src->discont = TRUE;
+}
+
+/* What the tier merge put in order goes before anything new. TRUE when
+ * create has to return *o_ret, as for gst_pgm_src_handle_apdu.
+ */
+gboolean gst_pgm_src_take_ready (GstPgmSrc* io_src, GstBuffer** o_buffer, GstFlowReturn* o_ret)
+{
+  while (!g_queue_is_empty (&io_src->tier_ready))
+  {
+    GstPgmSrcApdu* apdu = g_queue_pop_head (&io_src->tier_ready);
+    const gboolean done = gst_pgm_src_deliver (io_src, apdu, o_buffer, o_ret);
+    g_free (apdu);
+
+    if (done || GST_FLOW_OK != *o_ret) return TRUE;
+  }
+  return FALSE;
+}
+
+static void gst_pgm_src_detach_shm (GstPgmSrc* io_src)
+{
+  gst_pgm_shm_free (io_src->shm);
+  io_src->shm = NULL;
+  io_src->shm_next_attach = 0;
+}
+
+/* A pgmsink on this host does not loop its APDUs back but publishes them in
+ * shared memory, which is looked for again every PGM_SRC_SHM_ATTACH_MSECS.
+ * Records are handed on as if they came in one ODATA packet each, split in
+ * fragments for skb lengths. TRUE when create has to return *o_ret, as for
+ * gst_pgm_src_handle_apdu.
+ */
+static gboolean gst_pgm_src_read_shm (GstPgmSrc* io_src, GstBuffer** o_buffer, GstFlowReturn* o_ret)
+{
+  if (NULL == io_src->shm)
+  {
+    const gint64 now = g_get_monotonic_time ();
+    if (now < io_src->shm_next_attach) return FALSE;
+    io_src->shm_next_attach = now + PGM_SRC_SHM_ATTACH_MSECS * 1000;
+
+    GST_OBJECT_LOCK (io_src);
+    gchar* network = g_strdup (io_src->network);
+    const guint port = io_src->port;
+    GST_OBJECT_UNLOCK (io_src);
+
+    io_src->shm = gst_pgm_shm_attach (network, port);
+    g_free (network);
+    if (NULL == io_src->shm) return FALSE;
+
+    GST_INFO_OBJECT (io_src, "sender on this host, reading its shared memory ring");
+    io_src->discont = TRUE;
+  }
+
+  for (;;)
+  {
+    struct pgm_sk_buff_t skb[PGM_MAX_FRAGMENTS];
+    struct pgm_header header;
+    struct pgm_msgv_t msgv;
+    guint path;
+
+    switch (gst_pgm_shm_next (io_src->shm, io_src->shm_record, &path))
+    {
+    case GST_PGM_SHM_EMPTY:
+      return FALSE;
+
+    case GST_PGM_SHM_LOST:
+      GST_DEBUG_OBJECT (io_src, "overrun on the shared memory ring");
+      io_src->resets++;
+      io_src->discont = TRUE;
+      continue;
+
+    case GST_PGM_SHM_CLOSED:
+      GST_INFO_OBJECT (io_src, "sender on this host went away, back to the network");
+      gst_pgm_src_detach_shm (io_src);
+      return FALSE;
+
+    case GST_PGM_SHM_RECORD:
+      break;
+    }
+
+    /* not subscribed to over the network either */
+    if (GST_PGM_SRC_PATH_DROPPABLE == path && !io_src->tiered) continue;
+
+    const guint8* data = io_src->shm_record->data;
+    gsize left = io_src->shm_record->len;
+    const pgm_time_t now = pgm_time_update_now ();
+
+    memset (&header, 0, sizeof(header));
+    header.pgm_type = PGM_ODATA;
+    msgv.msgv_len = 0;
+    while (left > 0 && msgv.msgv_len < PGM_MAX_FRAGMENTS)
+    {
+      struct pgm_sk_buff_t* fragment = &skb[msgv.msgv_len];
+      const gsize len = MIN (left, G_MAXUINT16);
+
+      memset (fragment, 0, sizeof(*fragment));
+      fragment->tstamp     = now;
+      fragment->len        = len;
+      fragment->pgm_header = &header;
+      fragment->data       = (gpointer) data;
+      msgv.msgv_skb[msgv.msgv_len++] = fragment;
+      data += len;
+      left -= len;
+    }
+    if (left > 0)
+    {
+      GST_WARNING_OBJECT (io_src, "APDU of %u bytes on the shared memory ring too large, dropped", io_src->shm_record->len);
+      io_src->discont = TRUE;
+      continue;
+    }
+
+    if (gst_pgm_src_handle_apdu (io_src, path, &msgv, io_src->shm_record->len, o_buffer, o_ret)) return TRUE;
+  }
+}
+
+/* GstPushSrcClass::create
+ *
+ * As a GStreamer source, create data, from wherever the class receives it.
+ */
+static GstFlowReturn gst_pgm_src_create ( GstPushSrc* pushsrc, GstBuffer** buffer)
+{
+  GstPgmSrc* src = GST_PGM_SRC(pushsrc);
+
+  return GST_PGM_SRC_GET_CLASS (src)->receive (src, buffer);
+}
+
+/* GstPgmSrcClass::receive, recv on the PGM transports
+ */
+static GstFlowReturn gst_pgm_src_receive (GstPgmSrc* src, GstBuffer** buffer)
+{
+  struct pgm_sock_t* socks[5];
+  guint ids[5];
+  gint  retunes[5];   // index into retune, -1 for the paths themselves
+  guint n_paths;
+
+  for (;;)
+  {
+    GstClockTime timeout = GST_CLOCK_TIME_NONE;
+    gboolean again = FALSE;
+    GstFlowReturn ret;
+
+    if (gst_pgm_src_take_ready (src, buffer, &ret)) return ret;
+
+    if (g_atomic_int_compare_and_exchange (&src->switch_pending, TRUE, FALSE))
+    {
+      gst_poll_read_control (src->poll);
+      if (!gst_pgm_src_switch_channel (src)) return GST_FLOW_ERROR;
+    }
+
+    if (src->use_shm && gst_pgm_src_read_shm (src, buffer, &ret)) return ret;
+
+    /* may be changed while playing, a shorter interval takes effect at once */
+    const guint stats_interval = g_atomic_int_get (&src->stats_interval);
+    if (stats_interval > 0)
+    {
+      const gint64 now = g_get_monotonic_time ();
+      src->stats_next = MIN (src->stats_next, now + (gint64) stats_interval * 1000);
+      if (now >= src->stats_next)
+      {
+        gst_pgm_src_update_stats (src);
+        gst_pgm_src_update_peers (src);
+        src->stats_next = now + (gint64) stats_interval * 1000;
+      }
+      timeout = (src->stats_next - now) * GST_USECOND;
+    }
+
+    /* transports may have been swapped by a channel switch or retune */
+    gst_pgm_src_finish_retune (src, &timeout);
+
+    n_paths = 0;
+    ids[n_paths] = GST_PGM_SRC_PATH_MAIN;
+    retunes[n_paths] = -1;
+    socks[n_paths++] = src->transport->sock;
+    if (src->redundant_transport) 
+    {
+      ids[n_paths] = GST_PGM_SRC_PATH_REDUNDANT;
+      retunes[n_paths] = -1;
+      socks[n_paths++] = src->redundant_transport->sock;
+    }
+    if (src->droppable_transport) 
+    {
+      ids[n_paths] = GST_PGM_SRC_PATH_DROPPABLE;
+      retunes[n_paths] = -1;
+      socks[n_paths++] = src->droppable_transport->sock;
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(src->retune); ++i)
+    {
+      if (src->retune[i] == NULL) continue;
+      ids[n_paths] = (0 == i) ? GST_PGM_SRC_PATH_MAIN : GST_PGM_SRC_PATH_REDUNDANT;
+      retunes[n_paths] = i;
+      socks[n_paths++] = src->retune[i]->sock;
+    }
+
+    /* read in waiting data, starting with the path after the one that
+     * delivered last so that no path's window is left to fill up */
+    for (guint n = 0; n < n_paths; ++n)
+    {
+      const guint path = (src->path + n) % n_paths;
+
+      struct pgm_msgv_t msgv;
+      size_t len;
+      struct pgm_error_t* pErr = NULL;
+      struct timeval tv;
+      socklen_t optlen = sizeof(tv);
+      GstPgmPeer* peer;
+
+      const int status = pgm_recvmsg (socks[path], &msgv, MSG_DONTWAIT | MSG_ERRQUEUE, &len, &pErr);
+
+      switch (status)
+      {
+      case PGM_IO_STATUS_NORMAL:
+        src->path = (path + 1) % n_paths;
+        if (retunes[path] >= 0) gst_pgm_src_retune_delivered (src, retunes[path]);
+        peer = gst_pgm_src_peer (src, ids[path], &msgv.msgv_skb[0]->tsi);
+        gst_pgm_peer_observe (peer, &msgv);
+        if (src->nak_adaptive) gst_pgm_src_observe_repair (src, peer, &msgv);
+        if (gst_pgm_src_handle_apdu (src, ids[path], &msgv, len, buffer, &ret)) return ret;
+        again = TRUE;
+        break;
+
+      case PGM_IO_STATUS_TIMER_PENDING:
+        if (pgm_getsockopt (socks[path], IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen))
+        {
+          timeout = MIN (timeout, GST_TIMEVAL_TO_TIME (tv));
+        }
+        break;
+
+      case PGM_IO_STATUS_RATE_LIMITED:
+        if (pgm_getsockopt (socks[path], IPPROTO_PGM, PGM_RATE_REMAIN, &tv, &optlen))
+        {
+          timeout = MIN (timeout, GST_TIMEVAL_TO_TIME (tv));
+        }
+        break;
+
+      case PGM_IO_STATUS_WOULD_BLOCK:
+        break;
+
+      case PGM_IO_STATUS_RESET:
+        gst_pgm_peer_observe_reset (gst_pgm_src_peer (src, ids[path], &msgv.msgv_skb[0]->tsi), msgv.msgv_skb[0]);
+        gst_pgm_src_handle_reset (src, ids[path], &msgv);
+        pgm_free_skb (msgv.msgv_skb[0]);
+        if (pErr) pgm_error_free (pErr);
+        again = TRUE;
+        break;
+
+      default:
+        GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("Receive error: %s)", pErr ? pErr->message : "unknown"));
+        if (pErr) pgm_error_free (pErr);
+        return GST_FLOW_ERROR;
+      }
+    }
+
+    gst_pgm_src_drain_standby (src, &timeout);
+
+    if (again) continue;
+
+    if (src->shm)
+    {
+      /* the ring cannot be polled, so the sockets and unlock are looked at
+       * every PGM_SRC_SHM_WAIT_MSECS */
+      gint64 wait = PGM_SRC_SHM_WAIT_MSECS * 1000;
+      if (GST_CLOCK_TIME_IS_VALID (timeout)) wait = MIN (wait, (gint64) (timeout / GST_USECOND));
+
+      const gint ready = gst_poll_wait (src->poll, 0);
+      if (ready < 0 && EBUSY == errno) return GST_FLOW_FLUSHING;
+      if (0 == ready) gst_pgm_shm_wait (src->shm, wait);
+      continue;
+    }
+    if (src->use_shm)
+    {
+      const gint64 attach = src->shm_next_attach - g_get_monotonic_time ();
+      timeout = MIN (timeout, (GstClockTime) MAX (attach, 0) * GST_USECOND);
+    }
+
+    if (gst_poll_wait (src->poll, timeout) < 0)
+    {
+      if (EBUSY == errno) return GST_FLOW_FLUSHING;
+      if (EINTR != errno && EAGAIN != errno)
+      {
+        GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("poll error: %s", g_strerror (errno)));
+        return GST_FLOW_ERROR;
+      }
+    }
+  }
+}
+
+static gboolean gst_pgm_src_unlock (GstBaseSrc* io_basesrc)
+{
+  GstPgmSrc* src = GST_PGM_SRC (io_basesrc);
+
+  if (src->poll) gst_poll_set_flushing (src->poll, TRUE);
+  return TRUE;
+}
+
+static gboolean gst_pgm_src_unlock_stop (GstBaseSrc* io_basesrc)
+{
+  GstPgmSrc* src = GST_PGM_SRC (io_basesrc);
+
+  if (src->poll) gst_poll_set_flushing (src->poll, FALSE);
+  return TRUE;
+}
+
+/* GstBaseSrcClass::query, a fixed latency to play out in step with other
+ * receivers
+ */
+static gboolean gst_pgm_src_query (GstBaseSrc* io_basesrc, GstQuery* io_query)
+{
+  GstPgmSrc* src = GST_PGM_SRC (io_basesrc);
+
+  if (GST_QUERY_LATENCY == GST_QUERY_TYPE (io_query) && src->latency > 0)
+  {
+    gst_query_set_latency (io_query, TRUE, src->latency * GST_MSECOND, GST_CLOCK_TIME_NONE);
+    return TRUE;
+  }
+
+  return GST_BASE_SRC_CLASS (gst_pgm_src_parent_class)->query (io_basesrc, io_query);
+}
+
+static GstClock* gst_pgm_src_provide_clock (GstElement* io_element)
+{
+  GstPgmSrc* src = GST_PGM_SRC (io_element);
+
+  if (!src->provide_clock) return NULL;
+  return GST_CLOCK_CAST (gst_object_ref (src->clock));
+}
+
+/* wake gst_pgm_src_create whenever the transport has something for us,
+ * or stop watching it before it is closed
+ */
+static void gst_pgm_src_poll_transport (GstPgmSrc* io_src, const GstPgmTransport* i_transport, gboolean i_watch)
+{
+  struct pollfd fds[PGM_SRC_MAX_POLL_FDS];
+  int n_fds = PGM_SRC_MAX_POLL_FDS;
+
+  if (pgm_poll_info (i_transport->sock, fds, &n_fds, POLLIN) < 0) return;
+
+  for (int i = 0; i < n_fds; ++i)
+  {
+    GstPollFD pfd;
+    gst_poll_fd_init (&pfd);
+    pfd.fd = fds[i].fd;
+
+    if (i_watch)
+    {
+      gst_poll_add_fd (io_src->poll, &pfd);
+      gst_poll_fd_ctl_read (io_src->poll, &pfd, TRUE);
+    }
+    else
+    {
+      gst_poll_remove_fd (io_src->poll, &pfd);
+    }
+  }
+}
+
+/* receiver side socket options, GstPgmTransportConfigure
+ */
+static gboolean gst_pgm_src_configure (GstElement* element, struct pgm_sock_t* sock, gpointer droppable)
+{
+  GstPgmSrc* src = GST_PGM_SRC (element);
+
+  const int valTrue  = 1;
+  const int valFalse = 0;
+
+  /* the droppable session is joined passive: no NAKs, losses are given up
+   * on after a short wait for reordered packets */
+  GST_OBJECT_LOCK (src);   // the retune thread opens sockets too
+  GstPgmNakIntervals nak = src->nak_effective;
+  GST_OBJECT_UNLOCK (src);
+  guint nak_data_retries = src->nak_data_retries;
+  guint nak_ncf_retries  = src->nak_ncf_retries;
+  gint  congestion_control = src->congestion_control;
+
+  if (droppable)
+  {
+    nak.bo_ivl = nak.rpt_ivl = nak.rdata_ivl = PGM_DEFAULT_DROPPABLE_NAK_IVL;
+    nak_data_retries   = 0;
+    nak_ncf_retries    = 0;
+    congestion_control = GST_PGM_CONGESTION_CONTROL_NONE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_RECV_ONLY, &valTrue, sizeof(valTrue))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set receive-only mode"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MTU, &src->max_tpdu, sizeof(src->max_tpdu))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set maximum TPDU size"));
+    return FALSE;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_LOOP, &valTrue, sizeof(valTrue))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set multicast loop"));
+    return FALSE;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_MULTICAST_HOPS, &src->hops, sizeof(src->hops))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set IP hop limit"));
+    return FALSE;
+  }
+
+  if (!gst_pgm_transport_set_window ( element
+                                    , sock
+                                    , FALSE
+                                    , src->rxw_sqns
+                                    , src->rxw_secs
+                                    , src->max_rate
+                                    , src->window_budget
+                                    , src->max_tpdu
+                                    )
+     )
+  {
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_PEER_EXPIRY, &src->peer_expiry, sizeof(src->peer_expiry))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set peer expiration timeout"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_SPMR_EXPIRY, &src->spmr_expiry, sizeof(src->spmr_expiry))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set SPMR timeout"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_BO_IVL, &nak.bo_ivl, sizeof(nak.bo_ivl))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_BO_IVL"));
+    return FALSE;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RPT_IVL, &nak.rpt_ivl, sizeof(nak.rpt_ivl))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_RPT_IVL"));
+    return FALSE;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_RDATA_IVL, &nak.rdata_ivl, sizeof(nak.rdata_ivl))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_RDATA_IVL"));
+    return FALSE;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_DATA_RETRIES, &nak_data_retries, sizeof(nak_data_retries))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_DATA_RETRIES"));
+    return FALSE;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_NAK_NCF_RETRIES, &nak_ncf_retries, sizeof(nak_ncf_retries))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set NAK_NCF_RETRIES"));
+    return FALSE;
+  }
+
+  const int passive = droppable ? valTrue : valFalse;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_PASSIVE, &passive, sizeof(passive))) 
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("cannot set passive"));
+    return FALSE;
+  }
+
+  if (!gst_pgm_transport_set_congestion_control (element, sock, congestion_control)) return FALSE;
+
+  return TRUE;
+}
+
+static GstPgmTransport* gst_pgm_src_open_transport (GstPgmSrc* io_src, const gchar* i_network, guint i_port, guint i_udp_encap_port)
+{
+  return gst_pgm_transport_open 
+    ( GST_ELEMENT_CAST (io_src)
+    , i_network
+    , i_port
+    , i_udp_encap_port
+    , gst_pgm_src_configure
+    , NULL
+    );
+}
+
+/* open one warm receiver per URI in standby-uris
+ */
+static gboolean gst_pgm_src_open_standby (GstPgmSrc* io_src, GstClockTime* io_setup_time)
+{
+  io_src->standby = g_ptr_array_new ();
+
+  if (io_src->standby_uris == NULL) return TRUE;
+
+  gboolean ok = TRUE;
+  gchar** uris = g_strsplit (io_src->standby_uris, " ", -1);
+
+  for (gchar** uri = uris; ok && *uri; ++uri)
+  {
+    gchar* network = NULL;
+    guint port;
+    guint udp_encap_port;
+
+    if (**uri == '\0') continue;
+
+    if (!gst_pgm_src_parse_uri (*uri, &network, &port, &udp_encap_port))
+    {
+      GST_ELEMENT_ERROR (io_src, RESOURCE, OPEN_READ, (NULL), ("Invalid standby URI: %s", *uri));
+      ok = FALSE;
+      break;
+    }
+
+    GstPgmTransport* standby = gst_pgm_src_open_transport (io_src, network, port, udp_encap_port);
+    g_free (network);
+
+    if (standby == NULL)
+    {
+      ok = FALSE;
+      break;
+    }
+
+    gst_pgm_src_poll_transport (io_src, standby, TRUE);
+    g_ptr_array_add (io_src->standby, standby);
+    *io_setup_time += standby->setup_time;
+  }
+
+  g_strfreev (uris);
+  return ok;
+}
+
+static void gst_pgm_src_close_standby (GstPgmSrc* io_src)
+{
+  if (io_src->standby == NULL) return;
+
+  for (guint i = 0; i < io_src->standby->len; ++i)
+  {
+    gst_pgm_transport_close (g_ptr_array_index (io_src->standby, i));
+  }
+
+  g_ptr_array_free (io_src->standby, TRUE);
+  io_src->standby = NULL;
+}
+
+/* Read and discard whatever the transport has received so far, keeping its
+ * window moving.
+ */
+static void gst_pgm_src_drain_transport (GstPgmSrc* io_src, const GstPgmTransport* i_transport, GstClockTime* io_timeout)
+{
+  struct pgm_msgv_t msgv;
+  struct timeval tv;
+  socklen_t optlen = sizeof(tv);
+  int status;
+
+  do
+  {
+    status = pgm_recvmsg (i_transport->sock, &msgv, MSG_DONTWAIT | MSG_ERRQUEUE, NULL, NULL);
+    if (PGM_IO_STATUS_RESET == status) pgm_free_skb (msgv.msgv_skb[0]);
+  }
+  while (PGM_IO_STATUS_NORMAL == status || PGM_IO_STATUS_RESET == status);
+
+  if (PGM_IO_STATUS_TIMER_PENDING == status && pgm_getsockopt (i_transport->sock, IPPROTO_PGM, PGM_TIME_REMAIN, &tv, &optlen))
+  {
+    *io_timeout = MIN (*io_timeout, GST_TIMEVAL_TO_TIME (tv));
+  }
+}
+
+/* Keep standby windows in sync with their sender so that they can be
+ * switched to without waiting for a new SPM.
+ */
+static void gst_pgm_src_drain_standby (GstPgmSrc* io_src, GstClockTime* io_timeout)
+{
+  for (guint i = 0; i < io_src->standby->len; ++i)
+  {
+    gst_pgm_src_drain_transport (io_src, g_ptr_array_index (io_src->standby, i), io_timeout);
+  }
+}
+
+/* Move a secondary path along with the primary: join in place when only
+ * the group differs, else rebuild it. NULL when it cannot follow, the
+ * element then goes on without it.
+ */
+static GstPgmTransport* gst_pgm_src_switch_path (GstPgmSrc* io_src, GstPgmTransport* io_transport, const gchar* i_network, guint i_port, guint i_udp_encap_port, gboolean i_droppable)
+{
+  if (io_transport == NULL) return NULL;
+
+  if ( i_port == io_transport->port
+     && i_udp_encap_port == io_transport->udp_encap_port
+     && ( g_strcmp0 (i_network, io_transport->network) == 0
+        || gst_pgm_transport_rejoin (io_transport, i_network)
+        )
+     )
+  {
+    return io_transport;
+  }
+
+  gst_pgm_src_poll_transport (io_src, io_transport, FALSE);
+  gst_pgm_transport_close (io_transport);
+
+  GstPgmTransport* transport = i_droppable
+    ? gst_pgm_transport_open (GST_ELEMENT_CAST (io_src), i_network, i_port, i_udp_encap_port, gst_pgm_src_configure, GINT_TO_POINTER (TRUE))
+    : gst_pgm_src_open_transport (io_src, i_network, i_port, i_udp_encap_port);
+
+  if (transport == NULL)
+  {
+    GST_WARNING_OBJECT (io_src, "path to %s port %u lost in the channel switch", i_network, i_port);
+    return NULL;
+  }
+  gst_pgm_src_poll_transport (io_src, transport, TRUE);
+  return transport;
+}
+
+/* Apply network/dport/udp-encap-port to the primary path without a state
+ * change: join in place when possible, else swap in a matching standby
+ * receiver, else rebuild the transport. The redundant and droppable paths
+ * follow, on redundant-network and droppable-port of the new channel.
+ */
+static gboolean gst_pgm_src_switch_channel (GstPgmSrc* io_src)
+{
+  const gint64 begin = g_get_monotonic_time ();
+  const gchar* method = NULL;
+
+  GST_OBJECT_LOCK (io_src);
+  gchar* network = g_strdup (io_src->network);
+  gchar* uri     = g_strdup (io_src->uri);
+  const guint port           = io_src->port;
+  const guint udp_encap_port = io_src->udp_encap_port;
+  GST_OBJECT_UNLOCK (io_src);
+
+  /* the ring and retunes belong to the old session */
+  gst_pgm_src_detach_shm (io_src);
+  gst_pgm_src_join_retune (io_src, FALSE);
+  io_src->retune_paths = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(io_src->retune); ++i) gst_pgm_src_close_retune (io_src, i);
+
+  if ( port == io_src->transport->port
+     && udp_encap_port == io_src->transport->udp_encap_port
+     && gst_pgm_transport_rejoin (io_src->transport, network)
+     )
+  {
+    method = "join";
+  }
+
+  for (guint i = 0; method == NULL && i < io_src->standby->len; ++i)
+  {
+    GstPgmTransport* standby = g_ptr_array_index (io_src->standby, i);
 
-  if (src->sock) 
+    if ( g_strcmp0 (standby->network, network) != 0
+       || standby->port != port
+       || standby->udp_encap_port != udp_encap_port
+       )
+    {
+      continue;
+    }
+
+    /* the old channel stays warm in the standby slot */
+    g_ptr_array_index (io_src->standby, i) = io_src->transport;
+    io_src->transport = standby;
+    method = "standby";
+  }
+
+  if (method == NULL)
+  {
+    gst_pgm_src_poll_transport (io_src, io_src->transport, FALSE);
+    gst_pgm_transport_close (io_src->transport);
+
+    io_src->transport = gst_pgm_src_open_transport (io_src, network, port, udp_encap_port);
+    if (io_src->transport == NULL)
+    {
+      g_free (network);
+      g_free (uri);
+      return FALSE;
+    }
+    gst_pgm_src_poll_transport (io_src, io_src->transport, TRUE);
+    method = "reopen";
+  }
+
+  io_src->redundant_transport = gst_pgm_src_switch_path (io_src, io_src->redundant_transport, io_src->redundant_network, port, udp_encap_port, FALSE);
+  io_src->droppable_transport = gst_pgm_src_switch_path (io_src, io_src->droppable_transport, network, io_src->droppable_port, udp_encap_port, TRUE);
+  io_src->tiered = NULL != io_src->droppable_transport && GST_PGM_FRAMING_RAW != io_src->framing;
+  g_free (network);
+
+  io_src->have_sequence = FALSE;
+  io_src->have_ts_offset = FALSE;
+  gst_pgm_src_clock_reset (io_src);
+  gst_pgm_src_tier_reset (io_src);
+  gst_pgm_src_peers_reset (io_src);
+  io_src->discont       = TRUE;
+  io_src->flush_pending = TRUE;
+
+  GST_INFO_OBJECT (io_src, "switched to %s by %s", uri, method);
+
+  gst_element_post_message 
+    ( GST_ELEMENT_CAST (io_src)
+    , gst_message_new_element 
+      ( GST_OBJECT_CAST (io_src)
+      , gst_structure_new 
+        ( "pgm-channel-switch"
+        , "uri"     , G_TYPE_STRING, uri
+        , "method"  , G_TYPE_STRING, method
+        , "duration", G_TYPE_UINT64, (guint64)(g_get_monotonic_time () - begin) * GST_USECOND
+        , NULL
+        )
+      )
+    );
+
+  g_free (uri);
+  return TRUE;
+}
+
+/* Ask the streaming thread to move the primary path to the channel now
+ * described by network/dport/udp-encap-port.
+ */
+static void gst_pgm_src_request_switch (GstPgmSrc* io_src)
+{
+  /* open and close swap the poll under the object lock */
+  GST_OBJECT_LOCK (io_src);
+  if ( io_src->poll != NULL   // no transport yet, opening picks it up
+     && g_atomic_int_compare_and_exchange (&io_src->switch_pending, FALSE, TRUE)
+     )
+  {
+    gst_poll_write_control (io_src->poll);
+  }
+  GST_OBJECT_UNLOCK (io_src);
+}
+
+/* Downstream still holds data of the old channel, drop it and start a new
+ * segment.
+ */
+static void gst_pgm_src_push_flush (GstPgmSrc* io_src)
+{
+  GstPad* pad = GST_BASE_SRC_PAD (io_src);
+
+  gst_pad_push_event (pad, gst_event_new_flush_start ());
+  gst_pad_push_event (pad, gst_event_new_flush_stop (FALSE));
+  gst_pad_push_event (pad, gst_event_new_segment (&GST_BASE_SRC (io_src)->segment));
+
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, io_src->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    GstPgmSrcStream* stream = value;
+    if (NULL == stream->pad) continue;
+
+    gst_pad_push_event (stream->pad, gst_event_new_flush_start ());
+    gst_pad_push_event (stream->pad, gst_event_new_flush_stop (FALSE));
+    gst_pad_push_event (stream->pad, gst_event_new_segment (&stream->segment));
+  }
+
+  io_src->flush_pending = FALSE;
+}
+
+/* create PGM transports, one per path plus the standby receivers
+ */
+static gboolean gst_pgm_src_open (GstPgmSrc* src)
+{
+  struct pgm_error_t* pErr = NULL;
+
+	if (!pgm_init (&pErr)) {
+		g_error ("Unable to start PGM engine: %s", pErr->message);
+		pgm_error_free (pErr);
+		return FALSE;
+	}
+
+  gst_pgm_src_choose_framing (src);
+  src->transport_dirty = FALSE;
+
+  /* learnt intervals survive rebuilding the transport */
+  GST_OBJECT_LOCK (src);
+  if (!src->nak_adaptive || !src->nak_estimated)
+  {
+    src->nak_effective.bo_ivl    = src->nak_bo_ivl;
+    src->nak_effective.rpt_ivl   = src->nak_rpt_ivl;
+    src->nak_effective.rdata_ivl = src->nak_rdata_ivl;
+  }
+  gchar* network = g_strdup (src->network);
+  const guint port           = src->port;
+  const guint udp_encap_port = src->udp_encap_port;
+  GST_OBJECT_UNLOCK (src);
+
+  src->transport = gst_pgm_src_open_transport (src, network, port, udp_encap_port);
+  g_free (network);
+  if (src->transport == NULL) return FALSE;
+
+  GstClockTime setup_time = src->transport->setup_time;
+
+  if (src->redundant_network)
+  {
+    src->redundant_transport = gst_pgm_src_open_transport (src, src->redundant_network, port, udp_encap_port);
+    if (src->redundant_transport == NULL) goto destroy_transport;
+
+    setup_time += src->redundant_transport->setup_time;
+  }
+
+  if (src->droppable_port)
+  {
+    src->droppable_transport = gst_pgm_transport_open 
+      ( GST_ELEMENT_CAST (src)
+      , src->network
+      , src->droppable_port
+      , udp_encap_port
+      , gst_pgm_src_configure
+      , GINT_TO_POINTER (TRUE)
+      );
+    if (src->droppable_transport == NULL) goto destroy_transport;
+
+    setup_time += src->droppable_transport->setup_time;
+  }
+
+  GstPoll* poll = gst_poll_new (TRUE);
+  GST_OBJECT_LOCK (src);
+  src->poll = poll;
+  GST_OBJECT_UNLOCK (src);
+  gst_pgm_src_poll_transport (src, src->transport, TRUE);
+  if (src->redundant_transport) gst_pgm_src_poll_transport (src, src->redundant_transport, TRUE);
+  if (src->droppable_transport) gst_pgm_src_poll_transport (src, src->droppable_transport, TRUE);
+
+  if (!gst_pgm_src_open_standby (src, &setup_time)) goto destroy_transport;
+
+  src->switch_pending = FALSE;
+  src->tiered = NULL != src->droppable_transport && GST_PGM_FRAMING_RAW != src->framing;
+  GstAllocator* allocator = gst_pgm_allocator_new (gst_pgm_transport_numa_node (src->transport), src->hugepages);
+  GST_OBJECT_LOCK (src);
+  src->allocator = allocator;
+  GST_OBJECT_UNLOCK (src);
+
+  gst_pgm_src_read_drops (src, &src->drops_base);
+  src->lost_sequences = 0;
+  src->resets         = 0;
+
+  gst_pgm_transport_post_setup (GST_ELEMENT_CAST (src), 1 + (src->redundant_transport ? 1 : 0) + (src->droppable_transport ? 1 : 0) + src->standby->len, setup_time);
+  return TRUE;
+
+destroy_transport:
+  gst_pgm_src_close (src);
+  return FALSE;
+}
+
+/* destroy PGM transports 
+ */
+static void gst_pgm_src_close (GstPgmSrc* src)
+{
+  GST_DEBUG_OBJECT (src, "destroying transport");
+
+  gst_pgm_src_close_standby (src);
+  gst_pgm_src_join_retune (src, FALSE);
+  src->retune_paths = 0;
+
+  GST_OBJECT_LOCK (src);
+  GstPoll* poll = src->poll;
+  src->poll = NULL;
+  GST_OBJECT_UNLOCK (src);
+  if (poll) gst_poll_free (poll);
+
+  for (guint i = 0; i < G_N_ELEMENTS(src->retune); ++i)
+  {
+    gst_pgm_transport_close (src->retune[i]);
+    src->retune[i] = NULL;
+  }
+
+  gst_pgm_transport_close (src->droppable_transport);
+  src->droppable_transport = NULL;
+
+  gst_pgm_transport_close (src->redundant_transport);
+  src->redundant_transport = NULL;
+
+  gst_pgm_transport_close (src->transport);
+  src->transport = NULL;
+
+  gst_pgm_src_detach_shm (src);
+
+  GST_OBJECT_LOCK (src);
+  GstAllocator* allocator = src->allocator;
+  src->allocator = NULL;
+  GST_OBJECT_UNLOCK (src);
+  if (allocator) gst_object_unref (allocator);
+}
+
+/* The transports live from READY to NULL, so that a pipeline cycling
+ * through READY and PAUSED does not set them up again every time.
+ */
+static GstStateChangeReturn gst_pgm_src_change_state (GstElement* element, GstStateChange transition)
+{
+  GstPgmSrc* src = GST_PGM_SRC (element);
+
+  GstPgmSrcClass* klass = GST_PGM_SRC_GET_CLASS (src);
+
+  if (GST_STATE_CHANGE_NULL_TO_READY == transition)
+  {
+    if (!klass->open (src)) return GST_STATE_CHANGE_FAILURE;
+  }
+
+  const GstStateChangeReturn ret = GST_ELEMENT_CLASS (gst_pgm_src_parent_class)->change_state (element, transition);
+
+  if ( GST_STATE_CHANGE_READY_TO_NULL == transition
+     || (GST_STATE_CHANGE_NULL_TO_READY == transition && GST_STATE_CHANGE_FAILURE == ret)
+     )
+  {
+    klass->close (src);
+  }
+
+  return ret;
+}
+
+/* rebuild the transports if a socket property changed since they were
+ * opened, else throw away what arrived while not streaming
+ */
+static gboolean gst_pgm_client_src_start (GstBaseSrc* basesrc)
+{
+  GstPgmSrc* src = GST_PGM_SRC (basesrc);
+
+  GST_OBJECT_LOCK (src);
+  const gboolean keys_ok = NULL == src->keys || NULL != src->crypto;
+  GST_OBJECT_UNLOCK (src);
+  if (!keys_ok)
+  {
+    GST_ELEMENT_ERROR (src, RESOURCE, SETTINGS, (NULL), ("keys do not parse"));
+    return FALSE;
+  }
+
+  if (src->transport_dirty || src->transport == NULL)
+  {
+    GST_DEBUG_OBJECT (src, "socket properties changed, rebuilding transport");
+    GST_PGM_SRC_GET_CLASS (src)->close (src);
+    if (!GST_PGM_SRC_GET_CLASS (src)->open (src)) return FALSE;
+  }
+  else
+  {
+    GstClockTime timeout = GST_CLOCK_TIME_NONE;
+
+    gst_pgm_src_drain_transport (src, src->transport, &timeout);
+    if (src->redundant_transport) gst_pgm_src_drain_transport (src, src->redundant_transport, &timeout);
+    if (src->droppable_transport) gst_pgm_src_drain_transport (src, src->droppable_transport, &timeout);
+    gst_pgm_src_drain_standby (src, &timeout);
+  }
+
+  gst_poll_set_flushing (src->poll, FALSE);
+
+  src->path           = 0;
+  src->have_sequence  = FALSE;
+  src->have_ts_offset = FALSE;
+  gst_pgm_src_clock_reset (src);
+  src->discont        = FALSE;
+  src->main_discont   = FALSE;
+  src->main_end       = GST_CLOCK_TIME_NONE;
+  src->main_waiting   = src->wait_keyframe;
+
+  if (src->capture_location)
+  {
+    src->capture = gst_pgm_capture_open (src->capture_location);
+    if (NULL == src->capture)
+    {
+      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE, (NULL), ("cannot capture to %s: %s", src->capture_location, g_strerror (errno)));
+      return FALSE;
+    }
+  }
+  src->keyframe_skipped = 0;
+  src->decrypt_failed   = 0;
+  src->decompress_failed = 0;
+  gst_pgm_inflate_clear (&src->main_inflate);
+  gst_pgm_src_tier_reset (src);
+  gst_pgm_src_peers_reset (src);
+
+  /* native framing brings the sender's timestamps, unless the user set
+   * do-timestamp */
+  const gboolean do_timestamp = GST_PGM_FRAMING_NATIVE != src->framing;
+  const gboolean user_timestamp = gst_base_src_get_do_timestamp (basesrc);
+
+  if (user_timestamp == src->do_timestamp_auto)
+  {
+    gst_base_src_set_do_timestamp (basesrc, do_timestamp);
+    src->do_timestamp_auto = do_timestamp;
+  }
+  else if (user_timestamp != do_timestamp)
   {
-    pgm_close (src->sock, TRUE);
-    src->sock = NULL;
+    GST_WARNING_OBJECT (src, "do-timestamp is set, %s", user_timestamp ? "the sender's timestamps are replaced" : "buffers go without timestamps");
   }
+  src->flush_pending  = FALSE;
+  src->stats_next     = g_get_monotonic_time ();
 
   return TRUE;
 }
 
+static gboolean gst_pgm_client_src_stop (GstBaseSrc* io_basesrc)
+{
+  GstPgmSrc* src = GST_PGM_SRC (io_basesrc);
+
+  gst_pgm_src_remove_streams (src);
+  gst_pgm_src_tier_reset (src);
+  gst_pgm_src_clock_reset (src);
+  gst_pgm_src_peers_reset (src);
+
+  if (src->capture)
+  {
+    fclose (src->capture);
+    src->capture = NULL;
+  }
+  return TRUE;
+}
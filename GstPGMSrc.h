@@ -28,6 +28,16 @@
 
 #include <pgm/pgm.h>
 
+#include "GstPGMTransport.h"
+#include "GstPGMRepair.h"
+#include "GstPGMPeer.h"
+#include "GstPGMClock.h"
+#include "GstPGMCapture.h"
+#include "GstPGMShm.h"
+#include "GstPGMCrypto.h"
+#include "GstPGMCompress.h"
+#include "GstPGMAllocator.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_PGM_SRC            (gst_pgm_src_get_type())
@@ -35,6 +45,29 @@ G_BEGIN_DECLS
 #define GST_PGM_SRC_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PGM_SRC,GstPgmSrcClass))
 #define GST_IS_PGM_SRC(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PGM_SRC))
 #define GST_IS_PGM_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PGM_SRC))
+#define GST_PGM_SRC_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj),GST_TYPE_PGM_SRC,GstPgmSrcClass))
+
+/* the sessions APDUs arrive on */
+#define GST_PGM_SRC_PATH_MAIN       0
+#define GST_PGM_SRC_PATH_REDUNDANT  1
+#define GST_PGM_SRC_PATH_DROPPABLE  2
+
+/* An elementary stream tagged by a pgmsink request pad.
+ */
+typedef struct _GstPgmSrcStream GstPgmSrcStream;
+
+struct _GstPgmSrcStream
+{
+  guint16     id;
+  GstPad*     pad;        // sometimes pad, once caps arrived
+  gchar*      caps;
+  GstSegment  segment;
+  gboolean    discont;
+  GstClockTime end;       // of the last buffer pushed
+  gboolean    waiting;    // for a key unit
+  GstPgmInflate inflate;
+  gboolean    droppable_lost;   // may have lost one, a gap is pushed before the next buffer
+};
 
 typedef struct _GstPgmSrc GstPgmSrc;
 typedef struct _GstPgmSrcClass GstPgmSrcClass;
@@ -44,9 +77,19 @@ struct _GstPgmSrc
   GstPushSrc  parent;
   GstPad*     srcpad;
   GstCaps*    caps;
+  gboolean    caps_fixed;     // set as property, not taken from native framing
+  gchar*      native_caps;
 
-  struct pgm_sock_t*  sock;
+  GstPgmTransport*    transport;
+  GstPgmTransport*    redundant_transport;
+  GstPgmTransport*    droppable_transport;
+  gboolean            transport_dirty;
   struct pgm_msgv_t*  msgv;
+  GstPoll*            poll;
+
+  GPtrArray*  standby;
+  gint        switch_pending;
+  gboolean    flush_pending;
 
   gchar* network;
   guint  port;
@@ -55,6 +98,10 @@ struct _GstPgmSrc
   guint  max_tpdu;
   guint  hops;
   guint  rxw_sqns;
+  guint  rxw_secs;
+  guint  max_rate;
+  guint64 window_budget;
+  gint   congestion_control;
   guint  peer_expiry;
   guint  spmr_expiry;
   guint  nak_bo_ivl;
@@ -62,15 +109,101 @@ struct _GstPgmSrc
   guint  nak_rdata_ivl;
   guint  nak_data_retries;
   guint  nak_ncf_retries;
+  gchar* redundant_network;
+  gint   framing;
+  gboolean framing_set;       // by the user, not changed for features that need a header
+  gboolean do_timestamp_auto; // what start last set do-timestamp to, anything else is the user's
+  gchar* standby_uris;
+  guint  stats_interval;
+  gboolean nak_adaptive;
+  guint  nak_adapt_min;
+  guint  nak_adapt_max;
+
+  guint     path;
+  gboolean  have_sequence;
+  guint32   next_sequence;
+  gboolean  discont;
+  gboolean  main_discont;     // discont of the always pad, native framing has more
+  GstClockTime main_end;      // end of the last buffer on the always pad
+  gboolean  wait_keyframe;
+  gboolean  main_waiting;     // for a key unit on the always pad
+  guint64   keyframe_skipped; // buffers dropped waiting for key units
+  GstPgmInflate main_inflate; // dictionaries of the always pad
+  guint64   decompress_failed;
+
+  guint     droppable_port;
+  gboolean  tiered;           // droppable APDUs arrive apart, see gst_pgm_src_merge_tiers
+  gboolean  have_anchor;
+  guint32   anchor;           // sequence of the last reliable APDU delivered
+  gboolean  main_droppable_lost;  // droppable_lost of the always pad
+  GQueue    tier_held;        // droppable APDUs waiting for their anchor
+  gsize     tier_held_bytes;  // and their size
+  GQueue    tier_ready;       // APDUs in sending order, to be delivered
+  GHashTable* streams;        // stream id -> GstPgmSrcStream
+  gboolean  have_ts_offset;
+  gint64    ts_offset;        // native framing, sender to local running time
+
+  gboolean           provide_clock;
+  guint              latency;
+  GstClock*          clock;           // slaved to the sender's
+  GstPgmClockFilter  clock_filter;
+  gboolean           clock_synced;
+  GstClockTime       remote_base_time;
+
+  gchar*             capture_location;
+  FILE*              capture;
+
+  gboolean           use_shm;
+  GstPgmShm*         shm;             // ring of a pgmsink on this host
+  GByteArray*        shm_record;
+  gint64             shm_next_attach;
+
+  gchar*             keys;
+  GstPgmCrypto*      crypto;          // NULL if keys do not parse
+  guint64            decrypt_failed;
+
+  gboolean           hugepages;
+  GstAllocator*      allocator;       // received APDUs, local to the interface
+
+  gint64             stats_next;
+  guint64            lost_sequences;
+  guint64            resets;
+  GstPgmKernelDrops  drops_base;
+  GstStructure*      stats;
+
+  GHashTable*         senders;        // TSI -> GstPgmPeer, receive thread only
+  guint               peer_threshold; // percent
+  GPtrArray*          peers;          // pgm-peer-stats as last published
+  gboolean            nak_estimated;
+  guint               repair_rtt;
+  GstPgmNakIntervals  nak_effective;
+  GstPgmTransport*    retune[2];        // primary and redundant path with new NAK intervals
+  gint64              retune_until[2];  // monotonic, old socket closed then, 0 until retune delivers
+  guint               retune_paths;     // mask of paths due a retune, receive thread only
+  GThread*            retune_thread;    // opens retune sockets off the streaming thread
+  guint               retune_building;  // mask of paths retune_thread opens sockets for
+  GstPgmTransport*    retune_built[2];  // handed over by retune_thread, object lock
+  gint                retune_done;      // atomic, retune_thread has handed over
 };
 
 struct _GstPgmSrcClass
 {
   GstPushSrcClass parent_class;
+
+  /* where APDUs come from, the PGM transports unless a subclass replays
+   * them */
+  gboolean      (*open)    (GstPgmSrc*);
+  void          (*close)   (GstPgmSrc*);
+  GstFlowReturn (*receive) (GstPgmSrc*, GstBuffer**);
 };
 
 GType gst_pgm_src_get_type (void);
 
+void      gst_pgm_src_choose_framing (GstPgmSrc*);
+gboolean  gst_pgm_src_handle_apdu (GstPgmSrc*, guint, const struct pgm_msgv_t*, size_t, GstBuffer**, GstFlowReturn*);
+void      gst_pgm_src_handle_reset (GstPgmSrc*, guint, const struct pgm_msgv_t*);
+gboolean  gst_pgm_src_take_ready (GstPgmSrc*, GstBuffer**, GstFlowReturn*);
+
 G_END_DECLS
 
 #endif // GST_PGM_SRC_H 
@@ -0,0 +1,440 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer shared transport
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/sock_diag.h>
+
+#include "GstPGMTransport.h"
+#include "GstPGMConfig.h"
+
+GType gst_pgm_congestion_control_get_type (void)
+{
+  static GType cc_type = 0;
+  static const GEnumValue cc[] =
+    { { GST_PGM_CONGESTION_CONTROL_NONE , "No congestion control"   , "none"  }
+    , { GST_PGM_CONGESTION_CONTROL_PGMCC, "PGMCC, RFC 3208 annex"   , "pgmcc" }
+    , { 0, NULL, NULL }
+    };
+
+  if (!cc_type)
+  {
+    cc_type = g_enum_register_static ("GstPgmCongestionControl", cc);
+  }
+  return cc_type;
+}
+
+/* create, bind and connect a PGM socket on the given network, NULL after
+ * posting an element error
+ */
+GstPgmTransport* gst_pgm_transport_open ( GstElement* element
+                                        , const gchar* network
+                                        , guint port
+                                        , guint udp_encap_port
+                                        , GstPgmTransportConfigure configure
+                                        , gpointer user_data
+                                        )
+{
+  const gint64 begin = g_get_monotonic_time ();
+  const int valFalse = 0;
+
+	sa_family_t sa_family = AF_UNSPEC;
+  struct pgm_addrinfo_t* res = NULL;
+  struct pgm_sock_t* sock = NULL;
+  struct pgm_error_t* pErr = NULL;
+
+  if (!pgm_getaddrinfo (network, NULL, &res, &pErr)) 
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("Parsing network parameter: %s", pErr->message));
+    pgm_error_free (pErr);
+    return NULL;
+  }
+
+	sa_family = res->ai_send_addrs[0].gsr_group.ss_family;
+
+  if (!pgm_socket (&sock, sa_family, SOCK_SEQPACKET, IPPROTO_UDP, &pErr)) 
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("Creating transport: %s", pErr->message));
+    pgm_error_free (pErr);
+    pgm_freeaddrinfo (res);
+    return NULL;
+  }
+
+  if (!configure (element, sock, user_data)) goto destroy_transport;
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_UDP_ENCAP_UCAST_PORT, &udp_encap_port, sizeof(udp_encap_port)))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("cannot set UDP encap ucast port"));
+    goto destroy_transport;
+  }
+  
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_UDP_ENCAP_MCAST_PORT, &udp_encap_port, sizeof(udp_encap_port)))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("cannot set UDP encap mcast port"));
+    goto destroy_transport;
+  }
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_IP_ROUTER_ALERT, &valFalse, sizeof(valFalse))) 
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("cannot unset the router assist"));
+    goto destroy_transport;
+  }
+
+  struct pgm_sockaddr_t addr;
+  memset (&addr, '\0', sizeof(addr));
+  addr.sa_port = port;
+  addr.sa_addr.sport = DEFAULT_DATA_SOURCE_PORT;
+
+  if (!pgm_gsi_create_from_hostname (&addr.sa_addr.gsi, &pErr))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("Creating GSI: %s", pErr->message));
+    pgm_error_free (pErr);
+    goto destroy_transport;
+  }
+
+  struct pgm_interface_req_t ifReq;
+  memset (&ifReq, '\0', sizeof(ifReq));
+  ifReq.ir_interface = res->ai_recv_addrs[0].gsr_interface;
+  ifReq.ir_scope_id  = 0;
+
+	if (AF_INET6 == sa_family) 
+  {
+		struct sockaddr_in6 sa6;
+		memcpy (&sa6, &res->ai_recv_addrs[0].gsr_group, sizeof(sa6));
+		ifReq.ir_scope_id = sa6.sin6_scope_id;
+	}
+
+  if (!pgm_bind3 ( sock
+                 , &addr, sizeof(addr)
+                 , &ifReq, sizeof(ifReq)  // tx interface
+                 , &ifReq, sizeof(ifReq)  // rx interface
+                 , &pErr
+                 )
+     )
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("Binding transport: %s", pErr->message));
+    pgm_error_free (pErr);
+    goto destroy_transport;
+  }
+
+	for (unsigned i = 0; i < res->ai_recv_addrs_len; ++i)
+  {
+		pgm_setsockopt (sock, IPPROTO_PGM, PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct group_req));
+  }
+	pgm_setsockopt (sock, IPPROTO_PGM, PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct group_req));
+
+	if (!pgm_connect (sock, &pErr))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, OPEN_READ_WRITE, (NULL), ("Connecting socket: %s", pErr->message));
+    pgm_error_free (pErr);
+    goto destroy_transport;
+	}
+
+  GstPgmTransport* transport = g_new0 (GstPgmTransport, 1);
+  transport->sock           = sock;
+  transport->res            = res;   // kept to leave the groups again
+  transport->network        = g_strdup (network);
+  transport->port           = port;
+  transport->udp_encap_port = udp_encap_port;
+  transport->setup_time     = (GstClockTime)(g_get_monotonic_time () - begin) * GST_USECOND;
+
+  GST_DEBUG_OBJECT (element, "transport on %s set up in %" GST_TIME_FORMAT, network, GST_TIME_ARGS (transport->setup_time));
+
+  return transport;
+
+destroy_transport:
+  pgm_freeaddrinfo (res);
+  pgm_close (sock, TRUE);
+  return NULL;
+}
+
+void gst_pgm_transport_close (GstPgmTransport* io_transport)
+{
+  if (io_transport == NULL) return;
+
+  pgm_close (io_transport->sock, TRUE);
+  pgm_freeaddrinfo (io_transport->res);
+  g_free (io_transport->network);
+  g_free (io_transport);
+}
+
+/* Move a connected socket to the groups of another network on the same
+ * interface: leave the old groups and join the new ones. FALSE when the
+ * network needs a socket of its own.
+ */
+gboolean gst_pgm_transport_rejoin (GstPgmTransport* io_transport, const gchar* i_network)
+{
+  struct pgm_addrinfo_t* res = NULL;
+  struct pgm_error_t* pErr = NULL;
+  const struct pgm_addrinfo_t* cur = io_transport->res;
+
+  if (!pgm_getaddrinfo (i_network, NULL, &res, &pErr)) 
+  {
+    GST_WARNING ("Parsing network parameter: %s", pErr->message);
+    pgm_error_free (pErr);
+    return FALSE;
+  }
+
+  if ( res->ai_send_addrs[0].gsr_group.ss_family != cur->ai_send_addrs[0].gsr_group.ss_family
+     || res->ai_recv_addrs[0].gsr_interface != cur->ai_recv_addrs[0].gsr_interface
+     )
+  {
+    pgm_freeaddrinfo (res);
+    return FALSE;
+  }
+
+	for (unsigned i = 0; i < cur->ai_recv_addrs_len; ++i)
+  {
+		pgm_setsockopt (io_transport->sock, IPPROTO_PGM, PGM_LEAVE_GROUP, &cur->ai_recv_addrs[i], sizeof(struct group_req));
+  }
+	for (unsigned i = 0; i < res->ai_recv_addrs_len; ++i)
+  {
+		pgm_setsockopt (io_transport->sock, IPPROTO_PGM, PGM_JOIN_GROUP, &res->ai_recv_addrs[i], sizeof(struct group_req));
+  }
+  /* may be refused on a connected socket, NAKs go to the source NLA anyway */
+	pgm_setsockopt (io_transport->sock, IPPROTO_PGM, PGM_SEND_GROUP, &res->ai_send_addrs[0], sizeof(struct group_req));
+
+  pgm_freeaddrinfo (io_transport->res);
+  io_transport->res = res;
+
+  g_free (io_transport->network);
+  io_transport->network = g_strdup (i_network);
+  return TRUE;
+}
+
+/* Size the transmit (i_transmit) or receive window of a socket that is not
+ * connected yet. With i_secs and i_max_rate (bits per second) OpenPGM sizes
+ * it to cover i_secs of the stream, else it holds i_sqns packets. A non-zero
+ * i_budget caps the window at that many bytes of i_max_tpdu packets. A
+ * non-zero i_max_rate is set whatever the sizing, it also limits the rate.
+ */
+gboolean gst_pgm_transport_set_window ( GstElement* element
+                                      , struct pgm_sock_t* sock
+                                      , gboolean i_transmit
+                                      , guint i_sqns
+                                      , guint i_secs
+                                      , guint i_max_rate
+                                      , guint64 i_budget
+                                      , guint i_max_tpdu
+                                      )
+{
+  const int opt_sqns    = i_transmit ? PGM_TXW_SQNS    : PGM_RXW_SQNS;
+  const int opt_secs    = i_transmit ? PGM_TXW_SECS    : PGM_RXW_SECS;
+  const int opt_max_rte = i_transmit ? PGM_TXW_MAX_RTE : PGM_RXW_MAX_RTE;
+
+  const guint64 budget_sqns = i_budget / MAX (i_max_tpdu, 1);
+  guint sqns = i_sqns;
+
+  if (i_secs > 0 && i_max_rate == 0)
+  {
+    GST_WARNING_OBJECT (element, "window seconds need max-rate, sizing by sequence numbers");
+  }
+
+  /* the rate also drives OpenPGM's rate control, set it in any case */
+  const unsigned max_rte = i_max_rate / 8;
+  if (max_rte > 0 && !pgm_setsockopt (sock, IPPROTO_PGM, opt_max_rte, &max_rte, sizeof(max_rte)))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, SETTINGS, (NULL), ("cannot set window maximum rate"));
+    return FALSE;
+  }
+
+  if (i_secs > 0 && i_max_rate > 0)
+  {
+    const guint64 window_sqns = (guint64) i_secs * max_rte / MAX (i_max_tpdu, 1);
+
+    if (i_budget == 0 || window_sqns <= budget_sqns)
+    {
+      if (!pgm_setsockopt (sock, IPPROTO_PGM, opt_secs, &i_secs, sizeof(i_secs)))
+      {
+        GST_ELEMENT_ERROR (element, RESOURCE, SETTINGS, (NULL), ("cannot set window seconds"));
+        return FALSE;
+      }
+      GST_DEBUG_OBJECT (element, "window of %us at %u bit/s, about %" G_GUINT64_FORMAT " sequences", i_secs, i_max_rate, window_sqns);
+      return TRUE;
+    }
+
+    GST_WARNING_OBJECT (element, "%us window needs %" G_GUINT64_FORMAT " sequences, budget allows %" G_GUINT64_FORMAT, i_secs, window_sqns, budget_sqns);
+    sqns = (guint) budget_sqns;
+  }
+  else if (i_budget > 0 && sqns > budget_sqns)
+  {
+    GST_WARNING_OBJECT (element, "window of %u sequences over budget, using %" G_GUINT64_FORMAT, sqns, budget_sqns);
+    sqns = (guint) budget_sqns;
+  }
+
+  sqns = MAX (sqns, 1);
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, opt_sqns, &sqns, sizeof(sqns)))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, SETTINGS, (NULL), ("cannot set window sequence numbers"));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* PGMCC has to be enabled on both ends, receivers elected as ACKer answer
+ * the sender's ACK requests
+ */
+gboolean gst_pgm_transport_set_congestion_control (GstElement* element, struct pgm_sock_t* sock, gint i_mode)
+{
+  if (GST_PGM_CONGESTION_CONTROL_PGMCC != i_mode) return TRUE;
+
+  const struct pgm_pgmccinfo_t pgmccinfo = { .ack_bo_ivl = PGM_DEFAULT_PGMCC_ACK_BO_IVL
+                                           , .ack_c      = PGM_DEFAULT_PGMCC_ACK_C
+                                           , .ack_c_p    = PGM_DEFAULT_PGMCC_ACK_C_P
+                                           };
+
+  if (!pgm_setsockopt (sock, IPPROTO_PGM, PGM_USE_PGMCC, &pgmccinfo, sizeof(pgmccinfo)))
+  {
+    GST_ELEMENT_ERROR (element, RESOURCE, SETTINGS, (NULL), ("cannot enable PGMCC"));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* tell the application how long bringing up the transports took
+ */
+void gst_pgm_transport_post_setup (GstElement* element, guint i_transports, GstClockTime i_duration)
+{
+  gst_element_post_message 
+    ( element
+    , gst_message_new_element 
+      ( GST_OBJECT_CAST (element)
+      , gst_structure_new 
+        ( "pgm-transport-setup"
+        , "transports", G_TYPE_UINT  , i_transports
+        , "duration"  , G_TYPE_UINT64, (guint64) i_duration
+        , NULL
+        )
+      )
+    );
+}
+
+static guint64 gst_pgm_read_counter (const gchar* i_path)
+{
+  gchar* contents = NULL;
+  guint64 value = 0;
+
+  if (g_file_get_contents (i_path, &contents, NULL, NULL))
+  {
+    value = g_ascii_strtoull (contents, NULL, 10);
+    g_free (contents);
+  }
+  return value;
+}
+
+/* Add the drops of the transport's data socket and, if i_interface, of the
+ * interface it receives on. The socket counter needs SO_MEMINFO (Linux
+ * 4.12), SO_RXQ_OVFL only reports through recvmsg control data, which
+ * OpenPGM keeps to itself.
+ */
+void gst_pgm_transport_read_drops (const GstPgmTransport* i_transport, gboolean i_interface, GstPgmKernelDrops* io_drops)
+{
+#ifdef SO_MEMINFO
+  int fd = -1;
+  socklen_t optlen = sizeof(fd);
+
+  if (pgm_getsockopt (i_transport->sock, IPPROTO_PGM, PGM_RECV_SOCK, &fd, &optlen))
+  {
+    guint32 meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+
+    if (getsockopt (fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0)
+    {
+      io_drops->socket_drops += meminfo[SK_MEMINFO_DROPS];
+    }
+  }
+#endif
+
+  if (!i_interface) return;
+
+  char ifname[IF_NAMESIZE];
+  if (if_indextoname (i_transport->res->ai_recv_addrs[0].gsr_interface, ifname) == NULL) return;
+
+  static const gchar* counters[] = { "rx_dropped", "rx_fifo_errors", "rx_missed_errors" };
+  guint64* values[] = { &io_drops->rx_dropped, &io_drops->rx_fifo_errors, &io_drops->rx_missed_errors };
+
+  for (unsigned i = 0; i < G_N_ELEMENTS(counters); ++i)
+  {
+    gchar* path = g_strdup_printf ("/sys/class/net/%s/statistics/%s", ifname, counters[i]);
+    *values[i] += gst_pgm_read_counter (path);
+    g_free (path);
+  }
+}
+
+/* NUMA node of the device behind the interface the transport receives
+ * on, -1 if unknown or the host has only one
+ */
+gint gst_pgm_transport_numa_node (const GstPgmTransport* i_transport)
+{
+  char ifname[IF_NAMESIZE];
+  gchar* contents = NULL;
+  gint node = -1;
+
+  if (if_indextoname (i_transport->res->ai_recv_addrs[0].gsr_interface, ifname) == NULL) return -1;
+
+  gchar* path = g_strdup_printf ("/sys/class/net/%s/device/numa_node", ifname);
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+  {
+    node = (gint) g_ascii_strtoll (contents, NULL, 10);
+    g_free (contents);
+  }
+  g_free (path);
+
+  return node;
+}
+
+/* UDP datagrams dropped host wide because a socket buffer was full, from
+ * the header and value lines of the "Udp:" section of /proc/net/snmp
+ */
+void gst_pgm_kernel_drops_read_host (GstPgmKernelDrops* io_drops)
+{
+  gchar* contents = NULL;
+
+  if (!g_file_get_contents ("/proc/net/snmp", &contents, NULL, NULL)) return;
+
+  gchar** lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  for (gchar** line = lines; line[0] && line[1]; ++line)
+  {
+    if (!g_str_has_prefix (line[0], "Udp:") || !g_str_has_prefix (line[1], "Udp:")) continue;
+
+    gchar** names  = g_strsplit (line[0], " ", -1);
+    gchar** values = g_strsplit (line[1], " ", -1);
+
+    for (unsigned i = 0; names[i] && values[i]; ++i)
+    {
+      if (strcmp (names[i], "RcvbufErrors") == 0)
+      {
+        io_drops->udp_rcvbuf_errors += g_ascii_strtoull (values[i], NULL, 10);
+      }
+    }
+
+    g_strfreev (names);
+    g_strfreev (values);
+    break;
+  }
+
+  g_strfreev (lines);
+}
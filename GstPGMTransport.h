@@ -0,0 +1,106 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer shared transport
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GST_PGM_TRANSPORT_H
+#define GST_PGM_TRANSPORT_H
+
+#include <gst/gst.h>
+
+#include <pgm/pgm.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PGM_CONGESTION_CONTROL  (gst_pgm_congestion_control_get_type())
+
+typedef enum
+{
+  GST_PGM_CONGESTION_CONTROL_NONE   = 0,
+  GST_PGM_CONGESTION_CONTROL_PGMCC  = 1   // sender paced by ACKs of the slowest receiver
+} GstPgmCongestionControl;
+
+typedef struct _GstPgmTransport GstPgmTransport;
+
+/* Applies the options that differ between sender and receiver to a fresh
+ * socket, posting an element error and returning FALSE on failure.
+ */
+typedef gboolean (*GstPgmTransportConfigure) (GstElement*, struct pgm_sock_t*, gpointer);
+
+/* One bound and connected PGM socket together with what it was opened on.
+ * Setting up a socket takes a few dozen system calls and a hostname
+ * lookup, so elements open their transports when going to READY and keep
+ * them until they go back to NULL or a socket property changes.
+ */
+struct _GstPgmTransport
+{
+  struct pgm_sock_t*      sock;
+  struct pgm_addrinfo_t*  res;
+
+  gchar*  network;
+  guint   port;
+  guint   udp_encap_port;
+
+  GstClockTime  setup_time;
+};
+
+/* Receive drops counted by the kernel rather than by PGM, to tell local
+ * overruns from loss on the wire.
+ */
+typedef struct _GstPgmKernelDrops GstPgmKernelDrops;
+
+struct _GstPgmKernelDrops
+{
+  guint64  socket_drops;        // data socket receive buffer full
+  guint64  rx_dropped;          // interface, /sys/class/net/<if>/statistics
+  guint64  rx_fifo_errors;
+  guint64  rx_missed_errors;
+  guint64  udp_rcvbuf_errors;   // host wide, /proc/net/snmp
+};
+
+GType             gst_pgm_congestion_control_get_type (void);
+
+GstPgmTransport*  gst_pgm_transport_open ( GstElement*
+                                         , const gchar*
+                                         , guint
+                                         , guint
+                                         , GstPgmTransportConfigure
+                                         , gpointer
+                                         );
+void              gst_pgm_transport_close (GstPgmTransport*);
+gboolean          gst_pgm_transport_rejoin (GstPgmTransport*, const gchar*);
+gboolean          gst_pgm_transport_set_window ( GstElement*
+                                               , struct pgm_sock_t*
+                                               , gboolean
+                                               , guint
+                                               , guint
+                                               , guint
+                                               , guint64
+                                               , guint
+                                               );
+gboolean          gst_pgm_transport_set_congestion_control (GstElement*, struct pgm_sock_t*, gint);
+void              gst_pgm_transport_post_setup (GstElement*, guint, GstClockTime);
+void              gst_pgm_transport_read_drops (const GstPgmTransport*, gboolean, GstPgmKernelDrops*);
+void              gst_pgm_kernel_drops_read_host (GstPgmKernelDrops*);
+gint              gst_pgm_transport_numa_node (const GstPgmTransport*);
+
+G_END_DECLS
+
+#endif // GST_PGM_TRANSPORT_H
@@ -0,0 +1,132 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer benchmark process and latency statistics
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <gst/gst.h>
+
+#include "PgmBenchStats.h"
+
+/* a "Name:   value" line of /proc/self/status */
+static guint64 pgm_bench_status_value (const gchar* i_status, const gchar* i_name)
+{
+  const gchar* line = strstr (i_status, i_name);
+  if (NULL == line) return 0;
+
+  return g_ascii_strtoull (line + strlen (i_name), NULL, 10);
+}
+
+void pgm_bench_usage_read (PgmBenchUsage* o_usage)
+{
+  struct rusage usage;
+  gchar* status = NULL;
+
+  memset (o_usage, 0, sizeof(*o_usage));
+  o_usage->time = g_get_monotonic_time ();
+
+  if (0 == getrusage (RUSAGE_SELF, &usage))
+  {
+    o_usage->cpu = (gint64) usage.ru_utime.tv_sec * G_USEC_PER_SEC + usage.ru_utime.tv_usec
+                 + (gint64) usage.ru_stime.tv_sec * G_USEC_PER_SEC + usage.ru_stime.tv_usec;
+    o_usage->voluntary_switches   = usage.ru_nvcsw;
+    o_usage->involuntary_switches = usage.ru_nivcsw;
+  }
+
+  if (g_file_get_contents ("/proc/self/status", &status, NULL, NULL))
+  {
+    o_usage->rss     = pgm_bench_status_value (status, "\nVmRSS:") * 1024;
+    o_usage->threads = pgm_bench_status_value (status, "\nThreads:");
+    g_free (status);
+  }
+}
+
+void pgm_bench_latency_init (PgmBenchLatency* o_latency)
+{
+  g_mutex_init (&o_latency->lock);
+  o_latency->samples = g_array_new (FALSE, FALSE, sizeof(gint64));
+}
+
+void pgm_bench_latency_clear (PgmBenchLatency* io_latency)
+{
+  g_array_free (io_latency->samples, TRUE);
+  g_mutex_clear (&io_latency->lock);
+}
+
+void pgm_bench_latency_reset (PgmBenchLatency* io_latency)
+{
+  g_mutex_lock (&io_latency->lock);
+  g_array_set_size (io_latency->samples, 0);
+  g_mutex_unlock (&io_latency->lock);
+}
+
+void pgm_bench_latency_add (PgmBenchLatency* io_latency, gint64 i_usecs)
+{
+  g_mutex_lock (&io_latency->lock);
+  g_array_append_val (io_latency->samples, i_usecs);
+  g_mutex_unlock (&io_latency->lock);
+}
+
+static gint pgm_bench_compare (gconstpointer i_a, gconstpointer i_b)
+{
+  const gint64 a = *(const gint64*) i_a;
+  const gint64 b = *(const gint64*) i_b;
+  return (a > b) - (a < b);
+}
+
+/* median, 99th percentile and maximum of the samples so far, returns how
+ * many there are, the outputs are left alone if none
+ */
+guint pgm_bench_latency_summary (PgmBenchLatency* io_latency, gint64* o_p50, gint64* o_p99, gint64* o_p999, gint64* o_max)
+{
+  g_mutex_lock (&io_latency->lock);
+  const guint count = io_latency->samples->len;
+  if (count > 0)
+  {
+    gint64* v = (gint64*) io_latency->samples->data;
+    qsort (v, count, sizeof(gint64), pgm_bench_compare);
+
+    *o_p50  = v[(count - 1) * 50 / 100];
+    *o_p99  = v[(count - 1) * 99 / 100];
+    *o_p999 = v[(count - 1) * 999 / 1000];
+    *o_max  = v[count - 1];
+  }
+  g_mutex_unlock (&io_latency->lock);
+
+  return count;
+}
+
+void pgm_bench_stamp_write (guint8* o_data, guint64 i_sequence)
+{
+  GST_WRITE_UINT64_BE (o_data, i_sequence);
+  GST_WRITE_UINT64_BE (o_data + 8, (guint64) g_get_monotonic_time ());
+}
+
+gboolean pgm_bench_stamp_read (const guint8* i_data, gsize i_size, guint64* o_sequence, gint64* o_sent)
+{
+  if (i_size < PGM_BENCH_STAMP_SIZE) return FALSE;
+
+  *o_sequence = GST_READ_UINT64_BE (i_data);
+  *o_sent     = (gint64) GST_READ_UINT64_BE (i_data + 8);
+  return TRUE;
+}
@@ -0,0 +1,71 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer benchmark process and latency statistics
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PGM_BENCH_STATS_H
+#define PGM_BENCH_STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* What the process used up to a point in time, from getrusage and
+ * /proc/self/status.
+ */
+typedef struct _PgmBenchUsage PgmBenchUsage;
+
+struct _PgmBenchUsage
+{
+  gint64   time;          // monotonic, microseconds
+  gint64   cpu;           // user and system, microseconds
+  guint64  rss;           // bytes
+  guint    threads;
+  guint64  voluntary_switches;
+  guint64  involuntary_switches;
+};
+
+/* Latency samples in microseconds, appended from streaming threads.
+ */
+typedef struct _PgmBenchLatency PgmBenchLatency;
+
+struct _PgmBenchLatency
+{
+  GMutex   lock;
+  GArray*  samples;       // gint64
+};
+
+void      pgm_bench_usage_read (PgmBenchUsage*);
+
+void      pgm_bench_latency_init (PgmBenchLatency*);
+void      pgm_bench_latency_clear (PgmBenchLatency*);
+void      pgm_bench_latency_reset (PgmBenchLatency*);
+void      pgm_bench_latency_add (PgmBenchLatency*, gint64);
+guint     pgm_bench_latency_summary (PgmBenchLatency*, gint64*, gint64*, gint64*, gint64*);
+
+/* payload stamp: 64 bit sequence, 64 bit monotonic send time */
+#define PGM_BENCH_STAMP_SIZE  16
+
+void      pgm_bench_stamp_write (guint8*, guint64);
+gboolean  pgm_bench_stamp_read (const guint8*, gsize, guint64*, gint64*);
+
+G_END_DECLS
+
+#endif // PGM_BENCH_STATS_H
@@ -0,0 +1,307 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer multi-session scaling benchmark
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Runs N pgmsink -> pgmsrc pairs in one process, each on a dport of its
+ * own, with fakesrc sending constant bitrate traffic, and ramps N until
+ * loss or latency break their limits:
+ *
+ *   GST_PLUGIN_PATH=. bench/pgmbench --start 1 --max 256 --rate 125000
+ *
+ * Every step runs --warmup seconds before it is measured for --duration
+ * seconds and prints one line: CPU (% of one core) and RSS growth per
+ * stream, threads, context switches per second, loss and latency
+ * percentiles over all streams. Buffers carry a sequence number and the
+ * send time, sender and receiver share the monotonic clock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+#include "PgmBenchStats.h"
+
+typedef struct
+{
+  guint64  sent;
+  guint64  received;
+  guint64  lost;
+  guint64  next;          // sequence expected next
+  gboolean have_next;
+} PgmBenchPair;
+
+typedef struct
+{
+  guint     start;
+  guint     max;
+  guint     step;         // 0 to double
+  guint     rate;         // bytes per second and stream
+  guint     packet;
+  guint     warmup;       // seconds
+  guint     duration;
+  gchar*    network;
+  guint     dport;
+  guint     udp_encap_port;
+  gboolean  shm;
+  gdouble   max_loss;     // fraction
+  guint     max_latency;  // milliseconds, 99th percentile
+
+  PgmBenchPair*    pairs;
+  PgmBenchLatency  latency;
+  gboolean         measuring;
+} PgmBench;
+
+static void pgm_bench_sent (GstElement* i_fakesrc, GstBuffer* io_buffer, GstPad* i_pad, gpointer io_pair)
+{
+  PgmBenchPair* pair = io_pair;
+  GstMapInfo map;
+
+  if (!gst_buffer_map (io_buffer, &map, GST_MAP_WRITE)) return;
+  if (map.size >= PGM_BENCH_STAMP_SIZE) pgm_bench_stamp_write (map.data, pair->sent++);
+  gst_buffer_unmap (io_buffer, &map);
+}
+
+static void pgm_bench_received (GstElement* i_fakesink, GstBuffer* i_buffer, GstPad* i_pad, gpointer io_pair)
+{
+  PgmBench* bench = g_object_get_data (G_OBJECT (i_fakesink), "pgm-bench");
+  PgmBenchPair* pair = io_pair;
+  GstMapInfo map;
+  guint64 sequence;
+  gint64 sent;
+
+  if (!gst_buffer_map (i_buffer, &map, GST_MAP_READ)) return;
+  const gboolean stamped = pgm_bench_stamp_read (map.data, map.size, &sequence, &sent);
+  gst_buffer_unmap (i_buffer, &map);
+  if (!stamped) return;
+
+  const gint64 now = g_get_monotonic_time ();
+  if (!g_atomic_int_get (&bench->measuring)) 
+  {
+    pair->have_next = FALSE;
+    return;
+  }
+
+  if (pair->have_next && sequence > pair->next) pair->lost += sequence - pair->next;
+  pair->next      = sequence + 1;
+  pair->have_next = TRUE;
+  pair->received++;
+
+  pgm_bench_latency_add (&bench->latency, now - sent);
+}
+
+static GstElement* pgm_bench_make (GstElement* io_pipeline, const gchar* i_factory)
+{
+  GstElement* element = gst_element_factory_make (i_factory, NULL);
+  if (NULL == element)
+  {
+    g_printerr ("no %s element, is GST_PLUGIN_PATH set?\n", i_factory);
+    exit (EXIT_FAILURE);
+  }
+  gst_bin_add (GST_BIN (io_pipeline), element);
+  return element;
+}
+
+/* fakesrc ! pgmsink and pgmsrc ! fakesink on dport + i_index */
+static void pgm_bench_add_pair (PgmBench* io_bench, GstElement* io_pipeline, guint i_index)
+{
+  PgmBenchPair* pair = &io_bench->pairs[i_index];
+
+  GstElement* src = pgm_bench_make (io_pipeline, "fakesrc");
+  gst_util_set_object_arg (G_OBJECT (src), "sizetype", "fixed");
+  gst_util_set_object_arg (G_OBJECT (src), "filltype", "zero");
+  g_object_set ( src
+               , "is-live"       , TRUE
+               , "sync"          , TRUE
+               , "sizemax"       , (gint) io_bench->packet
+               , "datarate"      , (gint) io_bench->rate
+               , "signal-handoffs", TRUE
+               , NULL
+               );
+  g_signal_connect (src, "handoff", G_CALLBACK (pgm_bench_sent), pair);
+
+  GstElement* sink = pgm_bench_make (io_pipeline, "pgmsink");
+  g_object_set ( sink
+               , "network"        , io_bench->network
+               , "dport"          , io_bench->dport + i_index
+               , "udp-encap-port" , io_bench->udp_encap_port
+               , "shm-size"       , io_bench->shm ? 4 << 20 : 0
+               , NULL
+               );
+  gst_element_link (src, sink);
+
+  GstElement* pgmsrc = pgm_bench_make (io_pipeline, "pgmsrc");
+  g_object_set ( pgmsrc
+               , "network"        , io_bench->network
+               , "dport"          , io_bench->dport + i_index
+               , "udp-encap-port" , io_bench->udp_encap_port
+               , "shm"            , io_bench->shm
+               , NULL
+               );
+
+  GstElement* fakesink = pgm_bench_make (io_pipeline, "fakesink");
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, "signal-handoffs", TRUE, NULL);
+  g_object_set_data (G_OBJECT (fakesink), "pgm-bench", io_bench);
+  g_signal_connect (fakesink, "handoff", G_CALLBACK (pgm_bench_received), pair);
+  gst_element_link (pgmsrc, fakesink);
+}
+
+/* wait, FALSE if the pipeline failed meanwhile */
+static gboolean pgm_bench_run_for (GstElement* i_pipeline, guint i_seconds)
+{
+  GstBus* bus = gst_element_get_bus (i_pipeline);
+  GstMessage* msg = gst_bus_timed_pop_filtered (bus, i_seconds * GST_SECOND, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (NULL == msg) return TRUE;
+
+  GError* err = NULL;
+  gst_message_parse_error (msg, &err, NULL);
+  g_printerr ("%s: %s\n", GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)), err->message);
+  g_error_free (err);
+  gst_message_unref (msg);
+  return FALSE;
+}
+
+/* one step of the ramp, FALSE once a limit is broken or it failed */
+static gboolean pgm_bench_step (PgmBench* io_bench, guint i_streams)
+{
+  PgmBenchUsage before, after, idle;
+  gint64 p50 = 0, p99 = 0, p999 = 0, max = 0;
+
+  pgm_bench_usage_read (&idle);
+
+  GstElement* pipeline = gst_pipeline_new ("pgmbench");
+  memset (io_bench->pairs, 0, i_streams * sizeof(PgmBenchPair));
+  for (guint i = 0; i < i_streams; ++i) pgm_bench_add_pair (io_bench, pipeline, i);
+
+  g_atomic_int_set (&io_bench->measuring, FALSE);
+  gboolean ok = GST_STATE_CHANGE_FAILURE != gst_element_set_state (pipeline, GST_STATE_PLAYING)
+             && pgm_bench_run_for (pipeline, io_bench->warmup);
+
+  if (ok)
+  {
+    pgm_bench_latency_reset (&io_bench->latency);
+    g_atomic_int_set (&io_bench->measuring, TRUE);
+    pgm_bench_usage_read (&before);
+
+    ok = pgm_bench_run_for (pipeline, io_bench->duration);
+
+    pgm_bench_usage_read (&after);
+    g_atomic_int_set (&io_bench->measuring, FALSE);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  if (!ok) return FALSE;
+
+  guint64 received = 0, lost = 0;
+  for (guint i = 0; i < i_streams; ++i)
+  {
+    received += io_bench->pairs[i].received;
+    lost     += io_bench->pairs[i].lost;
+  }
+  const guint samples = pgm_bench_latency_summary (&io_bench->latency, &p50, &p99, &p999, &max);
+
+  const gdouble seconds = (after.time - before.time) / (gdouble) G_USEC_PER_SEC;
+  const gdouble cpu     = 100.0 * (after.cpu - before.cpu) / (after.time - before.time);
+  const gdouble loss    = (received + lost) ? (gdouble) lost / (received + lost) : 1.0;
+  const gdouble rss     = (gdouble)((gint64) after.rss - (gint64) idle.rss) / i_streams / 1024;
+  const gdouble switches = (after.voluntary_switches + after.involuntary_switches 
+                           - before.voluntary_switches - before.involuntary_switches) / seconds;
+
+  g_print ( "%7u %9.2f %10.0f %8u %10.0f %9.5f %9.3f %9.3f %9.3f %9.3f\n"
+          , i_streams, cpu / i_streams, rss, after.threads, switches, loss
+          , p50 / 1000.0, p99 / 1000.0, p999 / 1000.0, max / 1000.0
+          );
+
+  const gboolean loss_ok    = loss <= io_bench->max_loss;
+  const gboolean latency_ok = samples > 0 && p99 <= (gint64) io_bench->max_latency * 1000;
+  if (!loss_ok || !latency_ok)
+  {
+    g_print ( "limits broken at %u streams:%s%s\n", i_streams
+            , loss_ok ? "" : " loss"
+            , latency_ok ? "" : " latency"
+            );
+    return FALSE;
+  }
+  return TRUE;
+}
+
+int main (int argc, char* argv[])
+{
+  PgmBench bench = { 1, 64, 0, 125000, 1316, 2, 10, NULL, 7500, 0, FALSE, 0.0, 50 };
+  GError* err = NULL;
+
+  GOptionEntry entries[] =
+    { { "start"         , 'n', 0, G_OPTION_ARG_INT   , &bench.start         , "Streams of the first step (1)", "N" }
+    , { "max"           , 'm', 0, G_OPTION_ARG_INT   , &bench.max           , "Streams of the last step (64)", "N" }
+    , { "step"          , 's', 0, G_OPTION_ARG_INT   , &bench.step          , "Streams added per step, 0 to double (0)", "N" }
+    , { "rate"          , 'r', 0, G_OPTION_ARG_INT   , &bench.rate          , "Bytes per second and stream (125000)", "BYTES" }
+    , { "packet"        , 'p', 0, G_OPTION_ARG_INT   , &bench.packet        , "Buffer size (1316)", "BYTES" }
+    , { "warmup"        , 'w', 0, G_OPTION_ARG_INT   , &bench.warmup        , "Seconds before measuring a step (2)", "S" }
+    , { "duration"      , 'd', 0, G_OPTION_ARG_INT   , &bench.duration      , "Seconds measured per step (10)", "S" }
+    , { "network"       ,   0, 0, G_OPTION_ARG_STRING, &bench.network       , "PGM network of every pair (lo;239.192.0.1)", "NETWORK" }
+    , { "dport"         ,   0, 0, G_OPTION_ARG_INT   , &bench.dport         , "Data port of the first pair, one up per pair (7500)", "PORT" }
+    , { "udp-encap-port",   0, 0, G_OPTION_ARG_INT   , &bench.udp_encap_port, "UDP encapsulation port, 0 for raw PGM (0)", "PORT" }
+    , { "shm"           ,   0, 0, G_OPTION_ARG_NONE  , &bench.shm           , "Let receivers take the shared memory path", NULL }
+    , { "max-loss"      ,   0, 0, G_OPTION_ARG_DOUBLE, &bench.max_loss      , "Fraction of buffers that may be lost (0)", "F" }
+    , { "max-latency"   ,   0, 0, G_OPTION_ARG_INT   , &bench.max_latency   , "Milliseconds the 99th percentile may take (50)", "MS" }
+    , { NULL }
+    };
+
+  GOptionContext* context = g_option_context_new ("- ramp pgmsink/pgmsrc pairs until loss or latency break");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &err))
+  {
+    g_printerr ("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (context);
+
+  if (NULL == bench.network) bench.network = g_strdup ("lo;239.192.0.1");
+  if (0 == bench.start || bench.max < bench.start || bench.packet < PGM_BENCH_STAMP_SIZE)
+  {
+    g_printerr ("need 0 < start <= max and a packet of at least %d bytes\n", PGM_BENCH_STAMP_SIZE);
+    return EXIT_FAILURE;
+  }
+
+  bench.pairs = g_new0 (PgmBenchPair, bench.max);
+  pgm_bench_latency_init (&bench.latency);
+
+  g_print ( "%u bytes/s per stream in %u byte buffers, limits: loss %g, p99 %u ms\n"
+          , bench.rate, bench.packet, bench.max_loss, bench.max_latency
+          );
+  g_print ("%7s %9s %10s %8s %10s %9s %9s %9s %9s %9s\n", "streams", "cpu%/str", "rss-kB/str", "threads", "csw/s", "loss", "p50-ms", "p99-ms", "p99.9-ms", "max-ms");
+
+  guint streams = bench.start;
+  while (pgm_bench_step (&bench, streams) && streams < bench.max)
+  {
+    streams = MIN (bench.max, bench.step ? streams + bench.step : streams * 2);
+  }
+
+  pgm_bench_latency_clear (&bench.latency);
+  g_free (bench.pairs);
+  g_free (bench.network);
+  return EXIT_SUCCESS;
+}
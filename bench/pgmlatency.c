@@ -0,0 +1,398 @@
+/* vim:ts=8:sts=4:sw=4:noai:noexpandtab
+ *
+ * PGM GStreamer glass-to-glass latency benchmark
+ *
+ * Copyright (c) 2008 Miru Limited.
+ * Copyright (c) 2014 Tim Aerts.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Runs the codec chains of the shipped h263, x264, theora, jpeg and smoke
+ * scripts headless, videotestsrc into pgmsink and pgmsrc into fakesink in
+ * one process, for every codec, transport and loss rate asked for:
+ *
+ *   GST_PLUGIN_PATH=. bench/pgmlatency --codecs h263,x264 --loss 0,1,5
+ *
+ * Every raw frame gets its number drawn into the top left corner as 32
+ * blocks of 16x16 pixels, 24 bits of frame number and 8 check bits, which
+ * survive the codecs. The receiver reads them back after decoding, so the
+ * latency is from before the encoder to after the decoder.
+ *
+ * Transports: pgm is PGM straight over IP (needs CAP_NET_RAW), udp is PGM
+ * encapsulated in UDP as the *2.sh scripts, shm is the shared memory path
+ * to receivers on the same host. Loss is added with tc netem on --netem-dev
+ * (needs CAP_NET_ADMIN), rates that cannot be set up are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+#include "PgmBenchStats.h"
+
+#define PGM_LATENCY_BLOCK   16
+#define PGM_LATENCY_BITS    32
+#define PGM_LATENCY_FRAMES  ( 1 << 16 )   // send times remembered
+
+typedef struct
+{
+  const gchar*  name;
+  guint         width;
+  guint         height;
+  const gchar*  encode;
+  const gchar*  caps;     // of pgmsrc, NULL for any
+  const gchar*  decode;
+} PgmLatencyCodec;
+
+/* as in the *src.sh / *sink.sh scripts, properties of GStreamer 1.0 */
+static const PgmLatencyCodec pgm_latency_codecs[] =
+  { { "h263"  , 352, 288
+    , "avenc_h263 ! rtph263pay"
+    , "application/x-rtp,media=video,clock-rate=90000,encoding-name=H263"
+    , "rtph263depay ! avdec_h263"
+    }
+  , { "x264"  , 320, 240
+    , "x264enc byte-stream=true bitrate=128 vbv-buf-capacity=300 bframes=0 b-pyramid=true weightb=true me=dia trellis=false key-int-max=4000 threads=1 ! rtph264pay"
+    , "application/x-rtp,media=video,clock-rate=90000,encoding-name=H264"
+    , "rtph264depay ! avdec_h264"
+    }
+  , { "theora", 320, 240, "theoraenc quality=6 ! oggmux"       , NULL, "oggdemux ! theoradec" }
+  , { "jpeg"  , 320, 240, "jpegenc quality=40 ! multipartmux"  , NULL, "multipartdemux ! jpegdec" }
+  , { "smoke" , 320, 240, "smokeenc qmax=40 keyframe=8"        , NULL, "smokedec" }
+  };
+
+typedef struct
+{
+  gchar*    codecs;
+  gchar*    transports;
+  gchar*    loss;
+  guint     framerate;
+  guint     warmup;       // seconds
+  guint     duration;
+  gchar*    network;
+  guint     dport;
+  guint     udp_encap_port;
+  gchar*    netem_dev;
+
+  const PgmLatencyCodec*  codec;
+  guint32          frame;       // frames stamped
+  gint64*          sent;        // monotonic send time by frame number
+  guint64          stamped;
+  guint64          received;
+  guint32          last;        // last frame number read back
+  PgmBenchLatency  latency;
+  gint             measuring;
+} PgmLatency;
+
+static guint32 pgm_latency_check (guint32 i_frame)
+{
+  return (i_frame * 0x9E3779B1u) >> 24;
+}
+
+/* Y plane of I420 without video meta, rows padded to 4 bytes */
+static void pgm_latency_draw (guint8* io_luma, guint i_stride, guint32 i_frame)
+{
+  const guint32 code = (i_frame & 0xFFFFFF) | (pgm_latency_check (i_frame & 0xFFFFFF) << 24);
+
+  for (guint bit = 0; bit < PGM_LATENCY_BITS; ++bit)
+  {
+    const guint8 value = (code >> bit) & 1 ? 235 : 16;
+    guint8* block = io_luma + (bit / 16) * PGM_LATENCY_BLOCK * i_stride + (bit % 16) * PGM_LATENCY_BLOCK;
+
+    for (guint y = 0; y < PGM_LATENCY_BLOCK; ++y) memset (block + y * i_stride, value, PGM_LATENCY_BLOCK);
+  }
+}
+
+/* the frame number, FALSE if the blocks do not check; numbering starts at
+ * 1 as a blank picture reads as 0
+ */
+static gboolean pgm_latency_read (const guint8* i_luma, guint i_stride, guint32* o_frame)
+{
+  guint32 code = 0;
+
+  for (guint bit = 0; bit < PGM_LATENCY_BITS; ++bit)
+  {
+    const guint8* block = i_luma + (bit / 16) * PGM_LATENCY_BLOCK * i_stride + (bit % 16) * PGM_LATENCY_BLOCK;
+    guint sum = 0;
+
+    /* the inside of the block, edges bleed */
+    for (guint y = 4; y < PGM_LATENCY_BLOCK - 4; ++y)
+    {
+      for (guint x = 4; x < PGM_LATENCY_BLOCK - 4; ++x) sum += block[y * i_stride + x];
+    }
+    if (sum > 128 * 64) code |= 1u << bit;
+  }
+
+  *o_frame = code & 0xFFFFFF;
+  return 0 != *o_frame && (code >> 24) == pgm_latency_check (*o_frame);
+}
+
+static GstPadProbeReturn pgm_latency_stamp (GstPad* i_pad, GstPadProbeInfo* io_info, gpointer io_bench)
+{
+  PgmLatency* bench = io_bench;
+  GstBuffer* buffer = gst_buffer_make_writable (GST_PAD_PROBE_INFO_BUFFER (io_info));
+  GstMapInfo map;
+
+  GST_PAD_PROBE_INFO_DATA (io_info) = buffer;
+  if (!gst_buffer_map (buffer, &map, GST_MAP_WRITE)) return GST_PAD_PROBE_OK;
+
+  const guint32 frame = bench->frame++ % 0xFFFFFF + 1;
+  pgm_latency_draw (map.data, GST_ROUND_UP_4 (bench->codec->width), frame);
+  gst_buffer_unmap (buffer, &map);
+
+  bench->sent[frame % PGM_LATENCY_FRAMES] = g_get_monotonic_time ();
+  if (g_atomic_int_get (&bench->measuring)) bench->stamped++;
+  return GST_PAD_PROBE_OK;
+}
+
+static void pgm_latency_received (GstElement* i_fakesink, GstBuffer* i_buffer, GstPad* i_pad, gpointer io_bench)
+{
+  PgmLatency* bench = io_bench;
+  const gint64 now = g_get_monotonic_time ();
+  GstMapInfo map;
+  guint32 frame;
+
+  if (!gst_buffer_map (i_buffer, &map, GST_MAP_READ)) return;
+  const gboolean ok = map.size >= GST_ROUND_UP_4 (bench->codec->width) * 2 * PGM_LATENCY_BLOCK
+                   && pgm_latency_read (map.data, GST_ROUND_UP_4 (bench->codec->width), &frame);
+  gst_buffer_unmap (i_buffer, &map);
+
+  /* decoders may repeat a frame, counted once */
+  if (!ok || frame == bench->last) return;
+  bench->last = frame;
+
+  if (!g_atomic_int_get (&bench->measuring)) return;
+  bench->received++;
+  pgm_bench_latency_add (&bench->latency, now - bench->sent[frame % PGM_LATENCY_FRAMES]);
+}
+
+/* tc qdisc on the device, NULL to remove it */
+static gboolean pgm_latency_netem (const PgmLatency* i_bench, const gchar* i_loss)
+{
+  gchar* command = i_loss
+    ? g_strdup_printf ("tc qdisc replace dev %s root netem loss %s%%", i_bench->netem_dev, i_loss)
+    : g_strdup_printf ("tc qdisc del dev %s root", i_bench->netem_dev);
+  gint status = -1;
+
+  const gboolean ok = g_spawn_command_line_sync (command, NULL, NULL, &status, NULL) && 0 == status;
+  g_free (command);
+  return ok;
+}
+
+static gchar* pgm_latency_describe (const PgmLatency* i_bench, const gchar* i_transport)
+{
+  const PgmLatencyCodec* codec = i_bench->codec;
+  const gboolean shm = 0 == strcmp (i_transport, "shm");
+  const guint udp_encap_port = 0 == strcmp (i_transport, "udp") ? i_bench->udp_encap_port : 0;
+
+  return g_strdup_printf
+    ( "videotestsrc is-live=true pattern=ball"
+      " ! capsfilter name=stamp caps=\"video/x-raw,format=I420,width=%u,height=%u,framerate=%u/1\""
+      " ! %s ! pgmsink network=\"%s\" dport=%u udp-encap-port=%u shm-size=%u"
+      "  pgmsrc network=\"%s\" dport=%u udp-encap-port=%u shm=%s%s%s%s"
+      " ! %s ! videoconvert ! video/x-raw,format=I420 ! fakesink name=out sync=false signal-handoffs=true"
+    , codec->width, codec->height, i_bench->framerate
+    , codec->encode, i_bench->network, i_bench->dport, udp_encap_port, shm ? 4 << 20 : 0
+    , i_bench->network, i_bench->dport, udp_encap_port, shm ? "true" : "false"
+    , codec->caps ? " caps=\"" : "", codec->caps ? codec->caps : "", codec->caps ? "\"" : ""
+    , codec->decode
+    );
+}
+
+/* wait, FALSE if the pipeline failed meanwhile */
+static gboolean pgm_latency_run_for (GstElement* i_pipeline, guint i_seconds, gchar** o_error)
+{
+  GstBus* bus = gst_element_get_bus (i_pipeline);
+  GstMessage* msg = gst_bus_timed_pop_filtered (bus, i_seconds * GST_SECOND, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (NULL == msg) return TRUE;
+
+  GError* err = NULL;
+  gst_message_parse_error (msg, &err, NULL);
+  *o_error = g_strdup_printf ("%s: %s", GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)), err->message);
+  g_error_free (err);
+  gst_message_unref (msg);
+  return FALSE;
+}
+
+/* one codec, transport and loss rate, one line of output */
+static void pgm_latency_run (PgmLatency* io_bench, const gchar* i_transport, const gchar* i_loss)
+{
+  const gchar* name = io_bench->codec->name;
+  gchar* error = NULL;
+
+  gchar* description = pgm_latency_describe (io_bench, i_transport);
+  GstElement* pipeline = gst_parse_launch (description, NULL);
+  g_free (description);
+
+  if (NULL == pipeline)
+  {
+    g_print ("%-7s %-5s %6s  skipped, elements missing\n", name, i_transport, i_loss);
+    return;
+  }
+
+  GstElement* stamp = gst_bin_get_by_name (GST_BIN (pipeline), "stamp");
+  GstPad* pad = gst_element_get_static_pad (stamp, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, pgm_latency_stamp, io_bench, NULL);
+  gst_object_unref (pad);
+  gst_object_unref (stamp);
+
+  GstElement* out = gst_bin_get_by_name (GST_BIN (pipeline), "out");
+  g_signal_connect (out, "handoff", G_CALLBACK (pgm_latency_received), io_bench);
+  gst_object_unref (out);
+
+  io_bench->frame    = 0;
+  io_bench->last     = 0;
+  io_bench->stamped  = 0;
+  io_bench->received = 0;
+  g_atomic_int_set (&io_bench->measuring, FALSE);
+  pgm_bench_latency_reset (&io_bench->latency);
+
+  PgmBenchUsage before, after;
+  gboolean ok = GST_STATE_CHANGE_FAILURE != gst_element_set_state (pipeline, GST_STATE_PLAYING)
+             && pgm_latency_run_for (pipeline, io_bench->warmup, &error);
+  if (ok)
+  {
+    g_atomic_int_set (&io_bench->measuring, TRUE);
+    pgm_bench_usage_read (&before);
+    ok = pgm_latency_run_for (pipeline, io_bench->duration, &error);
+    pgm_bench_usage_read (&after);
+    g_atomic_int_set (&io_bench->measuring, FALSE);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  if (!ok)
+  {
+    g_print ("%-7s %-5s %6s  failed, %s\n", name, i_transport, i_loss, error ? error : "cannot start");
+    g_free (error);
+    return;
+  }
+
+  gint64 p50 = 0, p99 = 0, p999 = 0, max = 0;
+  pgm_bench_latency_summary (&io_bench->latency, &p50, &p99, &p999, &max);
+
+  const gdouble cpu  = 100.0 * (after.cpu - before.cpu) / (after.time - before.time);
+  const gdouble lost = io_bench->stamped ? 1.0 - MIN (1.0, (gdouble) io_bench->received / io_bench->stamped) : 1.0;
+
+  g_print ( "%-7s %-5s %6s %8" G_GUINT64_FORMAT " %8.4f %8.1f %8.1f %8.1f %8.1f %7.1f\n"
+          , name, i_transport, i_loss, io_bench->received, lost
+          , p50 / 1000.0, p99 / 1000.0, p999 / 1000.0, max / 1000.0, cpu
+          );
+}
+
+int main (int argc, char* argv[])
+{
+  PgmLatency bench;
+  GError* err = NULL;
+
+  memset (&bench, 0, sizeof(bench));
+  bench.framerate      = 15;
+  bench.warmup         = 3;
+  bench.duration       = 20;
+  bench.dport          = 7502;
+  bench.udp_encap_port = 3057;
+
+  GOptionEntry entries[] =
+    { { "codecs"        , 'c', 0, G_OPTION_ARG_STRING, &bench.codecs        , "Codecs to run (h263,x264,theora,jpeg,smoke)", "LIST" }
+    , { "transports"    , 't', 0, G_OPTION_ARG_STRING, &bench.transports    , "Transports to run (udp,pgm,shm)", "LIST" }
+    , { "loss"          , 'l', 0, G_OPTION_ARG_STRING, &bench.loss          , "Packet loss in percent to run with (0)", "LIST" }
+    , { "framerate"     , 'f', 0, G_OPTION_ARG_INT   , &bench.framerate     , "Frames per second (15)", "N" }
+    , { "warmup"        , 'w', 0, G_OPTION_ARG_INT   , &bench.warmup        , "Seconds before measuring (3)", "S" }
+    , { "duration"      , 'd', 0, G_OPTION_ARG_INT   , &bench.duration      , "Seconds measured per run (20)", "S" }
+    , { "network"       ,   0, 0, G_OPTION_ARG_STRING, &bench.network       , "PGM network (lo;239.192.0.2)", "NETWORK" }
+    , { "dport"         ,   0, 0, G_OPTION_ARG_INT   , &bench.dport         , "Data port (7502)", "PORT" }
+    , { "udp-encap-port",   0, 0, G_OPTION_ARG_INT   , &bench.udp_encap_port, "UDP encapsulation port of the udp transport (3057)", "PORT" }
+    , { "netem-dev"     ,   0, 0, G_OPTION_ARG_STRING, &bench.netem_dev     , "Device tc netem adds loss on (lo)", "DEV" }
+    , { NULL }
+    };
+
+  GOptionContext* context = g_option_context_new ("- latency of the shipped codec chains over pgmsink/pgmsrc");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &err))
+  {
+    g_printerr ("%s\n", err->message);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (context);
+
+  if (NULL == bench.codecs)     bench.codecs     = g_strdup ("h263,x264,theora,jpeg,smoke");
+  if (NULL == bench.transports) bench.transports = g_strdup ("udp,pgm,shm");
+  if (NULL == bench.loss)       bench.loss       = g_strdup ("0");
+  if (NULL == bench.network)    bench.network    = g_strdup ("lo;239.192.0.2");
+  if (NULL == bench.netem_dev)  bench.netem_dev  = g_strdup ("lo");
+  if (0 == bench.framerate)
+  {
+    g_printerr ("framerate must be at least 1\n");
+    return EXIT_FAILURE;
+  }
+
+  bench.sent = g_new0 (gint64, PGM_LATENCY_FRAMES);
+  pgm_bench_latency_init (&bench.latency);
+
+  gchar** codecs     = g_strsplit (bench.codecs, ",", -1);
+  gchar** transports = g_strsplit (bench.transports, ",", -1);
+  gchar** losses     = g_strsplit (bench.loss, ",", -1);
+
+  g_print ( "%-7s %-5s %6s %8s %8s %8s %8s %8s %8s %7s\n"
+          , "codec", "path", "loss%", "frames", "lost", "p50-ms", "p99-ms", "p99.9-ms", "max-ms", "cpu%"
+          );
+
+  for (gchar** loss = losses; *loss; ++loss)
+  {
+    const gboolean netem = g_ascii_strtod (*loss, NULL) > 0;
+    if (netem && !pgm_latency_netem (&bench, *loss))
+    {
+      g_print ("loss %s%% skipped, cannot set up tc netem on %s\n", *loss, bench.netem_dev);
+      continue;
+    }
+
+    for (gchar** name = codecs; *name; ++name)
+    {
+      bench.codec = NULL;
+      for (guint i = 0; i < G_N_ELEMENTS(pgm_latency_codecs); ++i)
+      {
+        if (0 == strcmp (*name, pgm_latency_codecs[i].name)) bench.codec = &pgm_latency_codecs[i];
+      }
+      if (NULL == bench.codec)
+      {
+        g_print ("%-7s unknown codec\n", *name);
+        continue;
+      }
+
+      for (gchar** transport = transports; *transport; ++transport) pgm_latency_run (&bench, *transport, *loss);
+    }
+
+    if (netem) pgm_latency_netem (&bench, NULL);
+  }
+
+  g_strfreev (codecs);
+  g_strfreev (transports);
+  g_strfreev (losses);
+  pgm_bench_latency_clear (&bench.latency);
+  g_free (bench.sent);
+  g_free (bench.codecs);
+  g_free (bench.transports);
+  g_free (bench.loss);
+  g_free (bench.network);
+  g_free (bench.netem_dev);
+  return EXIT_SUCCESS;
+}